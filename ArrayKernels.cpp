@@ -0,0 +1,81 @@
+/**
+ *  ArrayKernels.cpp
+ *  Implementation of ArrayKernels.hpp
+ */
+
+#include "ArrayKernels.hpp"
+#include "PrefixHeader.pch"
+//#include "stdafx.h"
+
+// Four doubles, operated on with SIMD instructions by GCC and Clang.
+typedef double Double4 __attribute__((vector_size(4 * sizeof(double))));
+
+/**
+ * SumArray. Method to add up array values.
+ * Adds up four values at a time in a vector accumulator, then adds up the lanes of the accumulator and the
+ * remaining values.
+ * @param a_values const double* The values to add up.
+ * @param a_count size_t Number of values.
+ * @return double The sum of the values.
+ */
+double SumArray(const double *a_values, size_t a_count)
+{
+    Double4 accumulator = {0, 0, 0, 0};
+    size_t i = 0;
+    
+    for(; i + 4 <= a_count; i += 4)
+    {
+        Double4 values;
+        memcpy(&values, a_values + i, sizeof(values));
+        accumulator += values;
+    }
+    
+    double sum = (accumulator[0] + accumulator[1]) + (accumulator[2] + accumulator[3]);
+    for(; i < a_count; i++)
+        sum += a_values[i];
+    
+    return sum;
+}
+
+/**
+ * FillArray. Method to fill an array.
+ * Stores four copies of a_value at a time, then the remaining values.
+ * @param a_values double* The values to set.
+ * @param a_count size_t Number of values.
+ * @param a_value double The value to set them to.
+ */
+void FillArray(double *a_values, size_t a_count, double a_value)
+{
+    Double4 values = {a_value, a_value, a_value, a_value};
+    size_t i = 0;
+    
+    for(; i + 4 <= a_count; i += 4)
+        memcpy(a_values + i, &values, sizeof(values));
+    
+    for(; i < a_count; i++)
+        a_values[i] = a_value;
+}
+
+/**
+ * CopyArray. Method to copy an array.
+ * Copies the values as one block of memory.
+ * @param a_destination double* Where the values are copied to.
+ * @param a_source const double* The values to copy.
+ * @param a_count size_t Number of values.
+ */
+void CopyArray(double *a_destination, const double *a_source, size_t a_count)
+{
+    if(a_count > 0)
+        memmove(a_destination, a_source, a_count * sizeof(double));
+}
+
+/**
+ * SortArray. Method to sort an array.
+ * Sorts the values in ascending order.
+ * @param a_values double* The values to sort.
+ * @param a_count size_t Number of values.
+ */
+void SortArray(double *a_values, size_t a_count)
+{
+    sort(a_values, a_values + a_count);
+}
@@ -0,0 +1,21 @@
+/**
+ *  ArrayKernels.hpp
+ *  Bulk operations on the contiguous storage of Duck arrays.
+ *  Used by DuckInterpreter for the sum, fill, copy and sort builtins.
+ */
+
+#pragma once
+#include "PrefixHeader.pch"
+//#include "stdafx.h"
+
+// Returns the sum of the a_count values starting at a_values.
+double SumArray(const double *a_values, size_t a_count);
+
+// Sets the a_count values starting at a_values to a_value.
+void FillArray(double *a_values, size_t a_count, double a_value);
+
+// Copies a_count values from a_source to a_destination.
+void CopyArray(double *a_destination, const double *a_source, size_t a_count);
+
+// Sorts the a_count values starting at a_values in ascending order.
+void SortArray(double *a_values, size_t a_count);
@@ -0,0 +1,251 @@
+/**
+ *  AsyncOutput.cpp
+ *  Implementation of AsyncOutput.hpp
+ */
+
+#include "AsyncOutput.hpp"
+#include "PrefixHeader.pch"
+//#include "stdafx.h"
+
+// The output that is flushed when the program exits.
+static AsyncOutput *s_started = NULL;
+
+/**
+ * StopOnExit. Exit handler.
+ * Stops the started output, so that everything printed before exit() is written, whatever the exit status.
+ */
+static void StopOnExit()
+{
+    if(s_started != NULL)
+        s_started->Stop();
+}
+
+/**
+ * AsyncOutput::AsyncOutput. Constructor for AsyncOutput class.
+ * @param a_file int File that the output is written to.
+ */
+AsyncOutput::AsyncOutput(int a_file) : m_file(a_file)
+{
+    setp(m_buffer, m_buffer + ASYNC_OUTPUT_BUFFER_SIZE);
+}
+
+/**
+ * AsyncOutput::~AsyncOutput. Destructor for AsyncOutput class.
+ * Stops the output if it is still running.
+ */
+AsyncOutput::~AsyncOutput()
+{
+    Stop();
+}
+
+/**
+ * AsyncOutput::Start. Method to start the output.
+ * Flushes what cout has buffered so far, so that it comes first, then makes cout write into the ring and starts the
+ * writer thread. The output is stopped, and flushed, when the program exits.
+ */
+void AsyncOutput::Start()
+{
+    if(m_running)
+        return;
+    
+    cout.flush();
+    m_previous = cout.rdbuf(this);
+    m_stopping = false;
+    m_running = true;
+    m_writer = thread(&AsyncOutput::RunWriter, this);
+    
+    if(s_started == NULL)
+        atexit(StopOnExit);
+    s_started = this;
+}
+
+/**
+ * AsyncOutput::Drain. Method to wait for the output to be written.
+ * Used before reading input, so that the prompt is shown before the interpreter waits for the user.
+ */
+void AsyncOutput::Drain()
+{
+    if(!m_running)
+        return;
+    
+    sync();
+    size_t head = m_head.load(memory_order_relaxed);
+    Wait(m_wakeInterpreter, m_interpreterWaiting,
+         [this, head]() { return m_tail.load(memory_order_acquire) == head; });
+}
+
+/**
+ * AsyncOutput::Stop. Method to stop the output.
+ * Pushes what cout has buffered, lets the writer write everything in the ring and waits for it to end. cout writes
+ * to its previous buffer afterwards.
+ */
+void AsyncOutput::Stop()
+{
+    if(!m_running)
+        return;
+    
+    sync();
+    m_stopping.store(true, memory_order_release);
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_wakeWriter.notify_one();
+    }
+    m_writer.join();
+    m_running = false;
+    
+    cout.rdbuf(m_previous);
+    if(s_started == this)
+        s_started = NULL;
+}
+
+/**
+ * AsyncOutput::AbandonInChild. Method to let go of the output in a forked child.
+ * What the child writes to cout goes to the previous buffer of cout. What the parent had in the ring is left to the
+ * parent.
+ */
+void AsyncOutput::AbandonInChild()
+{
+    if(!m_running)
+        return;
+    
+    m_running = false;
+    cout.rdbuf(m_previous);
+    if(s_started == this)
+        s_started = NULL;
+}
+
+/**
+ * AsyncOutput::overflow. Method called by cout when its buffer is full.
+ * Pushes the buffer into the ring, then starts a new buffer with a_char.
+ * @param a_char int The character that did not fit, or EOF.
+ * @return int a_char, or something other than EOF when a_char is EOF.
+ */
+int AsyncOutput::overflow(int a_char)
+{
+    sync();
+    if(a_char == traits_type::eof())
+        return traits_type::not_eof(a_char);
+    
+    *pptr() = traits_type::to_char_type(a_char);
+    pbump(1);
+    return a_char;
+}
+
+/**
+ * AsyncOutput::sync. Method called by cout on flushes, e.g. by endl.
+ * Pushes the buffer into the ring. Only the writer thread writes to the file, so flushes do not block on it.
+ * @return int 0.
+ */
+int AsyncOutput::sync()
+{
+    if(pptr() > pbase())
+        Push(pbase(), pptr() - pbase());
+    setp(m_buffer, m_buffer + ASYNC_OUTPUT_BUFFER_SIZE);
+    return 0;
+}
+
+/**
+ * AsyncOutput::Push. Method to push bytes into the ring.
+ * Copies as much as fits after the bytes the writer has not written yet, and publishes it. While the ring is full,
+ * waits for the writer to make room.
+ * @param a_data const char* The bytes.
+ * @param a_size size_t Number of bytes.
+ */
+void AsyncOutput::Push(const char *a_data, size_t a_size)
+{
+    size_t head = m_head.load(memory_order_relaxed);
+    while(a_size > 0)
+    {
+        size_t room = ASYNC_OUTPUT_RING_SIZE - (head - m_tail.load(memory_order_acquire));
+        if(room == 0)
+        {
+            Wait(m_wakeInterpreter, m_interpreterWaiting,
+                 [this, head]() { return head - m_tail.load(memory_order_acquire) < ASYNC_OUTPUT_RING_SIZE; });
+            continue;
+        }
+        
+        // Copying up to the end of the ring, then from its start.
+        size_t count = min(room, a_size);
+        size_t offset = head & (ASYNC_OUTPUT_RING_SIZE - 1);
+        size_t first = min(count, ASYNC_OUTPUT_RING_SIZE - offset);
+        memcpy(m_ring + offset, a_data, first);
+        memcpy(m_ring, a_data + first, count - first);
+        
+        head += count;
+        a_data += count;
+        a_size -= count;
+        m_head.store(head, memory_order_release);
+        Wake(m_wakeWriter, m_writerWaiting);
+    }
+}
+
+/**
+ * AsyncOutput::RunWriter. Method run by the writer thread.
+ * Writes the bytes in the ring to the file, as much as is contiguous in one write, until it is asked to stop and the
+ * ring is empty. If the file can not be written, e.g. it is a pipe that was closed, the output is dropped so that the
+ * interpreter is not blocked forever.
+ */
+void AsyncOutput::RunWriter()
+{
+    size_t tail = m_tail.load(memory_order_relaxed);
+    while(true)
+    {
+        size_t head = m_head.load(memory_order_acquire);
+        if(head == tail)
+        {
+            if(m_stopping.load(memory_order_acquire) && m_head.load(memory_order_acquire) == tail)
+                return;
+            Wait(m_wakeWriter, m_writerWaiting, [this, tail]()
+                 { return m_head.load(memory_order_acquire) != tail || m_stopping.load(memory_order_acquire); });
+            continue;
+        }
+        
+        size_t offset = tail & (ASYNC_OUTPUT_RING_SIZE - 1);
+        size_t count = min(head - tail, ASYNC_OUTPUT_RING_SIZE - offset);
+        ssize_t written = write(m_file, m_ring + offset, count);
+        if(written < 0 && errno == EINTR)
+            continue;
+        tail += written < 0 ? count : (size_t)written;
+        m_tail.store(tail, memory_order_release);
+        Wake(m_wakeInterpreter, m_interpreterWaiting);
+    }
+}
+
+/**
+ * AsyncOutput::Wait. Method to wait for the other thread.
+ * Says that this thread is waiting before checking a_ready again, so that the other thread either sees the flag and
+ * wakes it up, or made a_ready true before the check. Sleeps for at most ASYNC_OUTPUT_WAIT at a time.
+ * @param a_wake condition_variable Condition variable this thread sleeps on.
+ * @param a_waiting atomic<bool> Flag that tells the other thread to wake this one.
+ * @param a_ready Ready Returns true when this thread can go on.
+ */
+template<typename Ready>
+void AsyncOutput::Wait(condition_variable &a_wake, atomic<bool> &a_waiting, Ready a_ready)
+{
+    while(!a_ready())
+    {
+        unique_lock<mutex> lock(m_mutex);
+        a_waiting.store(true);
+        atomic_thread_fence(memory_order_seq_cst);
+        if(!a_ready())
+            a_wake.wait_for(lock, chrono::microseconds(ASYNC_OUTPUT_WAIT));
+        a_waiting.store(false);
+    }
+}
+
+/**
+ * AsyncOutput::Wake. Method to wake the other thread.
+ * Only takes the lock when the other thread said it is waiting, so the fast path is a fence and a load. The fences
+ * order the flag and the ring counts, so that one of the threads always sees the other's store.
+ * @param a_wake condition_variable Condition variable the other thread sleeps on.
+ * @param a_waiting atomic<bool> Flag set by the other thread while it waits.
+ */
+void AsyncOutput::Wake(condition_variable &a_wake, atomic<bool> &a_waiting)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    if(a_waiting.load())
+    {
+        lock_guard<mutex> lock(m_mutex);
+        a_wake.notify_one();
+    }
+}
@@ -0,0 +1,90 @@
+/**
+ *  AsyncOutput.hpp
+ *  Asynchronous standard output, for --async-output.
+ *  Output written to cout is formatted into a local buffer, pushed into a lock-free single-producer/single-consumer
+ *  ring buffer by the interpreter thread, and written to the file by a writer thread with large writes. When the ring
+ *  is full, the interpreter waits for the writer, so a slow reader slows the program down instead of growing memory.
+ *  The output is flushed when the program exits, including on errors, which exit through exit().
+ */
+
+#pragma once
+#include "PrefixHeader.pch"
+//#include "stdafx.h"
+
+// Size of the ring buffer, in bytes. Must be a power of two.
+static const size_t ASYNC_OUTPUT_RING_SIZE = 1 << 20;
+
+// Size of the buffer that cout formats into before it is pushed to the ring, in bytes.
+static const size_t ASYNC_OUTPUT_BUFFER_SIZE = 8192;
+
+// Longest time that the writer and the interpreter sleep before checking the ring again, in microseconds.
+// They are woken up as soon as there is something to do, this only bounds a missed wake up.
+static const int ASYNC_OUTPUT_WAIT = 1000;
+
+class AsyncOutput : public streambuf
+{
+public:
+    AsyncOutput(int a_file);
+    ~AsyncOutput();
+    
+    // Makes cout write through the ring, and starts the writer thread.
+    void Start();
+    
+    // Waits until everything written to cout so far has been written to the file.
+    void Drain();
+    
+    // Drains the output, stops the writer thread and gives cout its previous buffer back.
+    void Stop();
+    
+    // Method for a child process forked while the output runs. The writer thread is not in the child, so cout gets its
+    // previous buffer back without draining the ring, and the child does not wait for the writer when it exits.
+    void AbandonInChild();
+    
+protected:
+    // Called by cout when its buffer is full, and on flushes.
+    int overflow(int a_char) override;
+    int sync() override;
+    
+private:
+    // Pushes a_size bytes into the ring, waiting for the writer while it is full.
+    void Push(const char *a_data, size_t a_size);
+    
+    // Method run by the writer thread.
+    void RunWriter();
+    
+    // Waits until a_ready returns true, sleeping on a_wake. a_waiting tells the other thread to wake this one.
+    template<typename Ready>
+    void Wait(condition_variable &a_wake, atomic<bool> &a_waiting, Ready a_ready);
+    
+    // Wakes the other thread if it is waiting on a_wake.
+    void Wake(condition_variable &a_wake, atomic<bool> &a_waiting);
+    
+    // File that the output is written to.
+    int m_file;
+    
+    // Number of bytes pushed by the interpreter, and written by the writer. Only the interpreter changes m_head and
+    // only the writer changes m_tail. They are on separate cache lines so the two threads do not share one.
+    alignas(64) atomic<size_t> m_head{0};
+    alignas(64) atomic<size_t> m_tail{0};
+    
+    // The ring, indexed by the counts modulo its size.
+    alignas(64) char m_ring[ASYNC_OUTPUT_RING_SIZE];
+    
+    // Buffer that cout formats into.
+    char m_buffer[ASYNC_OUTPUT_BUFFER_SIZE];
+    
+    // Whether the writer thread runs, and whether it has been asked to stop once the ring is empty.
+    bool m_running = false;
+    atomic<bool> m_stopping{false};
+    thread m_writer;
+    
+    // Buffer of cout before Start.
+    streambuf *m_previous = NULL;
+    
+    // Used to sleep while there is nothing to write, or no room to push.
+    mutex m_mutex;
+    condition_variable m_wakeWriter;
+    condition_variable m_wakeInterpreter;
+    atomic<bool> m_writerWaiting{false};
+    atomic<bool> m_interpreterWaiting{false};
+};
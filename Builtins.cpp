@@ -0,0 +1,72 @@
+/**
+ *  Builtins.cpp
+ *  Implementation of Builtins.hpp
+ */
+
+#include "Builtins.hpp"
+#include "PrefixHeader.pch"
+//#include "stdafx.h"
+
+// Builtins of the language, calling straight into <cmath>.
+static double BuiltinSqrt(const double *a_arguments) { return sqrt(a_arguments[0]); }
+static double BuiltinPow(const double *a_arguments) { return pow(a_arguments[0], a_arguments[1]); }
+static double BuiltinAbs(const double *a_arguments) { return fabs(a_arguments[0]); }
+static double BuiltinMin(const double *a_arguments) { return fmin(a_arguments[0], a_arguments[1]); }
+static double BuiltinMax(const double *a_arguments) { return fmax(a_arguments[0], a_arguments[1]); }
+static double BuiltinFloor(const double *a_arguments) { return floor(a_arguments[0]); }
+static double BuiltinCeil(const double *a_arguments) { return ceil(a_arguments[0]); }
+static double BuiltinExp(const double *a_arguments) { return exp(a_arguments[0]); }
+static double BuiltinLog(const double *a_arguments) { return log(a_arguments[0]); }
+static double BuiltinSin(const double *a_arguments) { return sin(a_arguments[0]); }
+static double BuiltinCos(const double *a_arguments) { return cos(a_arguments[0]); }
+
+/**
+ * GetBuiltinTable. Accessor to get the builtin table.
+ * Creates the table with the builtins of the language the first time it is called.
+ * @return unordered_map<string, Builtin> The builtins keyed by name.
+ */
+static unordered_map<string, Builtin> &GetBuiltinTable()
+{
+    static unordered_map<string, Builtin> table =
+    {
+        {"sqrt", {"sqrt", 1, BuiltinSqrt, true}},
+        {"pow", {"pow", 2, BuiltinPow, true}},
+        {"abs", {"abs", 1, BuiltinAbs, true}},
+        {"min", {"min", 2, BuiltinMin, true}},
+        {"max", {"max", 2, BuiltinMax, true}},
+        {"floor", {"floor", 1, BuiltinFloor, true}},
+        {"ceil", {"ceil", 1, BuiltinCeil, true}},
+        {"exp", {"exp", 1, BuiltinExp, true}},
+        {"log", {"log", 1, BuiltinLog, true}},
+        {"sin", {"sin", 1, BuiltinSin, true}},
+        {"cos", {"cos", 1, BuiltinCos, true}},
+    };
+    return table;
+}
+
+/**
+ * FindBuiltin. Method to find a builtin.
+ * Looks up a_name in the builtin table.
+ * @param a_name const string The name of the builtin.
+ * @return const Builtin* The builtin. NULL if there is no builtin called a_name.
+ */
+const Builtin *FindBuiltin(const string &a_name)
+{
+    unordered_map<string, Builtin> &table = GetBuiltinTable();
+    unordered_map<string, Builtin>::const_iterator builtin = table.find(a_name);
+    return builtin == table.end() ? NULL : &builtin->second;
+}
+
+/**
+ * RegisterBuiltin. Method to register a builtin.
+ * Adds a builtin to the table, or replaces the one with the same name.
+ * @param a_name const string The name that the builtin is called with.
+ * @param a_arity int The number of arguments.
+ * @param a_function BuiltinFunction The function that computes the result.
+ * @param a_pure bool True if the result only depends on the arguments.
+ */
+void RegisterBuiltin(const string &a_name, int a_arity, BuiltinFunction a_function, bool a_pure)
+{
+    Builtin builtin = {a_name, a_arity, a_function, a_pure};
+    GetBuiltinTable()[a_name] = builtin;
+}
@@ -0,0 +1,29 @@
+/**
+ *  Builtins.hpp
+ *  Builtin functions that can be called from Duck expressions, such as sqrt(x) or max(a, b).
+ *  Calls are resolved to the function when the expression is compiled by DuckInterpreter.
+ */
+
+#pragma once
+#include "PrefixHeader.pch"
+//#include "stdafx.h"
+
+// A builtin function. Gets its arguments as an array of m_arity values.
+typedef double (*BuiltinFunction)(const double *a_arguments);
+
+// An entry of the builtin table.
+struct Builtin
+{
+    string m_name;
+    int m_arity;
+    BuiltinFunction m_function;
+    // True if the result only depends on the arguments, so calls with constant arguments can be folded.
+    bool m_pure;
+};
+
+// Finds the builtin called a_name. Returns NULL if there is none.
+const Builtin *FindBuiltin(const string &a_name);
+
+// Adds a builtin to the table, or replaces the one with the same name.
+// Must be called before the statements that use it are compiled.
+void RegisterBuiltin(const string &a_name, int a_arity, BuiltinFunction a_function, bool a_pure = true);
@@ -0,0 +1,83 @@
+/**
+ *  DuckClient.cpp
+ *  Main for duckclient, the client of the program server started by duckinterpreter --serve.
+ *  Sends a program to the server with its own standard input, output and error, so that the program reads and writes
+ *  them directly, and exits with the exit status of the program.
+ */
+
+#include "PrefixHeader.pch"
+//#include "stdafx.h"
+#include "ProgramServer.hpp"
+#include <sys/socket.h>
+#include <sys/un.h>
+
+int main(int argc, char *argv[])
+{
+    // Checking for correct arguments
+    if (argc != 3)
+    {
+        cerr<<"Usage: duckclient <socket> <filename>"<<endl;
+        return 1;
+    }
+    
+    // The server may run in another directory, so the program is sent with its absolute path.
+    char resolved[PATH_MAX];
+    string path = realpath(argv[2], resolved) != NULL ? resolved : argv[2];
+    path += '\n';
+    if(path.size() > SERVER_MAX_PATH)
+    {
+        cerr<<"Program path is too long: "<<argv[2]<<endl;
+        return 1;
+    }
+    
+    // Connecting to the server.
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, argv[1], sizeof(address.sun_path) - 1);
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(server == -1 || connect(server, (struct sockaddr *)&address, sizeof(address)) != 0)
+    {
+        cerr<<"Could not connect to the server: "<<argv[1]<<": "<<strerror(errno)<<endl;
+        return 1;
+    }
+    
+    // Sending the request, with our standard input, output and error attached.
+    int files[SERVER_REQUEST_FILES] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    char control[CMSG_SPACE(sizeof(files))];
+    memset(control, 0, sizeof(control));
+    struct iovec data = {&path[0], path.size()};
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(files));
+    memcpy(CMSG_DATA(header), files, sizeof(files));
+    if(sendmsg(server, &message, MSG_NOSIGNAL) != (ssize_t)path.size())
+    {
+        cerr<<"Could not send the request: "<<strerror(errno)<<endl;
+        return 1;
+    }
+    
+    // Waiting for the exit status of the program.
+    int32_t status;
+    size_t received = 0;
+    while(received < sizeof(status))
+    {
+        ssize_t count = recv(server, (char *)&status + received, sizeof(status) - received, 0);
+        if(count <= 0)
+        {
+            cerr<<"The server closed the connection before the program finished"<<endl;
+            return 1;
+        }
+        received += count;
+    }
+    
+    close(server);
+    return status;
+}
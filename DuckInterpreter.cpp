@@ -9,16 +9,77 @@
 
 #include "DuckInterpreter.hpp"
 #include "SymbolTable.hpp"
+#include "Keywords.hpp"
+#include "ArrayKernels.hpp"
 //#include "stdafx.h"
 #include "PrefixHeader.pch"
+#include <sys/wait.h>
+
+const char DuckInterpreter::SNAPSHOT_MAGIC[8] = {'D','U','C','K','S','N','A','P'};
+const char *const DuckInterpreter::PEEPHOLE_RULE_NAMES[PEEPHOLE_RULE_COUNT] =
+{
+    "jump threading",
+    "jump to next statement",
+    "redundant copy",
+    "increment",
+    "atomic addition",
+};
+
+// Set by the SIGUSR2 handler to take a checkpoint at the next safe point.
+static volatile sig_atomic_t s_checkpointRequested = 0;
+
+/**
+ * RequestCheckpoint. Signal handler for SIGUSR2.
+ * Asks the interpreter to take a checkpoint at the next safe point.
+ * @param a_signal int The signal number.
+ */
+static void RequestCheckpoint(int a_signal)
+{
+    s_checkpointRequested = 1;
+}
+
+/**
+ * TruncateOperand. Method to truncate an operand of an operator.
+ * Operators truncate their operands to int, as the interpreter always did by reducing them with int values, while
+ * their results are kept whole: 7 / 2 is 3.5, and 7 / 2 * 2 is 6. Values out of the range of int become INT_MIN,
+ * which is what that conversion gave, without its undefined behavior.
+ * @param a_value double The operand.
+ * @return double The operand truncated to int.
+ * @see DoOperation
+ */
+static inline double TruncateOperand(double a_value)
+{
+    if(a_value > (double)INT_MIN - 1 && a_value < (double)INT_MAX + 1)
+        return (int)a_value;
+    return INT_MIN;
+}
+
+/**
+ * AddToSharedValue. Method to add to the value of a shared variable.
+ * Adds a_amount with a compare and swap loop, so that the additions of threads that add at the same time are all
+ * kept. Atomic doubles have no fetch_add before C++20. The value is truncated first if the addition is an operator
+ * of the program, rather than ++ or --.
+ * @param a_value atomic<double> The value of the shared variable.
+ * @param a_amount double The amount to add.
+ * @param a_truncate bool Whether the value is truncated like an operand.
+ */
+static void AddToSharedValue(atomic<double> &a_value, double a_amount, bool a_truncate)
+{
+    double value = a_value.load(memory_order_relaxed);
+    // A failed exchange loads the current value, to try again with it.
+    while(!a_value.compare_exchange_weak(value, (a_truncate ? TruncateOperand(value) : value) + a_amount)) {}
+}
 
 /**
  * DuckInterpreter::DuckInterpreter. Constructor for DuckInterpreter class.
- * Empty.
+ * Allocates the return stack of gosub statements, so that calls never allocate.
  * @author Salil Maharjan
  * @date 03/13/19
  */
-DuckInterpreter::DuckInterpreter() {}
+DuckInterpreter::DuckInterpreter()
+{
+    m_returnStack.reserve(RETURN_STACK_DEPTH);
+}
 
 /**
  * DuckInterpreter::~DuckInterpreter. Destructor for DuckInterpreter class.
@@ -30,851 +91,3703 @@ DuckInterpreter::~DuckInterpreter(){}
 
 /**
  * DuckInterpreter::RunInterpreter. Method to run the interpreter.
- * Gets the statements to execute until completed.
- * @see Statement::GetStatement
- * @see ExecuteStatement
+ * Gets the compiled statements to execute until completed. Whenever the next statement is the header of a loop that
+ * already has a recorded trace, the trace is replayed instead of dispatching the statements one by one.
+ * Back-edges are counted so that hot loops get a trace recorded for them. Every SAFE_POINT_INTERVAL statements
+ * AtSafePoint is called between two statements. Every statement is recorded by the flight recorder, which is dumped
+ * if the program fails.
+ * @see RunStatements
  * @author Salil Maharjan
  * @date 03/13/19
  */
 void DuckInterpreter::RunInterpreter()
 {
-    int nextStatement = 0;
+    if(m_traceFileName.empty())
+        m_traceFileName = "duck-" + to_string(getpid()) + ".trace";
+    m_flightRecorder.Install(m_traceFileName, m_statements.GetProgramHash());
     
-    while(true)
-    {
-        string statement = m_statements.GetStatement(nextStatement);
-        //cout<<"Statement: "<<statement<<endl;
-        nextStatement = ExecuteStatement(statement,nextStatement);
-    }
+    if(m_stats)
+        m_perfCounters.Start();
+    if(!m_sampleFileName.empty())
+        m_sampler.Start(&m_programCounter, m_statements.GetStatementCount(), m_sampleFrequency);
     
+    RunStatements(m_startStatement);
 }
 
 /**
- * DuckInterpreter::ExecuteStatement. Method to execute a statement.
- * Gets the statement type of a_statement and executes it by calling the respective functions.
- * @param a_statement string The statement to be executed.
- * @param a_nextStatement int Current statement number.
- * @return int Next statement number to execute.
- * @see GetStatementStype
- * @see EvaluateArithmeticStatement
- * @see EvaluateIfStatement
- * @see EvaluatePrintStatement
- * @see EvaluateReadStatement
- * @see EvaluateGotoStatement
- * @author Salil Maharjan
- * @date 03/13/19
+ * DuckInterpreter::RunStatements. Method to run statements.
+ * The dispatch loop of the interpreter, started by RunInterpreter, and by RunRegion for spawned regions. The program
+ * stops from a statement, so the loop only returns when a region returns to REGION_END. A return goes back, like a
+ * jump back, so that is only checked on back-edges and when a trace is left.
+ * @param a_statement int The first statement to execute.
+ * @see GetCompiledStatement
+ * @see ExecuteStatement
+ * @see NoteBackEdge
+ * @see RunTrace
+ * @see AtSafePoint
  */
-int DuckInterpreter::ExecuteStatement(string a_statement, int a_nextStatement)
+void DuckInterpreter::RunStatements(int a_statement)
 {
-    // Clear the stacks
-    m_numberStack.clear();
-    m_operatorStack.clear();
-    
-    // Get the first syntactic element of the statement.
-    StatementType type = GetStatementStype(a_statement);
+    int nextStatement = a_statement;
     
-    // Based on the type, execute the remainder of the statement.
-    switch (type)
+    while(true)
     {
-        case StatementType::ArithmeticStat:
-            EvaluateArithmeticStatement(a_statement);
-            return a_nextStatement + 1;
-            
-        case StatementType::IfStat:
-            return EvaluateIfStatement(a_statement, a_nextStatement);
-            
-        case StatementType::StopStat:
-            this->~DuckInterpreter();
-            cout<< "**Exiting by a stop statement**"<<endl;
-            cout<<"**Duck thanks you for using this language. Quack**"<<endl;
-            exit(EXIT_SUCCESS);
-            
-        case StatementType::EndStat:
-            this->~DuckInterpreter();
-            cout<<"**Exiting by an end stateement**"<<endl;
-            cout<<"**Duck thanks you for using this language. Quack**"<<endl;
-            exit(EXIT_SUCCESS);
-            
-        case StatementType::PrintStat:
-            EvaluatePrintStatement(a_statement);
-            return a_nextStatement + 1;
-            
-        case StatementType::ReadStat:
-            EvaluateReadStatement(a_statement);
-            return a_nextStatement + 1;
-            
-        case StatementType::GotoStat:
-            return EvaluateGotoStatement(a_statement);
-            
-        default:
-            cerr << "BUGBUG - program terminate: invalid return value from GetStatementStype for the statement: " << a_statement << endl;
-            exit(1);
+        // Periodic work that happens between statements.
+        if(--m_safePointCountdown <= 0)
+            nextStatement = AtSafePoint(nextStatement);
+        
+        // Replay the trace of a hot loop if we have one for this statement.
+        if(m_recordingAnchor == -1 && !m_traces.empty())
+        {
+            unordered_map<int, Trace>::const_iterator trace = m_traces.find(nextStatement);
+            if(trace != m_traces.end() && !trace->second.m_blacklisted)
+            {
+                nextStatement = RunTrace(trace->second, nextStatement);
+                if(nextStatement == REGION_END)
+                    return;
+                continue;
+            }
+        }
+        
+        const CompiledStatement &statement = GetCompiledStatement(nextStatement);
+        m_flightRecorder.Record(nextStatement);
+        m_programCounter.store(nextStatement, memory_order_relaxed);
+        int followingStatement = ExecuteStatement(statement, nextStatement);
+        if(!statement.m_loopEntries.empty())
+            EnterLoops(statement, followingStatement);
+        
+        if(m_recordingAnchor != -1)
+            RecordTraceStep(nextStatement, statement.m_type, followingStatement);
+        
+        // Jumping backwards closes a loop.
+        if(followingStatement <= nextStatement)
+        {
+            if(followingStatement == REGION_END)
+                return;
+            if(m_optimize)
+                NoteBackEdge(followingStatement);
+        }
+        
+        nextStatement = followingStatement;
     }
 }
 
 /**
- * DuckInterpreter::ParseNextElement. Element Parse Method.
- * Parses the next element of the statement. Uses istringstream to get each element separated by a white space.
- * @param a_statement const string The statement to parse.
- * @param a_nextPos int The element number of the element to parse from the statement.
- * @param a_stringValue string Captures the string elements from statement. "NULL" if the element is not a string.
- * @param numValue double Captures numeric elements from the statement. INT_MAX if the element is not a number.
- * @return int Position of the next element.
- * @author Salil Maharjan
- * @date 03/13/19
+ * DuckInterpreter::NoteBackEdge. Method to count back-edges.
+ * Counts the number of times a_target was reached by jumping backwards. Once the count goes over TRACE_HOT_THRESHOLD
+ * and there is no trace for a_target yet, the interpreter starts recording the statements executed from a_target.
+ * @param a_target int Statement number that the back-edge jumps to.
+ * @see RecordTraceStep
  */
-int DuckInterpreter::ParseNextElement(const string &a_statement, int a_nextPos, string &a_stringValue, double &numValue)
+void DuckInterpreter::NoteBackEdge(int a_target)
 {
-    // Holds the next string element
-    string str_element;
-    bool end_of_statement = false;
+    if(a_target >= (int)m_backEdgeCount.size())
+        m_backEdgeCount.resize(a_target + 1, 0);
     
+    // Only start a new recording if we are not already recording one and the loop header has no trace.
+    if(++m_backEdgeCount[a_target] <= TRACE_HOT_THRESHOLD || m_recordingAnchor != -1
+       || m_traces.find(a_target) != m_traces.end())
+        return;
     
-    istringstream line(a_statement.c_str(), (int)a_statement.size());
+    m_recordingAnchor = a_target;
+    m_recordBuffer.clear();
+}
+
+/**
+ * DuckInterpreter::RecordTraceStep. Method to record a step of a trace.
+ * Appends the statement that was just executed to the trace being recorded. The trace is complete when execution
+ * gets back to the loop header it started at. Traces that grow longer than TRACE_MAX_LENGTH are abandoned and the
+ * loop header is blacklisted so that we do not try to record it again.
+ * @param a_statement int Statement number that was executed.
+ * @param a_type StatementType Type of the executed statement.
+ * @param a_next int Statement number that was executed next. Used as the guard during replay.
+ */
+void DuckInterpreter::RecordTraceStep(int a_statement, StatementType a_type, int a_next)
+{
+    TraceEntry entry;
+    entry.m_statement = a_statement;
+    entry.m_type = a_type;
+    entry.m_next = a_next;
+    m_recordBuffer.push_back(entry);
     
-    for(int i=0;i<=a_nextPos;i++)
+    // Loop closed. Install the trace.
+    if(a_next == m_recordingAnchor)
     {
-        str_element="";
-        line>>str_element;
+        m_traces[m_recordingAnchor].m_entries.swap(m_recordBuffer);
+        m_recordingAnchor = -1;
+        return;
     }
     
-    // Checking for end of statement semi-colon and removing it
-    if(str_element.find(";") != string::npos && str_element.find(";")==str_element.length()-1 &&str_element.length()>1)
+    // Loop is too irregular to be worth tracing.
+    if((int)m_recordBuffer.size() > TRACE_MAX_LENGTH)
     {
-        str_element.pop_back();
-        end_of_statement = true;
+        m_traces[m_recordingAnchor].m_blacklisted = true;
+        m_recordBuffer.clear();
+        m_recordingAnchor = -1;
     }
+}
+
+/**
+ * DuckInterpreter::RunTrace. Method to replay a recorded trace.
+ * Executes the recorded statements of a hot loop in order, without looking them up again. Goto statements in the
+ * trace are skipped since their target is already known, unless they enter a loop with hoisted temporaries. Every
+ * other statement acts as a guard: if the statement that follows it is not the one that followed it while recording
+ * (e.g. an if ... goto took the other branch), we leave the trace and return to normal interpretation at that
+ * statement. We also leave the trace at the loop header when a safe point is due.
+ * @param a_trace const Trace The trace to replay.
+ * @param a_anchor int Statement number of the loop header that the trace starts at.
+ * @return int Next statement number to execute after leaving the trace.
+ * @see ExecuteStatement
+ */
+int DuckInterpreter::RunTrace(const Trace &a_trace, int a_anchor)
+{
+    const vector<TraceEntry> &entries = a_trace.m_entries;
     
-    // Checking if it is a number.
-    // The number is captured in numValue and a_stringValue is set to "NULL".
-    if(isdigit(str_element[0]))
+    while(true)
     {
-        numValue = atoi(str_element.c_str());
-        a_stringValue = "NULL";
+        for(size_t i = 0; i < entries.size(); i++)
+        {
+            const TraceEntry &entry = entries[i];
+            
+            // The jump is resolved already, unless it enters a loop.
+            const CompiledStatement &statement = m_compiled[entry.m_statement];
+            if(entry.m_type == StatementType::GotoStat && statement.m_loopEntries.empty())
+                continue;
+            
+            m_flightRecorder.Record(entry.m_statement);
+            m_programCounter.store(entry.m_statement, memory_order_relaxed);
+            int next = ExecuteStatement(statement, entry.m_statement);
+            if(!statement.m_loopEntries.empty())
+                EnterLoops(statement, next);
+            
+            // Guard failed. Leave the trace.
+            if(next != entry.m_next)
+                return next;
+        }
+        
+        // Back at the loop header. Leave the trace if a safe point is due.
+        m_safePointCountdown -= (int)entries.size();
+        if(m_safePointCountdown <= 0)
+            return a_anchor;
     }
-    // Checking if it is a string.
-    // The string is captured in a_stringValue and numValue is set to INT_MAX.
-    else
+}
+
+/**
+ * DuckInterpreter::AtSafePoint. Method called between statements.
+ * Called by RunInterpreter every SAFE_POINT_INTERVAL statements, when no statement is being executed. In watch mode,
+ * this is where the source is reloaded if it has changed. Checkpoints are also written here, when one is requested
+ * by SIGUSR2 or when the checkpoint interval has passed. Both wait until the spawned regions are joined, since the
+ * regions run on copies of the variables and of the program.
+ * @see WriteCheckpoint
+ * @param a_nextStatement int The statement that would be executed next.
+ * @return int The statement to execute next.
+ * @see ReloadStatements
+ */
+int DuckInterpreter::AtSafePoint(int a_nextStatement)
+{
+    m_safePointCountdown = SAFE_POINT_INTERVAL;
+    if(!m_spawnedRegions.IsDone())
+        return a_nextStatement;
+    
+    if(!m_checkpointFileName.empty())
     {
-        a_stringValue = str_element;
-        numValue = INT_MAX;
+        m_statementsSinceCheckpoint += SAFE_POINT_INTERVAL;
+        if(s_checkpointRequested || (m_checkpointInterval > 0 && m_statementsSinceCheckpoint >= m_checkpointInterval))
+        {
+            s_checkpointRequested = 0;
+            m_statementsSinceCheckpoint = 0;
+            WriteCheckpoint(a_nextStatement);
+        }
     }
     
-    // If the end of statement is reached, we return INT_MAX
-    if(end_of_statement || str_element == ";")
-        return INT_MAX;
+    if(m_watch)
+    {
+        string stamp = GetSourceStamp();
+        if(stamp != m_sourceStamp)
+        {
+            m_sourceStamp = stamp;
+            a_nextStatement = ReloadStatements(a_nextStatement);
+        }
+    }
     
-    // Returning the next element number
-    a_nextPos++;
-    return a_nextPos;
+    return a_nextStatement;
 }
 
 /**
- * DuckInterpreter::InsideQuotes. Quote checker method.
- * Checks if a_checkItem, which is a substring of a_string, is inside quotes in the string.
- * @param a_checkItem string Item to check if it is inside quotation.
- * @param a_string string The main string that has check_item in it.
- * @return bool True/False whether a_checkItem is inside quotations or not.
- * @author Salil Maharjan
- * @date 03/13/19
+ * DuckInterpreter::EnableCheckpoints. Method to enable checkpoints.
+ * Checkpoints are written to a_fileName every a_interval statements, rounded up to the next safe point, and at the
+ * next safe point after the process receives SIGUSR2.
+ * @param a_fileName const string File that the snapshots are written to.
+ * @param a_interval long Number of statements between checkpoints. 0 to only write them on SIGUSR2.
+ * @see WriteCheckpoint
  */
-bool DuckInterpreter::InsideQuotes(string a_checkItem, string a_string)
+void DuckInterpreter::EnableCheckpoints(const string &a_fileName, long a_interval)
 {
-    // Checking if there is quotations in statement
-    if(a_string.find("\"") != string::npos)
-    {
-        if(a_string.find("\"") < a_string.find(a_checkItem))
-            return true;
-        else
-            return false;
-    }
-    else
-        return false;
+    m_checkpointFileName = a_fileName;
+    m_checkpointInterval = a_interval;
+    signal(SIGUSR2, RequestCheckpoint);
 }
 
 /**
- * DuckInterpreter::IsCommented. Comment checker method.
- * Checks if a_checkItem, which is a substring of a_string, is commented or not.
- * @param a_checkItem string Item to check if it is commented.
- * @param a_string string The main string that has check_item in it.
- * @return bool True/False whether a_checkItem is after comments or not.
- * @author Salil Maharjan
- * @date 03/13/19
+ * DuckInterpreter::WriteCheckpoint. Method to write a snapshot of the interpreter state.
+ * The snapshot holds the magic and version of the format, the hash of the program, the next statement to execute,
+ * the position of standard input (-1 if it cannot be seeked), the symbol table and the return stack of gosub. It is
+ * built in memory, written to a temporary file and renamed over the snapshot file, so that the snapshot file is always
+ * complete.
+ * @param a_nextStatement int The statement to execute when the snapshot is resumed.
+ * @see ResumeFromSnapshot
+ * @see SymbolTable::SaveVariables
  */
-bool DuckInterpreter::IsCommented(string a_checkItem, string a_string)
+void DuckInterpreter::WriteCheckpoint(int a_nextStatement)
 {
-    // Checking if there are comments in the statement
-    if(a_string.find("//") != string::npos)
+    string snapshot(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    uint32_t version = SNAPSHOT_VERSION;
+    uint64_t programHash = m_statements.GetProgramHash();
+    int32_t nextStatement = a_nextStatement;
+    int64_t inputPosition = ftell(stdin);
+    snapshot.append((const char *)&version, sizeof(version));
+    snapshot.append((const char *)&programHash, sizeof(programHash));
+    snapshot.append((const char *)&nextStatement, sizeof(nextStatement));
+    snapshot.append((const char *)&inputPosition, sizeof(inputPosition));
+    m_symbolTable.SaveVariables(snapshot);
+    
+    // Return stack of the gosub statements in progress.
+    uint32_t returnCount = (uint32_t)m_returnStack.size();
+    snapshot.append((const char *)&returnCount, sizeof(returnCount));
+    snapshot.append((const char *)m_returnStack.data(), returnCount * sizeof(int32_t));
+    
+    string tempFileName = m_checkpointFileName + ".tmp";
+    int fd = open(tempFileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0)
     {
-        if(a_string.find("//") < a_string.find(a_checkItem))
-            return true;
-        else
-            return false;
+        cerr << "Could not write the checkpoint: " << tempFileName << endl;
+        return;
     }
-    else
-        return false;
+    
+    const char *data = snapshot.data();
+    size_t left = snapshot.size();
+    while(left > 0)
+    {
+        ssize_t written = write(fd, data, left);
+        if(written <= 0)
+        {
+            cerr << "Could not write the checkpoint: " << tempFileName << endl;
+            close(fd);
+            return;
+        }
+        data += written;
+        left -= written;
+    }
+    fsync(fd);
+    close(fd);
+    
+    if(rename(tempFileName.c_str(), m_checkpointFileName.c_str()) != 0)
+        cerr << "Could not write the checkpoint: " << m_checkpointFileName << endl;
 }
 
 /**
- * DuckInterpreter::GetStatementStype. Method that gets the Statement type.
- * Finds the statement type of a_string and returns it. Checks for specific identifiers that each statement has, does checks for comments and quotes and determines the statement type.
- * @param a_string const string String to find out the statement type of.
- * @return DuckInterpreter::StatementType The Statement Type of the passed string.
- * @see InsideQuotes
- * @see IsCommented
- * @author Salil Maharjan
- * @date 03/13/19
+ * DuckInterpreter::ResumeFromSnapshot. Method to resume from a snapshot.
+ * Maps the snapshot file written by WriteCheckpoint, checks that it was taken from the same program, and restores the
+ * symbol table, the return stack, the position of standard input and the statement to start from. Terminates if the
+ * snapshot cannot be used, or if its statements are not in the program.
+ * @param a_fileName const string The snapshot file.
+ * @see WriteCheckpoint
+ * @see SymbolTable::RestoreVariables
  */
-DuckInterpreter::StatementType DuckInterpreter::GetStatementStype(const string &a_string)
+void DuckInterpreter::ResumeFromSnapshot(const string &a_fileName)
 {
-    // Checking for whole line comments
-    if(a_string.find("//") != string::npos)
+    int fd = open(a_fileName.c_str(), O_RDONLY);
+    struct stat info;
+    if(fd < 0 || fstat(fd, &info) != 0)
     {
-        if(a_string.find(";") < a_string.find("//")){}
-        else
-            return StatementType::CommentStat;
+        cerr << "Could not open the snapshot: " << a_fileName << endl;
+        exit(1);
     }
     
-    // Checking for if statements
-    if(a_string.find("if") != string::npos)
+    size_t size = info.st_size;
+    const char *mapped = (const char *)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(size == 0 || mapped == MAP_FAILED)
     {
-        if(InsideQuotes("if", a_string) || IsCommented("if", a_string)){}
-        else
-            return StatementType::IfStat;
+        cerr << "Could not read the snapshot: " << a_fileName << endl;
+        exit(1);
     }
-    // Checking for read statements
-    else if(a_string.find("read") != string::npos)
+    
+    const char *data = mapped;
+    const char *end = mapped + size;
+    uint32_t version;
+    uint64_t programHash;
+    int32_t nextStatement;
+    int64_t inputPosition;
+    size_t headerSize = sizeof(SNAPSHOT_MAGIC) + sizeof(version) + sizeof(programHash) + sizeof(nextStatement) + sizeof(inputPosition);
+    
+    // Checking the header.
+    if(size < headerSize || memcmp(data, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0)
     {
-        if(InsideQuotes("read", a_string) || IsCommented("read", a_string)){}
-        else
-            return StatementType::ReadStat;
+        cerr << "Invalid snapshot: " << a_fileName << endl;
+        exit(1);
     }
-    // Checking for print statements
-    else if(a_string.find("print") != string::npos)
+    data += sizeof(SNAPSHOT_MAGIC);
+    memcpy(&version, data, sizeof(version));
+    data += sizeof(version);
+    memcpy(&programHash, data, sizeof(programHash));
+    data += sizeof(programHash);
+    memcpy(&nextStatement, data, sizeof(nextStatement));
+    data += sizeof(nextStatement);
+    memcpy(&inputPosition, data, sizeof(inputPosition));
+    data += sizeof(inputPosition);
+    
+    if(version != SNAPSHOT_VERSION)
     {
-        if(InsideQuotes("print", a_string) || IsCommented("print", a_string)){}
-        else
-            return StatementType::PrintStat;
+        cerr << "Unsupported snapshot version " << version << ": " << a_fileName << endl;
+        exit(1);
     }
-    // Checking for stop statements
-    else if(a_string.find("stop;") != string::npos || a_string.find("stop ;") != string::npos)
+    if(programHash != m_statements.GetProgramHash())
     {
-        if(InsideQuotes("stop", a_string) || IsCommented("stop", a_string)){}
-        else
-            return StatementType::StopStat;
+        cerr << "The snapshot was taken from a different program: " << a_fileName << endl;
+        exit(1);
     }
-    // Checking for end statements
-    else if(a_string.find("end;") != string::npos || a_string.find("end ;") != string::npos)
+    if(!m_symbolTable.RestoreVariables(data, end))
     {
-        if(InsideQuotes("end", a_string) || IsCommented("end", a_string)){}
-        else
-            return StatementType::EndStat;
+        cerr << "Invalid snapshot: " << a_fileName << endl;
+        exit(1);
     }
-    // Checking for goto statements
-    else if(a_string.find("goto") != string::npos)
+    
+    // Restoring the return stack.
+    uint32_t returnCount = 0;
+    if(end - data >= (ptrdiff_t)sizeof(returnCount))
     {
-        if(InsideQuotes("goto", a_string) || IsCommented("goto", a_string)){}
-        else
-            return StatementType::GotoStat;
+        memcpy(&returnCount, data, sizeof(returnCount));
+        data += sizeof(returnCount);
     }
-    // Else it is a arithmetic statement.
-    else
+    if(returnCount > RETURN_STACK_DEPTH || end - data < (ptrdiff_t)(returnCount * sizeof(int32_t)))
     {
-        // If we cannot find a ';', it means that the statement is invalid.
-        // And we cannot determine the statement type.
-        if(a_string.find(";")==string::npos)
-        {
-            cerr<< "Invalid statement type!"<<endl;
-            cerr<<"Statement: "<< a_string<<endl;
-            exit(1);
-        }
-        return StatementType::ArithmeticStat;
+        cerr << "Invalid snapshot: " << a_fileName << endl;
+        exit(1);
     }
+    m_returnStack.resize(returnCount);
+    memcpy(m_returnStack.data(), data, returnCount * sizeof(int32_t));
     
-    cerr<<"Cannot determine statement type."<<endl;
-    exit(1);
+    munmap((void *)mapped, size);
+    
+    // The program hash matched, but the statements to go on at are still checked against the program, so that a
+    // corrupted snapshot is reported instead of running from outside of it.
+    int statementCount = m_statements.GetStatementCount();
+    bool inProgram = nextStatement >= 0 && nextStatement < statementCount;
+    for(int returnStatement : m_returnStack)
+        inProgram = inProgram && returnStatement >= 0 && returnStatement <= statementCount;
+    if(!inProgram)
+    {
+        cerr << "Invalid snapshot: " << a_fileName << endl;
+        exit(1);
+    }
+    
+    // Input that was already read by the program is skipped.
+    if(inputPosition >= 0 && fseek(stdin, inputPosition, SEEK_SET) != 0)
+        cerr << "Could not restore the position of the input." << endl;
+    
+    m_startStatement = nextStatement;
+    
+    // The temporaries of the optimizer were not saved. They are computed from the restored variables.
+    ComputeTemporaries();
 }
 
+/**
+ * DuckInterpreter::GetSourceStamp. Method to get the modification stamp of the source.
+ * Gets the modification time and the size of the source file as a string. The stamp changes when the file is edited.
+ * @return string The stamp of the source file. Empty if the file cannot be found.
+ */
+string DuckInterpreter::GetSourceStamp()
+{
+    struct stat info;
+    if(stat(m_sourceFileName.c_str(), &info) != 0)
+        return "";
+    
+    ostringstream stamp;
+    stamp << info.st_mtim.tv_sec << "." << info.st_mtim.tv_nsec << ":" << info.st_size;
+    return stamp.str();
+}
 
 /**
- * DuckInterpreter::EvaluateArithmeticStatement. Method to Evaluate Arithmetic Statements.
- * We know at this point that we have an arithementic expression. Execute this statement.  Any error will perminate the program.
- * The function first checks for unary arithmetic statements, if not the statement is evaluated by getting the result variable,
- * the assignment operator and then evaluating the rest of the arithmetic statement by calling EvaluateArithmeticExpression
- * @param a_statement const string String to find out the statement type of.
- * @see EvaluateArithmeticExpression
- * @see SymbolTable::GetVariableValue
- * @see SymbolTable::RecordVariableValue
- * @author Salil Maharjan
- * @date 03/13/19
+ * DuckInterpreter::ReloadStatements. Method to reload the source.
+ * Reads the edited source once, checks that it loads in a child process, and then loads the same text here. Loading
+ * errors exit, and the whole point of watch mode is to keep the program running, so a source that can not be read or
+ * does not load is reported and the program keeps running as it was. It is loaded once it is edited again.
+ * @param a_nextStatement int The statement that would be executed next in the old source.
+ * @return int The statement to execute next in the new source.
+ * @see ProbeReload
+ * @see ApplyReload
  */
-void DuckInterpreter::EvaluateArithmeticStatement(const string &a_statement)
+int DuckInterpreter::ReloadStatements(int a_nextStatement)
 {
-    // Checking for unary operation
-    // Unary Addition Case:
-    if(a_statement.find("++") != string::npos)
+    string source;
+    if(!Statement::ReadSource(m_sourceFileName, source))
     {
-        // Get the variable
-        string temp = a_statement.substr(0,(a_statement.find("++")-1));
-        
-        // Perform unary addition
-        double temp_value;
-        if(m_symbolTable.GetVariableValue(temp, temp_value)==false)
-        {
-            cerr << "Invalid variable: " << temp;
-            cerr << "Cannot find value" <<endl;
-            exit(1);
-        }
-        
-        // Performing unary addition and recording the value.
-        temp_value++;
-        m_symbolTable.RecordVariableValue(temp, temp_value);
-        
-        return;
+        cerr << "Could not read the file: " << m_sourceFileName << ". The program keeps running unchanged." << endl;
+        return a_nextStatement;
     }
-    
-    // Unary Subtraction
-    if(a_statement.find("--") != string::npos)
+    if(!ProbeReload(source, a_nextStatement))
     {
-        // Get the variable
-        string temp = a_statement.substr(0,(a_statement.find("--")-1));
-        
-        // Perform unary subtraction
-        double temp_value;
-        if(m_symbolTable.GetVariableValue(temp, temp_value)==false)
-        {
-            cerr << "Invalid variable: " << temp;
-            cerr << "Cannot find value" <<endl;
-            exit(1);
-        }
-        
-        // Performing unary subtraction and recording the value.
-        temp_value--;
-        m_symbolTable.RecordVariableValue(temp, temp_value);
+        cerr << "The edited source was not loaded. The program keeps running unchanged." << endl;
+        return a_nextStatement;
+    }
+    return ApplyReload(source, a_nextStatement);
+}
+
+/**
+ * DuckInterpreter::ProbeReload. Method to check that an edited source loads.
+ * Forks a child that applies the reload to its copy of the interpreter, with its output discarded and its loading
+ * errors on the standard error. The child runs the same code on the same state as ApplyReload would here, so if it
+ * does not exit with an error, neither will ApplyReload. A source is also refused if it has no statement to go on
+ * at, like a file that is being written and is still empty. The child does not dump the flight recorder when it
+ * exits with an error, since its records are the ones of this process.
+ * @param a_source const string The text of the edited source.
+ * @param a_nextStatement int The statement that would be executed next in the old source.
+ * @return bool True if the child did not exit with an error.
+ * @see ApplyReload
+ */
+bool DuckInterpreter::ProbeReload(const string &a_source, int a_nextStatement)
+{
+    cout.flush();
+    pid_t child = fork();
+    if(child == 0)
+    {
+        if(m_asyncOutput != NULL)
+            m_asyncOutput->AbandonInChild();
+        // Loading errors exit with a non-zero status, which would dump the records of this process to its trace file.
+        m_flightRecorder.Uninstall();
+        int discard = open("/dev/null", O_WRONLY);
+        dup2(discard, STDOUT_FILENO);
         
-        return;
+        // The program goes on at the statement returned, which is not there in a source that was cut short.
+        int nextStatement = ApplyReload(a_source, a_nextStatement);
+        _exit(nextStatement < m_statements.GetStatementCount() ? 0 : 1);
     }
     
-    // If we get here, the expression is not unary.
+    int status = 0;
+    if(child == -1 || waitpid(child, &status, 0) != child)
+        return false;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
 
-    // Record the variable that we will be assignning a value.
-    int nextPos = 0;
-    string resultVariable;
-    double placeHolder;
-    nextPos = ParseNextElement(a_statement, nextPos, resultVariable, placeHolder);
-    assert(!resultVariable.empty());
+/**
+ * DuckInterpreter::ApplyReload. Method to swap in an edited source.
+ * Records the statements of the edited source and swaps them in. Lines at the start and at the end of the source that
+ * did not change keep their compiled statements, only the changed lines in between are compiled again when they are
+ * reached. Lines are compared by their hashes, and then by their text. The labels of kept goto and if ... goto
+ * statements are resolved again, since lines may have moved. The symbol table is kept, so the program carries on with
+ * its current variables.
+ * If the next statement was in an unchanged line, execution continues at that line. Otherwise it continues at the
+ * first changed line. Return statements of the gosub statements in progress are moved the same way. The edited
+ * program is analyzed from there, with the variables assigned so far.
+ * @param a_source const string The text of the edited source.
+ * @param a_nextStatement int The statement that would be executed next in the old source.
+ * @return int The statement to execute next in the new source.
+ * @see Statement::RecordSource
+ * @see Statement::GetSourceHash
+ */
+int DuckInterpreter::ApplyReload(const string &a_source, int a_nextStatement)
+{
+    Statement reloaded;
+    reloaded.RecordSource(a_source, m_sourceFileName);
     
-    // Recording and checking for an assignment operator.
-    string assigmentOp;
-    nextPos = ParseNextElement(a_statement, nextPos, assigmentOp, placeHolder);
-    assert(assigmentOp == "=");
+    int oldCount = m_statements.GetStatementCount();
+    int newCount = reloaded.GetStatementCount();
     
-    // Evaluating the rest of the arithmetic statement.
-    double result = EvaluateArithmenticExpression(a_statement, nextPos);
+    // Checks whether line a_old of the old source and line a_new of the edited one are the same.
+    auto sameLine = [&](int a_old, int a_new)
+    {
+        return m_statements.GetSourceHash(a_old) == reloaded.GetSourceHash(a_new)
+               && m_statements.GetRecordedStatement(a_old) == reloaded.GetRecordedStatement(a_new);
+    };
     
-    // Record the result.
-    m_symbolTable.RecordVariableValue(resultVariable, result);
+    // Finding the unchanged lines at the start and at the end.
+    int prefix = 0;
+    while(prefix < oldCount && prefix < newCount && sameLine(prefix, prefix))
+        prefix++;
+    int suffix = 0;
+    while(suffix < oldCount - prefix && suffix < newCount - prefix && sameLine(oldCount-1-suffix, newCount-1-suffix))
+        suffix++;
     
-}
-
+    // Keeping the compiled statements of the unchanged lines.
+    vector<CompiledStatement> compiled(newCount);
+    for(int i = 0; i < prefix; i++)
+        swap(compiled[i], m_compiled[i]);
+    for(int i = 0; i < suffix; i++)
+        swap(compiled[newCount-1-i], m_compiled[oldCount-1-i]);
+    
+    // Resolving the labels again. Statements whose label is gone are compiled again, and report it, when reached.
+    // So are the statements that the peephole optimizer rewrote based on other statements, which may have changed.
+    for(int i = 0; i < newCount; i++)
+    {
+        if(compiled[i].m_rewritten || (compiled[i].m_parsed && !compiled[i].m_label.empty()
+           && !reloaded.FindLabelLocation(compiled[i].m_label, compiled[i].m_labelLocation)))
+            compiled[i] = CompiledStatement();
+    }
+    
+    m_statements = reloaded;
+    m_compiled.swap(compiled);
+    
+    // Traces refer to the old statement numbers.
+    m_traces.clear();
+    m_backEdgeCount.clear();
+    m_recordingAnchor = -1;
+    m_recordBuffer.clear();
+    
+    // Gets the statement of the new source that takes the place of a_statement.
+    auto moveStatement = [&](int a_statement)
+    {
+        if(a_statement < prefix)
+            return a_statement;
+        if(a_statement >= oldCount - suffix)
+            return a_statement + (newCount - oldCount);
+        return prefix;
+    };
+    
+    for(int &returnStatement : m_returnStack)
+        returnStatement = moveStatement(returnStatement);
+    
+    DeclareSharedVariables();
+    int nextStatement = moveStatement(a_nextStatement);
+    AnalyzeProgram(nextStatement);
+    return nextStatement;
+}
+
 /**
- * DuckInterpreter::GetOperatorPrecedence. Method to get the operator precedence.
- * Checks a_operator and returns the precedence of the operator. Used by EvaluateArithmeticExpression.
- * @param a_operator const string String to find out the statement type of.
- * @return int The precedence of the passed operator 'a_operator'
- * @author Salil Maharjan
- * @date 03/13/19
+ * DuckInterpreter::GetCompiledStatement. Accessor to get a compiled statement.
+ * Returns the compiled form of statement number a_statementNum. The statement is compiled and cached the first time
+ * it is reached, so statements that never run are never parsed.
+ * @param a_statementNum int Statement number.
+ * @return const CompiledStatement The compiled statement.
+ * @see CompileStatement
+ * @see Statement::GetStatement
  */
-int DuckInterpreter::GetOperatorPrecedence(string a_operator)
+const DuckInterpreter::CompiledStatement &DuckInterpreter::GetCompiledStatement(int a_statementNum)
 {
-    if(a_operator == ";")
-        return 1;
-    if(a_operator == "(" || a_operator == ")")
-        return 2;
-    if(a_operator == "==" || a_operator == "!=" || a_operator == ">=" || a_operator == "<="
-       || a_operator == ">" || a_operator == "<")
-        return 3;
-    if (a_operator == "+" || a_operator == "-")
-        return 4;
-    if (a_operator == "*" || a_operator == "/" || a_operator == "%")
-        return 5;
-    return 0;
+    // Invalid statement numbers are reported by Statement::GetStatement.
+    if(a_statementNum < 0 || a_statementNum >= (int)m_compiled.size())
+        m_statements.GetStatement(a_statementNum);
+    
+    CompiledStatement &compiled = m_compiled[a_statementNum];
+    if(!compiled.m_compiled)
+    {
+        GetParsedStatement(a_statementNum);
+        if(m_optimize)
+            OptimizeStatement(a_statementNum, compiled);
+        compiled.m_compiled = true;
+    }
+    
+    return compiled;
 }
 
 /**
- * DuckInterpreter::DoOperation. Method to perform arithmetic operations.
- * Does 'a_operation' on 'a_val1' and 'a_val2'. Used by EvaluateArithmeticExpression.
- * @param a_val1 double Holds the first value to perform operation with.
- * @param a_val2 double Holds the second value to perform operation with.
- * @param a_operation string String that holds what operation is to be performed.
- * @return double The result of performing operation "a_operation" on "a_val1" and "a_val2".
- * @author Salil Maharjan
- * @date 03/13/19
+ * DuckInterpreter::GetParsedStatement. Accessor to get a parsed statement.
+ * Returns statement number a_statementNum as compiled by CompileStatement, before the peephole optimizer has seen it.
+ * Used by the peephole optimizer to look at other statements without optimizing them in turn.
+ * @param a_statementNum int Statement number.
+ * @return CompiledStatement The parsed statement.
+ * @see CompileStatement
+ * @see OptimizeStatement
  */
-double DuckInterpreter::DoOperation(double a_val1, double a_val2, string a_operation)
-{
-    if(a_operation == "+")
-        return a_val1 + a_val2;
-    if(a_operation == "-")
-        return a_val1 - a_val2;
-    if(a_operation == "*")
-        return a_val1 * a_val2;
-    if(a_operation == "/")
-        return a_val1 / a_val2;
-    if(a_operation == "%")
-        return fmod(a_val1,a_val2);
-    if(a_operation == "<")
-        return (a_val1 < a_val2);
-    if(a_operation == "<=")
-        return (a_val1 <= a_val2);
-    if(a_operation == ">")
-        return (a_val1 > a_val2);
-    if(a_operation == ">=")
-        return (a_val1 >= a_val2);
-    if(a_operation == "==")
-        return (a_val1 == a_val2);
-    if(a_operation == "!=")
-        return (a_val1 != a_val2);
-    else
+DuckInterpreter::CompiledStatement &DuckInterpreter::GetParsedStatement(int a_statementNum)
+{
+    CompiledStatement &compiled = m_compiled[a_statementNum];
+    if(!compiled.m_parsed)
+        CompileStatement(m_statements.GetStatement(a_statementNum), compiled);
+    return compiled;
+}
+
+/**
+ * DuckInterpreter::OptimizeStatement. Peephole optimizer.
+ * Rewrites the parsed statement a_compiled, using the statements it jumps to and the statement before it:
+ * - A goto or an if ... goto to the very next statement does nothing. Conditions do not have side effects, so they do
+ *   not need to be evaluated.
+ * - Other jumps to a goto statement jump to the end of the chain of gotos instead (jump threading).
+ * - y = x; right after x = y; does nothing, unless it has a label and can be reached from elsewhere.
+ * - x = x + c; and x = x - c; are run as increments, without evaluating an expression.
+ * - x = x + e; and x = x - e; are atomic additions when x is shared, so that the threads do not lose each other's
+ *   additions between the load of x and its store. So are increments of shared variables.
+ * Copies of shared variables are never redundant, since other threads can change them in between.
+ * Statements rewritten based on other statements are marked, so that they are compiled again when those change.
+ * @param a_statementNum int Statement number of a_compiled.
+ * @param a_compiled CompiledStatement The statement to optimize.
+ * @see ThreadJump
+ * @see ReportStatistics
+ */
+void DuckInterpreter::OptimizeStatement(int a_statementNum, CompiledStatement &a_compiled)
+{
+    StatementType type = a_compiled.m_type;
+    
+    // Jumps to the next statement.
+    if((type == StatementType::GotoStat || type == StatementType::IfStat) && a_compiled.m_labelLocation == a_statementNum + 1)
     {
-        cerr<< " Cannot do operation" << a_operation << endl;
-        exit(1);
+        bool sideEffects = false;
+        for(const Instruction &instruction : a_compiled.m_code)
+            sideEffects |= instruction.m_op == OpCode::CallBuiltin && !instruction.m_builtin->m_pure;
+        
+        if(!sideEffects)
+        {
+            a_compiled.m_type = StatementType::CommentStat;
+            a_compiled.m_code.clear();
+            a_compiled.m_rewritten = true;
+            m_peepholeHits[PEEPHOLE_JUMP_TO_NEXT]++;
+            return;
+        }
+    }
+    
+    // Jump threading.
+    if(type == StatementType::GotoStat || type == StatementType::IfStat || type == StatementType::GosubStat)
+    {
+        int target = ThreadJump(a_compiled.m_labelLocation);
+        if(target != a_compiled.m_labelLocation)
+        {
+            a_compiled.m_labelLocation = target;
+            a_compiled.m_rewritten = true;
+            m_peepholeHits[PEEPHOLE_JUMP_THREADING]++;
+        }
+    }
+    
+    // The rest only applies to assignments of a variable.
+    if(type != StatementType::ArithmeticStat || a_compiled.m_unaryStep != 0 || !a_compiled.m_arrayName.empty())
+        return;
+    const string &variable = a_compiled.m_elements[0].m_string;
+    const vector<Instruction> &code = a_compiled.m_code;
+    
+    // Copying back a variable that was just copied.
+    if(code.size() == 1 && code[0].m_op == OpCode::LoadVariable && a_statementNum > 0
+       && !m_statements.HasLabel(a_statementNum) && a_compiled.m_sharedValue == NULL && GetSharedValue(code[0].m_name) == NULL)
+    {
+        const CompiledStatement &previous = GetParsedStatement(a_statementNum - 1);
+        if(previous.m_type == StatementType::ArithmeticStat && previous.m_unaryStep == 0 && previous.m_arrayName.empty()
+           && previous.m_code.size() == 1 && previous.m_code[0].m_op == OpCode::LoadVariable
+           && previous.m_code[0].m_name == variable && previous.m_elements[0].m_string == code[0].m_name)
+        {
+            a_compiled.m_type = StatementType::CommentStat;
+            a_compiled.m_code.clear();
+            a_compiled.m_rewritten = true;
+            m_peepholeHits[PEEPHOLE_REDUNDANT_COPY]++;
+            return;
+        }
+    }
+    
+    // Adding a constant to the variable itself.
+    if(code.size() == 3 && (code[2].m_op == OpCode::Add || code[2].m_op == OpCode::Subtract))
+    {
+        double step = 0;
+        bool increment = false;
+        if(code[0].m_op == OpCode::LoadVariable && code[0].m_name == variable && code[1].m_op == OpCode::PushNumber)
+        {
+            step = code[2].m_op == OpCode::Add ? code[1].m_number : -code[1].m_number;
+            increment = true;
+        }
+        else if(code[2].m_op == OpCode::Add && code[0].m_op == OpCode::PushNumber
+                && code[1].m_op == OpCode::LoadVariable && code[1].m_name == variable)
+        {
+            step = code[0].m_number;
+            increment = true;
+        }
+        
+        // The operands of the addition are truncated, the variable when the increment runs.
+        step = code[2].m_op == OpCode::Subtract ? -TruncateOperand(-step) : TruncateOperand(step);
+        if(increment && step != 0)
+        {
+            a_compiled.m_unaryVariable = variable;
+            a_compiled.m_unaryStep = step;
+            a_compiled.m_unaryTruncates = true;
+            m_peepholeHits[PEEPHOLE_INCREMENT]++;
+            return;
+        }
+    }
+    
+    // Adding an expression to a shared variable. The expression is the other operand of the last operation, which
+    // must not read the variable.
+    vector<Subexpression> subexpressions;
+    int last = (int)code.size() - 1;
+    if(a_compiled.m_sharedValue != NULL && last >= 2 && (code[last].m_op == OpCode::Add || code[last].m_op == OpCode::Subtract)
+       && FindSubexpressions(code, subexpressions))
+    {
+        int rightStart = subexpressions[last-1].m_start;
+        auto readsVariable = [&](int a_start, int a_end)
+        {
+            for(int i = a_start; i <= a_end; i++)
+            {
+                if(code[i].m_op == OpCode::LoadVariable && code[i].m_name == variable)
+                    return true;
+            }
+            return false;
+        };
+        
+        vector<Instruction> &rewritten = a_compiled.m_code;
+        if(rightStart == 1 && code[0].m_op == OpCode::LoadVariable && code[0].m_name == variable
+           && !readsVariable(1, last-1))
+        {
+            a_compiled.m_accumulate = code[last].m_op == OpCode::Add ? 1 : -1;
+            rewritten.pop_back();
+            rewritten.erase(rewritten.begin());
+        }
+        else if(code[last].m_op == OpCode::Add && rightStart == last-1 && code[last-1].m_op == OpCode::LoadVariable
+                && code[last-1].m_name == variable && !readsVariable(0, last-2))
+        {
+            a_compiled.m_accumulate = 1;
+            rewritten.resize(last-1);
+        }
+        if(a_compiled.m_accumulate != 0)
+            m_peepholeHits[PEEPHOLE_ATOMIC_ADD]++;
     }
 }
 
 /**
- * DuckInterpreter::EvaluateArithmenticExpression. Method to perform arithmetic operations.
- * Evaluate an arithmetic expression that is after the assignment operator (=). Used by EvaluateArithmeticStatement.
- * @param a_statement const string Holds the entire arithmetic expression.
- * @param a_nextPos int Holds the value of the first position after the assignment operator to start evaluating the statement.
- * @return double The final result of the arithmetic expression in "a_statement".
+ * DuckInterpreter::ThreadJump. Method to thread jumps.
+ * Follows the goto statements starting at a_target, so that a jump to a_target can go straight to the end of the
+ * chain. Stops after as many steps as there are statements, so loops of goto statements end.
+ * @param a_target int Statement number that a jump goes to.
+ * @return int Statement number at the end of the chain of gotos.
+ * @see OptimizeStatement
+ */
+int DuckInterpreter::ThreadJump(int a_target)
+{
+    for(int steps = 0; steps < m_statements.GetStatementCount(); steps++)
+    {
+        if(a_target < 0 || a_target >= m_statements.GetStatementCount())
+            break;
+        
+        const CompiledStatement &target = GetParsedStatement(a_target);
+        if(target.m_type != StatementType::GotoStat)
+            break;
+        a_target = target.m_labelLocation;
+    }
+    return a_target;
+}
+
+/**
+ * DuckInterpreter::ReportStatistics. Method to report statistics.
+ * Prints the statistics asked for on the command line to standard error. With --opt-stats, that is the number of
+ * statements rewritten by each rule of the peephole optimizer. With --stats, the performance counters read while the
+ * interpreter ran, with their cost per statement executed, and the memory used to store the statements. With --sample,
+ * the statements and labels with the most samples, after the samples are written to the collapsed stack file.
+ * @see OptimizeStatement
+ */
+void DuckInterpreter::ReportStatistics()
+{
+    if(m_stats)
+    {
+        m_perfCounters.Stop();
+        cerr << "Performance counters:" << endl;
+        m_perfCounters.Report(cerr, m_flightRecorder.GetRecordCount());
+        
+        int statementCount = max(1, m_statements.GetStatementCount());
+        cerr << "Statement storage:" << endl;
+        cerr << "  " << left << setw(24) << "bytes" << right << setw(16) << m_statements.GetMemoryUsage()
+             << setw(14) << fixed << setprecision(2) << (double)m_statements.GetMemoryUsage() / statementCount
+             << " per statement" << defaultfloat << endl;
+    }
+    
+    if(!m_sampleFileName.empty())
+    {
+        m_sampler.Stop();
+        ofstream collapsed(m_sampleFileName);
+        m_sampler.WriteCollapsed(collapsed, m_statements);
+        if(!collapsed)
+            cerr << "Could not write the samples to " << m_sampleFileName << endl;
+        m_sampler.Report(cerr, m_statements, m_sampleTop);
+    }
+    
+    if(m_optimizationStats)
+    {
+        cerr << "Peephole optimizer, statements rewritten per rule:" << endl;
+        for(int rule = 0; rule < PEEPHOLE_RULE_COUNT; rule++)
+            cerr << "  " << left << setw(24) << PEEPHOLE_RULE_NAMES[rule] << right << m_peepholeHits[rule] << endl;
+    }
+}
+
+/**
+ * DuckInterpreter::CompileStatement. Method to compile a statement.
+ * Does all the work on a_statement that does not depend on the values of variables: gets its type, splits it into
+ * elements, finds unary ++ and -- statements, and resolves the labels of goto and if ... goto statements.
+ * @param a_statement const string The statement to compile, in the standard space format.
+ * @param a_compiled CompiledStatement Receives the compiled statement.
+ * @see GetStatementStype
+ * @see SplitElements
+ * @see EvaluateIfGotoExpression
+ * @see Statement::GetLabelLocation
+ */
+void DuckInterpreter::CompileStatement(const string &a_statement, CompiledStatement &a_compiled)
+{
+    a_compiled.m_type = GetStatementStype(a_statement);
+    
+    string label;
+    double placeHolder;
+    
+    switch (a_compiled.m_type)
+    {
+        case StatementType::ArithmeticStat:
+            SplitElements(a_statement, a_compiled.m_elements, true);
+            
+            // Checking for an assignment to a string variable.
+            if(!a_compiled.m_elements.empty() && IsStringName(a_compiled.m_elements[0].m_string))
+            {
+                if(a_compiled.m_elements.size() < 3 || a_compiled.m_elements[1].m_string != "="
+                   || a_compiled.m_elements[1].m_endOfStatement)
+                {
+                    cerr << "Invalid string assignment: " << a_statement << endl;
+                    exit(1);
+                }
+                a_compiled.m_type = StatementType::StringStat;
+                int nextPos = CompileStringExpression(a_compiled.m_elements, 2, a_compiled.m_stringCode);
+                if(nextPos < (int)a_compiled.m_elements.size() && a_compiled.m_elements[nextPos].m_string != ";")
+                {
+                    cerr << "Invalid string expression: " << a_statement << endl;
+                    exit(1);
+                }
+                break;
+            }
+            
+            // Checking for unary addition and subtraction.
+            // The variable is the first element, so that the space left by a label is not part of it.
+            if(a_statement.find("++") != string::npos)
+                a_compiled.m_unaryStep = 1;
+            else if(a_statement.find("--") != string::npos)
+                a_compiled.m_unaryStep = -1;
+            if(a_compiled.m_unaryStep != 0)
+            {
+                // Unary addition and subtraction of an array element, whose index is evaluated once.
+                if(a_compiled.m_elements.size() > 1 && a_compiled.m_elements[1].m_string == "[")
+                {
+                    // The closing bracket and the operator are one element, since they are not spaced apart.
+                    for(int i = 2; i < (int)a_compiled.m_elements.size(); i++)
+                    {
+                        string &element = a_compiled.m_elements[i].m_string;
+                        if(element.size() > 2 && element[0] == ']'
+                           && (element.compare(1, string::npos, "++") == 0 || element.compare(1, string::npos, "--") == 0))
+                        {
+                            Element step = a_compiled.m_elements[i];
+                            step.m_string.erase(0, 1);
+                            element.erase(1);
+                            a_compiled.m_elements[i].m_endOfStatement = false;
+                            a_compiled.m_elements.insert(a_compiled.m_elements.begin() + i + 1, step);
+                            break;
+                        }
+                    }
+                    vector<Element> indexElements;
+                    a_compiled.m_arrayName = a_compiled.m_elements[0].m_string;
+                    int stepPos = SplitIndexElements(a_compiled.m_elements, 1, indexElements);
+                    if(stepPos >= (int)a_compiled.m_elements.size()
+                       || a_compiled.m_elements[stepPos].m_string != (a_compiled.m_unaryStep > 0 ? "++" : "--"))
+                    {
+                        cerr << "Invalid unary statement: " << a_statement << endl;
+                        exit(1);
+                    }
+                    CompileExpression(indexElements, 0, a_compiled.m_indexCode);
+                    break;
+                }
+                a_compiled.m_unaryVariable = a_compiled.m_elements.empty() ? "" : a_compiled.m_elements[0].m_string;
+                a_compiled.m_sharedValue = GetSharedValue(a_compiled.m_unaryVariable);
+                break;
+            }
+            
+            {
+                // Position of the assignment operator.
+                int valuePos = 1;
+                
+                // Checking for an assignment to an array element.
+                if(a_compiled.m_elements.size() > 1 && a_compiled.m_elements[1].m_string == "[")
+                {
+                    vector<Element> indexElements;
+                    a_compiled.m_arrayName = a_compiled.m_elements[0].m_string;
+                    valuePos = SplitIndexElements(a_compiled.m_elements, 1, indexElements);
+                    CompileExpression(indexElements, 0, a_compiled.m_indexCode);
+                }
+                
+                // Checking for an assignment operator.
+                if(valuePos >= (int)a_compiled.m_elements.size() || a_compiled.m_elements[valuePos].m_string != "="
+                   || a_compiled.m_elements[valuePos].m_endOfStatement)
+                {
+                    cerr << "Invalid assignment statement: " << a_statement << endl;
+                    exit(1);
+                }
+                CompileExpression(a_compiled.m_elements, valuePos + 1, a_compiled.m_code);
+                if(a_compiled.m_arrayName.empty())
+                    a_compiled.m_sharedValue = GetSharedValue(a_compiled.m_elements[0].m_string);
+            }
+            break;
+            
+        case StatementType::DimStat:
+            // dim array [ size ]
+            SplitElements(a_statement, a_compiled.m_elements);
+            a_compiled.m_arrayName = a_compiled.m_elements.size() > 1 ? a_compiled.m_elements[1].m_string : "";
+            {
+                vector<Element> indexElements;
+                SplitIndexElements(a_compiled.m_elements, 2, indexElements);
+                CompileExpression(indexElements, 0, a_compiled.m_indexCode);
+            }
+            break;
+            
+        case StatementType::FillStat:
+        case StatementType::CopyStat:
+            // fill array , value    copy destination , source
+            SplitElements(a_statement, a_compiled.m_elements);
+            if(a_compiled.m_elements.size() < 4 || a_compiled.m_elements[2].m_string != ",")
+            {
+                cerr << "Invalid array statement: " << a_statement << endl;
+                exit(1);
+            }
+            a_compiled.m_arrayName = a_compiled.m_elements[1].m_string;
+            a_compiled.m_sourceArrayName = a_compiled.m_elements[3].m_string;
+            if(a_compiled.m_type == StatementType::FillStat)
+                CompileExpression(a_compiled.m_elements, 3, a_compiled.m_code);
+            break;
+            
+        case StatementType::SortStat:
+            // sort array
+            SplitElements(a_statement, a_compiled.m_elements);
+            a_compiled.m_arrayName = a_compiled.m_elements.size() > 1 ? a_compiled.m_elements[1].m_string : "";
+            break;
+            
+        case StatementType::IfStat:
+        {
+            // Searching from the end, find the goto statement and replace it by ";"  Record
+            // the label in the goto.
+            string condition = a_statement;
+            label = EvaluateIfGotoExpression(condition);
+            a_compiled.m_label = label;
+            a_compiled.m_labelLocation = m_statements.GetLabelLocation(label);
+            
+            // Verify that the label from the goto exists.
+            m_statements.GetStatement(a_compiled.m_labelLocation);
+            SplitElements(condition, a_compiled.m_elements, true);
+            
+            // The condition follows the "if".
+            CompileExpression(a_compiled.m_elements, 1, a_compiled.m_code);
+            break;
+        }
+            
+        case StatementType::GotoStat:
+        case StatementType::GosubStat:
+        case StatementType::SpawnStat:
+            // Label is the second syntactic element.
+            SplitElements(a_statement, a_compiled.m_elements);
+            ParseNextElement(a_compiled.m_elements, 1, label, placeHolder);
+            a_compiled.m_label = label;
+            a_compiled.m_labelLocation = m_statements.GetLabelLocation(label);
+            
+            // Verify that the label exists.
+            m_statements.GetStatement(a_compiled.m_labelLocation);
+            break;
+            
+        default:
+            SplitElements(a_statement, a_compiled.m_elements);
+            break;
+    }
+    
+    a_compiled.m_parsed = true;
+}
+
+/**
+ * DuckInterpreter::SplitElements. Method to split a statement into elements.
+ * Splits a_statement into its elements separated by white space, once. Each element is stored in the form that
+ * ParseNextElement returns it, so that parsing a compiled statement does not need to scan the statement again.
+ * Print and read statements split their quoted prompts at spaces, and put them back together as they print them.
+ * Expressions keep each quoted string as one element instead, up to its closing quote, with its spaces.
+ * @param a_statement const string The statement to split.
+ * @param a_elements vector<Element> Receives the elements of the statement.
+ * @param a_literals bool Whether quoted strings are kept whole.
  * @see ParseNextElement
- * @see DoOperation
- * @see GetOperatorPrecedence
- * @see SymbolTable::GetVariableValue
- * @see SymbolTable::RecordVariableValue
+ */
+void DuckInterpreter::SplitElements(const string &a_statement, vector<Element> &a_elements, bool a_literals)
+{
+    istringstream line(a_statement);
+    string str_element;
+    
+    // Gets the next element. A quoted string ends at its closing quote, or at the semi-colon right after it.
+    size_t position = 0;
+    auto nextElement = [&]()
+    {
+        if(!a_literals)
+            return (bool)(line >> str_element);
+        
+        position = a_statement.find_first_not_of(" \t\r\n", position);
+        if(position == string::npos)
+            return false;
+        size_t end;
+        if(a_statement[position] == '"')
+        {
+            end = a_statement.find('"', position + 1);
+            end = end == string::npos ? a_statement.size() : end + 1;
+            if(end < a_statement.size() && a_statement[end] == ';')
+                end++;
+        }
+        else
+            end = min(a_statement.find_first_of(" \t\r\n\"", position), a_statement.size());
+        str_element.assign(a_statement, position, end - position);
+        position = end;
+        return true;
+    };
+    
+    a_elements.clear();
+    while(nextElement())
+    {
+        Element element;
+        element.m_endOfStatement = false;
+        
+        // Checking for end of statement semi-colon and removing it
+        // Quoted strings can have semi-colons of their own, so only the last one can end the statement.
+        size_t semicolon = a_literals && str_element[0] == '"' ? str_element.rfind(";") : str_element.find(";");
+        if(semicolon != string::npos && semicolon==str_element.length()-1 &&str_element.length()>1)
+        {
+            str_element.pop_back();
+            element.m_endOfStatement = true;
+        }
+        
+        // Checking if it is a number.
+        // The number is captured in m_number and m_string is set to "NULL".
+        if(isdigit(str_element[0]))
+        {
+            element.m_number = atoi(str_element.c_str());
+            element.m_string = "NULL";
+        }
+        // Checking if it is a string.
+        // The string is captured in m_string and m_number is set to INT_MAX.
+        else
+        {
+            element.m_string = str_element;
+            element.m_number = INT_MAX;
+        }
+        
+        if(str_element == ";")
+            element.m_endOfStatement = true;
+        
+        a_elements.push_back(element);
+    }
+}
+
+/**
+ * DuckInterpreter::ExecuteStatement. Method to execute a statement.
+ * Executes the compiled statement a_statement by calling the respective functions for its type.
+ * @param a_statement const CompiledStatement The statement to be executed.
+ * @param a_nextStatement int Current statement number.
+ * @return int Next statement number to execute.
+ * @see EvaluateArithmeticStatement
+ * @see EvaluateIfStatement
+ * @see EvaluatePrintStatement
+ * @see EvaluateReadStatement
+ * @see EvaluateGotoStatement
+ * @see EvaluateSpawnStatement
  * @author Salil Maharjan
  * @date 03/13/19
  */
-double DuckInterpreter::EvaluateArithmenticExpression(const string &a_statement, int a_nextPos)
+int DuckInterpreter::ExecuteStatement(const CompiledStatement &a_statement, int a_nextStatement)
 {
-    // Position holder for function ParseNextElement.
-    string stringValue;
-    double numValue;
+    // Clear the stacks
+    m_numberStack.clear();
     
-    // Temp variable to store variable value. Used by GetVariableValue.
-    double temp;
-
-    // Loop till we reach end of the statement.
-    while(a_nextPos!=INT_MAX)
+    // Based on the type, execute the remainder of the statement.
+    switch (a_statement.m_type)
+    {
+        case StatementType::ArithmeticStat:
+            EvaluateArithmeticStatement(a_statement);
+            return a_nextStatement + 1;
+            
+        case StatementType::StringStat:
+            EvaluateStringStatement(a_statement);
+            return a_nextStatement + 1;
+            
+        case StatementType::IfStat:
+            return EvaluateIfStatement(a_statement, a_nextStatement);
+            
+        case StatementType::StopStat:
+            StopRegions(a_nextStatement);
+            ReportStatistics();
+            this->~DuckInterpreter();
+            cout<< "**Exiting by a stop statement**"<<endl;
+            cout<<"**Duck thanks you for using this language. Quack**"<<endl;
+            exit(EXIT_SUCCESS);
+            
+        case StatementType::EndStat:
+            StopRegions(a_nextStatement);
+            ReportStatistics();
+            this->~DuckInterpreter();
+            cout<<"**Exiting by an end stateement**"<<endl;
+            cout<<"**Duck thanks you for using this language. Quack**"<<endl;
+            exit(EXIT_SUCCESS);
+            
+        case StatementType::PrintStat:
+            EvaluatePrintStatement(a_statement);
+            return a_nextStatement + 1;
+            
+        case StatementType::ReadStat:
+            EvaluateReadStatement(a_statement);
+            return a_nextStatement + 1;
+            
+        case StatementType::GotoStat:
+            return EvaluateGotoStatement(a_statement);
+            
+        case StatementType::GosubStat:
+            return EvaluateGosubStatement(a_statement, a_nextStatement);
+            
+        case StatementType::ReturnStat:
+            return EvaluateReturnStatement();
+            
+        case StatementType::SpawnStat:
+            return EvaluateSpawnStatement(a_statement, a_nextStatement);
+            
+        case StatementType::JoinStat:
+            JoinRegions();
+            return a_nextStatement + 1;
+            
+        // Shared statements are declarations, handled when the program is loaded.
+        case StatementType::CommentStat:
+        case StatementType::SharedStat:
+            return a_nextStatement + 1;
+            
+        case StatementType::DimStat:
+        case StatementType::FillStat:
+        case StatementType::CopyStat:
+        case StatementType::SortStat:
+            EvaluateArrayStatement(a_statement);
+            return a_nextStatement + 1;
+            
+        default:
+            cerr << "BUGBUG - program terminate: invalid return value from GetStatementStype for the statement: " << m_statements.GetStatement(a_nextStatement) << endl;
+            exit(1);
+    }
+}
+
+/**
+ * DuckInterpreter::ParseNextElement. Element Parse Method.
+ * Parses the next element of the statement. The elements were split by white space when the statement was compiled.
+ * @param a_elements const vector<Element> The elements of the statement to parse.
+ * @param a_nextPos int The element number of the element to parse from the statement.
+ * @param a_stringValue string Captures the string elements from statement. "NULL" if the element is not a string.
+ * @param numValue double Captures numeric elements from the statement. INT_MAX if the element is not a number.
+ * @return int Position of the next element. INT_MAX at the end of the statement.
+ * @see SplitElements
+ * @author Salil Maharjan
+ * @date 03/13/19
+ */
+int DuckInterpreter::ParseNextElement(const vector<Element> &a_elements, int a_nextPos, string &a_stringValue, double &numValue)
+{
+    // Past the last element, or at the end of the statement already. There is nothing left to parse.
+    if(a_nextPos < 0 || a_nextPos >= (int)a_elements.size())
+    {
+        a_stringValue = "";
+        numValue = INT_MAX;
+        return INT_MAX;
+    }
+    
+    const Element &element = a_elements[a_nextPos];
+    a_stringValue = element.m_string;
+    numValue = element.m_number;
+    
+    // If the end of statement is reached, we return INT_MAX
+    if(element.m_endOfStatement)
+        return INT_MAX;
+    
+    // Returning the next element number
+    a_nextPos++;
+    return a_nextPos;
+}
+
+/**
+ * DuckInterpreter::GetStatementStype. Method that gets the Statement type.
+ * Finds the statement type of a_string and returns it. Whole line comments are found from the start of the statement.
+ * Otherwise, the statement type is determined by the keyword that starts the statement, which is looked up in the
+ * keyword table. Statements that do not start with a keyword are arithmetic statements.
+ * @param a_string const string String to find out the statement type of.
+ * @return DuckInterpreter::StatementType The Statement Type of the passed string.
+ * @see GetKeyword
+ * @author Salil Maharjan
+ * @date 03/13/19
+ */
+DuckInterpreter::StatementType DuckInterpreter::GetStatementStype(const string &a_string)
+{
+    // Checking for whole line comments
+    size_t start = a_string.find_first_not_of(" \t");
+    if(start != string::npos && a_string.compare(start, 2, "//") == 0)
+        return StatementType::CommentStat;
+    
+    // Checking the keyword that starts the statement
+    switch (GetKeyword(a_string))
+    {
+        case Keyword::If:
+            return StatementType::IfStat;
+        case Keyword::Read:
+            return StatementType::ReadStat;
+        case Keyword::Print:
+            return StatementType::PrintStat;
+        case Keyword::Stop:
+            return StatementType::StopStat;
+        case Keyword::End:
+            return StatementType::EndStat;
+        case Keyword::Goto:
+            return StatementType::GotoStat;
+        case Keyword::Dim:
+            return StatementType::DimStat;
+        case Keyword::Fill:
+            return StatementType::FillStat;
+        case Keyword::Copy:
+            return StatementType::CopyStat;
+        case Keyword::Sort:
+            return StatementType::SortStat;
+        case Keyword::Gosub:
+            return StatementType::GosubStat;
+        case Keyword::Return:
+            return StatementType::ReturnStat;
+        case Keyword::Spawn:
+            return StatementType::SpawnStat;
+        case Keyword::Join:
+            return StatementType::JoinStat;
+        case Keyword::Shared:
+            return StatementType::SharedStat;
+        default:
+            break;
+    }
+    
+    // Else it is a arithmetic statement.
+    // If we cannot find a ';', it means that the statement is invalid.
+    // And we cannot determine the statement type.
+    if(a_string.find(";")==string::npos)
+    {
+        cerr<< "Invalid statement type!"<<endl;
+        cerr<<"Statement: "<< a_string<<endl;
+        exit(1);
+    }
+    return StatementType::ArithmeticStat;
+}
+
+
+/**
+ * DuckInterpreter::EvaluateArithmeticStatement. Method to Evaluate Arithmetic Statements.
+ * We know at this point that we have an arithementic expression. Execute this statement.  Any error will perminate the program.
+ * The function first checks for unary arithmetic statements found by CompileStatement, if not the statement is
+ * evaluated by getting the result variable, the assignment operator and then evaluating the rest of the arithmetic
+ * statement by calling EvaluateArithmeticExpression
+ * Shared variables are stored to directly, and additions to them found by OptimizeStatement are atomic.
+ * @param a_statement const CompiledStatement The arithmetic statement.
+ * @see EvaluateArithmeticExpression
+ * @see SymbolTable::GetVariableValue
+ * @see SymbolTable::RecordVariableValue
+ * @author Salil Maharjan
+ * @date 03/13/19
+ */
+void DuckInterpreter::EvaluateArithmeticStatement(const CompiledStatement &a_statement)
+{
+    // Checking for unary operation
+    if(a_statement.m_unaryStep != 0)
+    {
+        if(!a_statement.m_arrayName.empty())
+        {
+            double index = EvaluateArithmenticExpression(a_statement.m_indexCode);
+            GetArrayElement(GetDeclaredArray(a_statement.m_arrayName), index) += a_statement.m_unaryStep;
+            return;
+        }
+        
+        // Variables proven by CheckDefiniteAssignment are updated in place.
+        if(a_statement.m_unaryAddress != NULL)
+        {
+            double &value = *a_statement.m_unaryAddress;
+            value = (a_statement.m_unaryTruncates ? TruncateOperand(value) : value) + a_statement.m_unaryStep;
+            return;
+        }
+        if(a_statement.m_sharedValue != NULL)
+        {
+            AddToSharedValue(*a_statement.m_sharedValue, a_statement.m_unaryStep, a_statement.m_unaryTruncates);
+            return;
+        }
+        
+        // Perform unary addition or subtraction
+        double temp_value;
+        if(m_symbolTable.GetVariableValue(a_statement.m_unaryVariable, temp_value)==false)
+        {
+            cerr << "Invalid variable: " << a_statement.m_unaryVariable;
+            cerr << "Cannot find value" <<endl;
+            exit(1);
+        }
+        
+        // Performing unary operation and recording the value.
+        if(a_statement.m_unaryTruncates)
+            temp_value = TruncateOperand(temp_value);
+        temp_value += a_statement.m_unaryStep;
+        m_symbolTable.RecordVariableValue(a_statement.m_unaryVariable, temp_value);
+        
+        return;
+    }
+    
+    // If we get here, the expression is not unary.
+    
+    // Checking for an assignment to an array element.
+    if(!a_statement.m_arrayName.empty())
+    {
+        double index = EvaluateArithmenticExpression(a_statement.m_indexCode);
+        
+        // Evaluating the rest of the arithmetic statement and recording the result.
+        // The assignment operator was checked by CompileStatement.
+        double result = EvaluateArithmenticExpression(a_statement.m_code);
+        GetArrayElement(GetDeclaredArray(a_statement.m_arrayName), index) = result;
+        return;
+    }
+
+    // Record the variable that we will be assignning a value.
+    const string &resultVariable = a_statement.m_elements[0].m_string;
+    assert(!resultVariable.empty());
+    
+    // Evaluating the rest of the arithmetic statement.
+    // The assignment operator was checked by CompileStatement.
+    double result = EvaluateArithmenticExpression(a_statement.m_code);
+    
+    // Shared variables are assigned without looking them up, and added to atomically.
+    if(a_statement.m_sharedValue != NULL)
+    {
+        if(a_statement.m_accumulate != 0)
+            AddToSharedValue(*a_statement.m_sharedValue, a_statement.m_accumulate * TruncateOperand(result), true);
+        else
+            a_statement.m_sharedValue->store(result);
+        return;
+    }
+    
+    // Record the result.
+    m_symbolTable.RecordVariableValue(resultVariable, result);
+    
+}
+
+/**
+ * DuckInterpreter::SplitIndexElements. Method to split the index of an array.
+ * Copies the elements between the bracket at a_openPos and its matching closing bracket to a_indexElements, so that
+ * the index can be evaluated as an expression of its own. Terminates if the bracket is not closed.
+ * @param a_elements const vector<Element> The elements of the statement.
+ * @param a_openPos int Position of the opening bracket.
+ * @param a_indexElements vector<Element> Receives the elements of the index.
+ * @return int Position of the element after the closing bracket.
+ */
+int DuckInterpreter::SplitIndexElements(const vector<Element> &a_elements, int a_openPos, vector<Element> &a_indexElements)
+{
+    a_indexElements.clear();
+    
+    int depth = 0;
+    for(int i = a_openPos; i < (int)a_elements.size(); i++)
+    {
+        if(a_elements[i].m_string == "[")
+            depth++;
+        else if(a_elements[i].m_string == "]")
+            depth--;
+        
+        if(depth == 0 && i > a_openPos && !a_indexElements.empty())
+        {
+            // The index ends the expression.
+            a_indexElements.back().m_endOfStatement = true;
+            return i + 1;
+        }
+        
+        if(i > a_openPos)
+            a_indexElements.push_back(a_elements[i]);
+    }
+    
+    cerr << "Invalid array index: missing ]" << endl;
+    exit(1);
+}
+
+/**
+ * DuckInterpreter::GetDeclaredArray. Accessor to get an array.
+ * Gets the storage of a_array from the symbol table. Terminates if the array was not declared with dim.
+ * @param a_array const string The name of the array.
+ * @return vector<double> The values of the array.
+ * @see SymbolTable::GetArray
+ */
+vector<double> &DuckInterpreter::GetDeclaredArray(const string &a_array)
+{
+    vector<double> *array = m_symbolTable.GetArray(a_array);
+    if(array == NULL)
+    {
+        cerr << "Invalid array: " << a_array << endl;
+        cerr << "Arrays must be declared with dim" << endl;
+        exit(1);
+    }
+    return *array;
+}
+
+/**
+ * DuckInterpreter::GetArrayElement. Accessor to get an array element.
+ * Gets the element of a_array at a_index. The values are contiguous, so the bounds check is a single comparison.
+ * Terminates if the index is out of bounds.
+ * @param a_array vector<double> The values of the array.
+ * @param a_index double The index of the element.
+ * @return double The element, which can be assigned to.
+ */
+double &DuckInterpreter::GetArrayElement(vector<double> &a_array, double a_index)
+{
+    size_t position = (size_t)a_index;
+    if(!(a_index >= 0) || position >= a_array.size())
+    {
+        cerr << "Array index out of bounds: " << a_index << endl;
+        cerr << "Array size: " << a_array.size() << endl;
+        exit(1);
+    }
+    return a_array[position];
+}
+
+/**
+ * DuckInterpreter::EvaluateArrayStatement. Method to evaluate array statements.
+ * Evaluates the statements that work on whole arrays:
+ * dim a[n] declares an array of n zeros, fill a, value sets all of its elements to value,
+ * copy b, a copies the elements of a into b, which must have the same size, and sort a sorts its elements.
+ * @param a_statement const CompiledStatement Holds the array statement.
+ * @see ArrayKernels.hpp
+ */
+void DuckInterpreter::EvaluateArrayStatement(const CompiledStatement &a_statement)
+{
+    switch (a_statement.m_type)
+    {
+        case StatementType::DimStat:
+        {
+            double size = EvaluateArithmenticExpression(a_statement.m_indexCode);
+            if(!(size >= 0))
+            {
+                cerr << "Invalid array size: " << size << endl;
+                exit(1);
+            }
+            m_symbolTable.DeclareArray(a_statement.m_arrayName, (size_t)size);
+            break;
+        }
+            
+        case StatementType::FillStat:
+        {
+            vector<double> &array = GetDeclaredArray(a_statement.m_arrayName);
+            double value = EvaluateArithmenticExpression(a_statement.m_code);
+            FillArray(array.data(), array.size(), value);
+            break;
+        }
+            
+        case StatementType::CopyStat:
+        {
+            vector<double> &destination = GetDeclaredArray(a_statement.m_arrayName);
+            vector<double> &source = GetDeclaredArray(a_statement.m_sourceArrayName);
+            if(destination.size() != source.size())
+            {
+                cerr << "Cannot copy " << a_statement.m_sourceArrayName << " to " << a_statement.m_arrayName;
+                cerr << ": the arrays have different sizes" << endl;
+                exit(1);
+            }
+            CopyArray(destination.data(), source.data(), source.size());
+            break;
+        }
+            
+        case StatementType::SortStat:
+        {
+            vector<double> &array = GetDeclaredArray(a_statement.m_arrayName);
+            SortArray(array.data(), array.size());
+            break;
+        }
+            
+        default:
+            break;
+    }
+}
+
+/**
+ * DuckInterpreter::GetOperatorPrecedence. Method to get the operator precedence.
+ * Checks a_operator and returns the precedence of the operator. Used by EvaluateArithmeticExpression.
+ * @param a_operator const string String to find out the statement type of.
+ * @return int The precedence of the passed operator 'a_operator'
+ * @author Salil Maharjan
+ * @date 03/13/19
+ */
+int DuckInterpreter::GetOperatorPrecedence(string a_operator)
+{
+    if(a_operator == ";")
+        return 1;
+    if(a_operator == "(" || a_operator == ")" || a_operator == "[" || a_operator == "]")
+        return 2;
+    if(a_operator == "||")
+        return 3;
+    if(a_operator == "&&")
+        return 4;
+    if(a_operator == "==" || a_operator == "!=" || a_operator == ">=" || a_operator == "<="
+       || a_operator == ">" || a_operator == "<")
+        return 5;
+    if (a_operator == "+" || a_operator == "-")
+        return 6;
+    if (a_operator == "*" || a_operator == "/" || a_operator == "%")
+        return 7;
+    if (a_operator == "!")
+        return 8;
+    return 0;
+}
+
+/**
+ * DuckInterpreter::GetOperationCode. Method to get the operation of an operator.
+ * Finds the operation done by the arithmetic or comparison operator a_operator. Used by CompileExpression.
+ * @param a_operator const string The operator.
+ * @param a_op OpCode Receives the operation of the operator.
+ * @return bool True if a_operator is an arithmetic or comparison operator.
+ */
+bool DuckInterpreter::GetOperationCode(const string &a_operator, OpCode &a_op)
+{
+    if(a_operator == "+")
+        a_op = OpCode::Add;
+    else if(a_operator == "-")
+        a_op = OpCode::Subtract;
+    else if(a_operator == "*")
+        a_op = OpCode::Multiply;
+    else if(a_operator == "/")
+        a_op = OpCode::Divide;
+    else if(a_operator == "%")
+        a_op = OpCode::Modulo;
+    else if(a_operator == "<")
+        a_op = OpCode::Less;
+    else if(a_operator == "<=")
+        a_op = OpCode::LessEqual;
+    else if(a_operator == ">")
+        a_op = OpCode::Greater;
+    else if(a_operator == ">=")
+        a_op = OpCode::GreaterEqual;
+    else if(a_operator == "==")
+        a_op = OpCode::Equal;
+    else if(a_operator == "!=")
+        a_op = OpCode::NotEqual;
+    else if(a_operator == "&&")
+        a_op = OpCode::JumpIfFalse;
+    else if(a_operator == "||")
+        a_op = OpCode::JumpIfTrue;
+    else if(a_operator == "!")
+        a_op = OpCode::Not;
+    else
+        return false;
+    return true;
+}
+
+/**
+ * DuckInterpreter::DoOperation. Method to perform arithmetic operations.
+ * Does 'a_operation' on 'a_val1' and 'a_val2', truncated to int. Used by EvaluateArithmeticExpression, and by
+ * EmitOperation to fold operations on constants.
+ * @param a_val1 double Holds the first value to perform operation with.
+ * @param a_val2 double Holds the second value to perform operation with.
+ * @param a_operation OpCode The operation to be performed.
+ * @return double The result of performing operation "a_operation" on "a_val1" and "a_val2".
+ * @author Salil Maharjan
+ * @date 03/13/19
+ */
+double DuckInterpreter::DoOperation(double a_val1, double a_val2, OpCode a_operation)
+{
+    a_val1 = TruncateOperand(a_val1);
+    a_val2 = TruncateOperand(a_val2);
+    switch (a_operation)
+    {
+        case OpCode::Add:
+            return a_val1 + a_val2;
+        case OpCode::Subtract:
+            return a_val1 - a_val2;
+        case OpCode::Multiply:
+            return a_val1 * a_val2;
+        case OpCode::Divide:
+            return a_val1 / a_val2;
+        case OpCode::Modulo:
+            return fmod(a_val1,a_val2);
+        case OpCode::Less:
+            return (a_val1 < a_val2);
+        case OpCode::LessEqual:
+            return (a_val1 <= a_val2);
+        case OpCode::Greater:
+            return (a_val1 > a_val2);
+        case OpCode::GreaterEqual:
+            return (a_val1 >= a_val2);
+        case OpCode::Equal:
+            return (a_val1 == a_val2);
+        case OpCode::NotEqual:
+            return (a_val1 != a_val2);
+        default:
+            cerr<< " Cannot do operation" << (int)a_operation << endl;
+            exit(1);
+    }
+}
+
+/**
+ * DuckInterpreter::EmitOperation. Method to emit an operation of a compiled expression.
+ * Emits the instruction of a_operator, popped from the operator stack of CompileExpression. Operations are folded
+ * while they are emitted: if all the operands of an arithmetic operation or of a call to a pure builtin are constants,
+ * the operands are replaced by the result. Since the code is in postfix order, the operands are constants exactly when
+ * the last instructions are PushNumber.
+ * @param a_operator const PendingOperator The operator to emit.
+ * @param a_code vector<Instruction> The code being compiled.
+ * @see CompileExpression
+ * @see DoOperation
+ */
+void DuckInterpreter::EmitOperation(const PendingOperator &a_operator, vector<Instruction> &a_code)
+{
+    Instruction instruction;
+    
+    // Element of an array.
+    if(a_operator.m_operator == "[")
+    {
+        instruction.m_op = OpCode::LoadArrayElement;
+        instruction.m_name = a_operator.m_arrayName;
+        a_code.push_back(instruction);
+        return;
+    }
+    
+    // Call of a builtin.
+    if(a_operator.m_operator == "(")
+    {
+        const Builtin *builtin = a_operator.m_builtin;
+        int arity = builtin->m_arity;
+        
+        bool constant = builtin->m_pure;
+        for(int i = 1; i <= arity && constant; i++)
+            constant = a_code[a_code.size()-i].m_op == OpCode::PushNumber;
+        
+        if(constant)
+        {
+            vector<double> arguments(arity);
+            for(int i = 0; i < arity; i++)
+                arguments[i] = a_code[a_code.size()-arity+i].m_number;
+            a_code.resize(a_code.size()-arity);
+            
+            instruction.m_op = OpCode::PushNumber;
+            instruction.m_number = builtin->m_function(arguments.data());
+        }
+        else
+        {
+            instruction.m_op = OpCode::CallBuiltin;
+            instruction.m_builtin = builtin;
+        }
+        a_code.push_back(instruction);
+        return;
+    }
+    
+    // Logical not.
+    if(a_operator.m_operator == "!")
+    {
+        if(a_code.back().m_op == OpCode::PushNumber)
+            a_code.back().m_number = !a_code.back().m_number;
+        else
+        {
+            instruction.m_op = OpCode::Not;
+            a_code.push_back(instruction);
+        }
+        return;
+    }
+    
+    // End of the right operand of && and ||. Its jump skips to after it.
+    if(a_operator.m_jumpInstruction != -1)
+    {
+        instruction.m_op = OpCode::ToBoolean;
+        a_code.push_back(instruction);
+        a_code[a_operator.m_jumpInstruction].m_jump = (int)a_code.size();
+        return;
+    }
+    
+    // Arithmetic and comparison operators.
+    GetOperationCode(a_operator.m_operator, instruction.m_op);
+    size_t size = a_code.size();
+    if(a_code[size-1].m_op == OpCode::PushNumber && a_code[size-2].m_op == OpCode::PushNumber)
+    {
+        double result = DoOperation(a_code[size-2].m_number, a_code[size-1].m_number, instruction.m_op);
+        a_code.pop_back();
+        a_code.back().m_number = result;
+        return;
+    }
+    a_code.push_back(instruction);
+}
+
+/**
+ * DuckInterpreter::CompileExpression. Method to compile arithmetic expressions.
+ * Compiles the arithmetic expression that starts at element a_nextPos into instructions in postfix order, so that
+ * evaluating it does not need to parse or look up any operators. The operators are ordered by precedence with an
+ * operator stack. Array elements (a [ i ]), array sums (sum ( a )) and calls to builtins (max ( a , b )) are resolved
+ * here, and operations on constants are folded. A comparison of strings (a$ + "s" == b$) is compiled to a single
+ * instruction, which pushes its result like the numeric comparisons. Terminates on operators that cannot be done,
+ * unbalanced brackets and builtins called with the wrong number of arguments.
+ * @param a_elements const vector<Element> Holds the elements of the statement.
+ * @param a_nextPos int Holds the value of the first position of the expression.
+ * @param a_code vector<Instruction> Receives the instructions of the expression.
+ * @see EmitOperation
+ * @see GetOperatorPrecedence
+ * @see EvaluateArithmenticExpression
+ * @see FindBuiltin
+ * @see CompileStringExpression
+ */
+void DuckInterpreter::CompileExpression(const vector<Element> &a_elements, int a_nextPos, vector<Instruction> &a_code)
+{
+    // Operators waiting for their operands.
+    vector<PendingOperator> operatorStack;
+    // Number of values the code leaves on the number stack, to check that every operator has its operands.
+    int depth = 0;
+    
+    // Position holder for function ParseNextElement.
+    string stringValue;
+    double numValue;
+    
+    a_code.clear();
+    
+    // Pops the operator at the top of the stack and emits it. The unary ! takes one operand, the others take two.
+    // Either way, the last operand must come after the operator.
+    auto emitTop = [&]()
+    {
+        const PendingOperator &top = operatorStack.back();
+        bool unary = top.m_operator == "!";
+        if(depth < (unary ? 1 : 2) || depth <= top.m_depth)
+        {
+            cerr << "Invalid expression: missing operand" << endl;
+            exit(1);
+        }
+        EmitOperation(top, a_code);
+        operatorStack.pop_back();
+        if(!unary)
+            depth--;
+    };
+    
+    // Pops the operators above the opening bracket at the top of the stack, emitting them.
+    auto emitUntilBracket = [&](const char *a_bracket)
+    {
+        while(!operatorStack.empty() && operatorStack.back().m_operator != a_bracket)
+            emitTop();
+        if(operatorStack.empty())
+        {
+            cerr << "Invalid expression: unbalanced " << a_bracket << endl;
+            exit(1);
+        }
+    };
+    
+    // Pushes an opening bracket.
+    auto pushBracket = [&](const char *a_bracket, const string &a_arrayName, const Builtin *a_builtin)
+    {
+        PendingOperator bracket;
+        bracket.m_operator = a_bracket;
+        bracket.m_arrayName = a_arrayName;
+        bracket.m_builtin = a_builtin;
+        bracket.m_depth = depth;
+        operatorStack.push_back(bracket);
+    };
+    
+    // Loop till we reach end of the statement.
+    while(a_nextPos!=INT_MAX)
+    {
+        int position = a_nextPos;
+        a_nextPos = ParseNextElement(a_elements, a_nextPos, stringValue, numValue);
+        if(position >= (int)a_elements.size())
+            break;
+        
+        // Checking for separate semi-colons.
+        if(stringValue == ";")
+            continue;
+        
+        // Checking for a numeric value.
+        if(numValue != INT_MAX)
+        {
+            Instruction instruction;
+            instruction.m_op = OpCode::PushNumber;
+            instruction.m_number = numValue;
+            a_code.push_back(instruction);
+            depth++;
+            continue;
+        }
+        
+        bool followedByOpen = a_nextPos < (int)a_elements.size() && a_elements[position].m_endOfStatement == false;
+        const string &following = followedByOpen ? a_elements[a_nextPos].m_string : "";
+        
+        // Checking for a comparison of strings. Strings can only be concatenated, so their expressions end at the
+        // comparison operator, and at the first operator after the right one.
+        if(stringValue[0] == '"' || IsStringName(stringValue))
+        {
+            shared_ptr<StringComparison> comparison = make_shared<StringComparison>();
+            int operatorPos = CompileStringExpression(a_elements, position, comparison->m_left);
+            OpCode op = OpCode::Add;
+            if(operatorPos >= (int)a_elements.size() || a_elements[operatorPos].m_endOfStatement
+               || !GetOperationCode(a_elements[operatorPos].m_string, op) || op < OpCode::Less || op > OpCode::NotEqual)
+            {
+                cerr << "Invalid expression: strings can only be concatenated and compared" << endl;
+                exit(1);
+            }
+            comparison->m_op = op;
+            a_nextPos = CompileStringExpression(a_elements, operatorPos + 1, comparison->m_right);
+            
+            Instruction instruction;
+            instruction.m_op = OpCode::CompareStrings;
+            instruction.m_comparison = comparison;
+            a_code.push_back(instruction);
+            depth++;
+        }
+        // Checking for the sum of an array: sum ( array )
+        else if(stringValue == "sum" && following == "(" && a_nextPos + 2 < (int)a_elements.size()
+           && a_elements[a_nextPos+2].m_string == ")")
+        {
+            Instruction instruction;
+            instruction.m_op = OpCode::SumArray;
+            instruction.m_name = a_elements[a_nextPos+1].m_string;
+            a_code.push_back(instruction);
+            depth++;
+            a_nextPos = ParseNextElement(a_elements, a_nextPos + 2, stringValue, numValue);
+        }
+        // Checking for an array that is indexed by the next elements.
+        else if(GetCharacterClass(stringValue[0]) == CHAR_IDENTIFIER && following == "[")
+        {
+            pushBracket("[", stringValue, NULL);
+            a_nextPos = ParseNextElement(a_elements, a_nextPos, stringValue, numValue);
+        }
+        // Checking for a call to a builtin.
+        else if(following == "(" && FindBuiltin(stringValue) != NULL)
+        {
+            pushBracket("(", "", FindBuiltin(stringValue));
+            a_nextPos = ParseNextElement(a_elements, a_nextPos, stringValue, numValue);
+        }
+        // Checking for a variable.
+        else if(GetCharacterClass(stringValue[0]) == CHAR_IDENTIFIER)
+        {
+            Instruction instruction;
+            instruction.m_op = OpCode::LoadVariable;
+            instruction.m_name = stringValue;
+            a_code.push_back(instruction);
+            depth++;
+        }
+        // Checking for opening brace.
+        else if(stringValue == "(")
+            pushBracket("(", "", NULL);
+        
+        // Solving the index if closing bracket found.
+        else if(stringValue == "]")
+        {
+            emitUntilBracket("[");
+            if(depth - operatorStack.back().m_depth != 1)
+            {
+                cerr << "Invalid array index: " << operatorStack.back().m_arrayName << endl;
+                exit(1);
+            }
+            EmitOperation(operatorStack.back(), a_code);
+            operatorStack.pop_back();
+        }
+        // Separating the arguments of a builtin.
+        else if(stringValue == ",")
+        {
+            emitUntilBracket("(");
+            if(operatorStack.back().m_builtin == NULL)
+            {
+                cerr << "Invalid expression: , outside of a function call" << endl;
+                exit(1);
+            }
+            operatorStack.back().m_commaCount++;
+        }
+        // Solving brace if closing brace found.
+        else if(stringValue == ")")
+        {
+            emitUntilBracket("(");
+            PendingOperator brace = operatorStack.back();
+            operatorStack.pop_back();
+            
+            // Each argument, and the expression in plain braces, must leave exactly one value.
+            int valueCount = depth - brace.m_depth;
+            int expected = brace.m_builtin != NULL ? brace.m_builtin->m_arity : 1;
+            if(valueCount != expected || brace.m_commaCount != max(expected - 1, 0))
+            {
+                if(brace.m_builtin != NULL)
+                    cerr << "Invalid call: " << brace.m_builtin->m_name << " takes " << brace.m_builtin->m_arity << " arguments" << endl;
+                else
+                    cerr << "Invalid expression: missing operand" << endl;
+                exit(1);
+            }
+            
+            if(brace.m_builtin != NULL)
+            {
+                EmitOperation(brace, a_code);
+                depth += 1 - valueCount;
+            }
+        }
+        // An operator.
+        else
+        {
+            OpCode op;
+            if(GetOperationCode(stringValue, op) == false)
+            {
+                cerr<< " Cannot do operation" << stringValue << endl;
+                exit(1);
+            }
+            
+            // While the top operator has same or greater precedence than the current operator.
+            // We emit the top operator, which is done before the current one.
+            // The unary ! comes before its operand, so nothing before it is its operand.
+            while(op != OpCode::Not && !operatorStack.empty() && GetOperatorPrecedence(operatorStack.back().m_operator)
+                  >= GetOperatorPrecedence(stringValue))
+                emitTop();
+            
+            PendingOperator pending;
+            pending.m_operator = stringValue;
+            pending.m_depth = depth;
+            
+            // The left operand of && and || is complete. Its jump skips the right operand when the left one decides
+            // the result. The target is patched when the operator is emitted.
+            if(op == OpCode::JumpIfFalse || op == OpCode::JumpIfTrue)
+            {
+                if(depth == 0)
+                {
+                    cerr << "Invalid expression: missing operand" << endl;
+                    exit(1);
+                }
+                Instruction jump;
+                jump.m_op = op;
+                pending.m_jumpInstruction = (int)a_code.size();
+                a_code.push_back(jump);
+            }
+            operatorStack.push_back(pending);
+        }
+    }
+    
+    // Emitting the remaining operations in the operator stack.
+    while(!operatorStack.empty())
+    {
+        if(operatorStack.back().m_operator == "(" || operatorStack.back().m_operator == "[")
+        {
+            cerr << "Invalid expression: unbalanced " << operatorStack.back().m_operator << endl;
+            exit(1);
+        }
+        emitTop();
+    }
+    
+    // The expression must leave exactly its result.
+    if(depth != 1)
+    {
+        cerr << "Invalid expression: missing operand" << endl;
+        exit(1);
+    }
+}
+
+/**
+ * DuckInterpreter::EvaluateArithmenticExpression. Method to perform arithmetic operations.
+ * Evaluate a compiled arithmetic expression on the number stack. Used by EvaluateArithmeticStatement.
+ * The right operands of && and || are skipped by jumping over them when the left operand decides the result.
+ * @param a_code const vector<Instruction> Holds the instructions of the expression, compiled by CompileExpression.
+ * @return double The final result of the arithmetic expression in "a_code".
+ * @see CompileExpression
+ * @see DoOperation
+ * @see SymbolTable::GetVariableValue
+ * @author Salil Maharjan
+ * @date 03/13/19
+ */
+double DuckInterpreter::EvaluateArithmenticExpression(const vector<Instruction> &a_code)
+{
+    // Temp variable to store variable value. Used by GetVariableValue.
+    double temp;
+    
+    for(size_t i = 0; i < a_code.size(); i++)
+    {
+        const Instruction &instruction = a_code[i];
+        switch (instruction.m_op)
+        {
+            case OpCode::PushNumber:
+                m_numberStack.push_back(instruction.m_number);
+                break;
+                
+            case OpCode::LoadVariable:
+                // Reads proven by CheckDefiniteAssignment do not look the variable up.
+                if(instruction.m_variable != NULL)
+                {
+                    m_numberStack.push_back(*instruction.m_variable);
+                    break;
+                }
+                if(m_symbolTable.GetVariableValue(instruction.m_name, temp) == false)
+                {
+                    cerr << "Invalid variable: " << instruction.m_name << endl;
+                    cerr << "Cannot find value" << endl;
+                    exit(1);
+                }
+                m_numberStack.push_back(temp);
+                break;
+                
+            case OpCode::LoadArrayElement:
+                m_numberStack.back() = GetArrayElement(GetDeclaredArray(instruction.m_name), m_numberStack.back());
+                break;
+                
+            case OpCode::SumArray:
+            {
+                vector<double> &array = GetDeclaredArray(instruction.m_name);
+                m_numberStack.push_back(SumArray(array.data(), array.size()));
+                break;
+            }
+                
+            case OpCode::CallBuiltin:
+            {
+                // The arguments are the top values of the stack, in order.
+                int arity = instruction.m_builtin->m_arity;
+                double result = instruction.m_builtin->m_function(m_numberStack.data() + m_numberStack.size() - arity);
+                m_numberStack.resize(m_numberStack.size() - arity);
+                m_numberStack.push_back(result);
+                break;
+            }
+                
+            case OpCode::Not:
+                m_numberStack.back() = !m_numberStack.back();
+                break;
+                
+            case OpCode::ToBoolean:
+                m_numberStack.back() = m_numberStack.back() != 0;
+                break;
+                
+            case OpCode::JumpIfFalse:
+                if(m_numberStack.back() == 0)
+                    i = instruction.m_jump - 1;
+                else
+                    m_numberStack.pop_back();
+                break;
+                
+            case OpCode::JumpIfTrue:
+                if(m_numberStack.back() != 0)
+                {
+                    m_numberStack.back() = 1;
+                    i = instruction.m_jump - 1;
+                }
+                else
+                    m_numberStack.pop_back();
+                break;
+                
+            case OpCode::StoreTemporary:
+                *instruction.m_variable = m_numberStack.back();
+                break;
+                
+            case OpCode::CompareStrings:
+            {
+                const StringComparison &comparison = *instruction.m_comparison;
+                int order = EvaluateStringExpression(comparison.m_left).Compare(EvaluateStringExpression(comparison.m_right));
+                m_numberStack.push_back(DoOperation(order, 0, comparison.m_op));
+                break;
+            }
+                
+            default:
+            {
+                double value2 = m_numberStack.back();
+                m_numberStack.pop_back();
+                m_numberStack.back() = DoOperation(m_numberStack.back(), value2, instruction.m_op);
+                break;
+            }
+        }
+    }
+    
+    // The top contains the final result.
+    double result = m_numberStack.back();
+    m_numberStack.pop_back();
+    return result;
+}
+
+/**
+ * DuckInterpreter::CompileStringExpression. Method to compile string expressions.
+ * Compiles the string expression that starts at element a_nextPos: quoted strings and string variables, concatenated
+ * with +. Terminates if anything else is concatenated, since numbers are never turned into strings.
+ * @param a_elements const vector<Element> Holds the elements of the statement, split with the quoted strings whole.
+ * @param a_nextPos int Holds the value of the first position of the expression.
+ * @param a_terms vector<StringTerm> Receives the terms of the expression, in order.
+ * @return int Position of the element after the expression. INT_MAX if the expression ends the statement.
+ * @see SplitElements
+ * @see EvaluateStringExpression
+ */
+int DuckInterpreter::CompileStringExpression(const vector<Element> &a_elements, int a_nextPos, vector<StringTerm> &a_terms)
+{
+    a_terms.clear();
+    while(true)
+    {
+        if(a_nextPos >= (int)a_elements.size())
+        {
+            cerr << "Invalid string expression: missing operand" << endl;
+            exit(1);
+        }
+        
+        const Element &element = a_elements[a_nextPos];
+        const string &term = element.m_string;
+        StringTerm stringTerm;
+        if(term.size() >= 2 && term.front() == '"' && term.back() == '"')
+            stringTerm.m_literal = DuckString(string_view(term).substr(1, term.size() - 2));
+        else if(IsStringName(term))
+            stringTerm.m_name = term;
+        else
+        {
+            cerr << "Invalid string expression: only quoted strings and string variables can be concatenated" << endl;
+            exit(1);
+        }
+        a_terms.push_back(stringTerm);
+        
+        // The expression goes on if the term is followed by a +.
+        if(element.m_endOfStatement)
+            return INT_MAX;
+        if(a_nextPos + 1 >= (int)a_elements.size() || a_elements[a_nextPos+1].m_string != "+")
+            return a_nextPos + 1;
+        if(a_elements[a_nextPos+1].m_endOfStatement)
+        {
+            cerr << "Invalid string expression: missing operand" << endl;
+            exit(1);
+        }
+        a_nextPos += 2;
+    }
+}
+
+/**
+ * DuckInterpreter::EvaluateStringExpression. Method to evaluate string expressions.
+ * Concatenates the terms of a compiled string expression. Long results are ropes that share the strings they are
+ * made of, so appending to a string does not copy it.
+ * @param a_terms const vector<StringTerm> The terms of the expression, compiled by CompileStringExpression.
+ * @return DuckString The value of the expression.
+ * @see DuckString::Concatenate
+ */
+DuckString DuckInterpreter::EvaluateStringExpression(const vector<StringTerm> &a_terms)
+{
+    DuckString result;
+    for(const StringTerm &term : a_terms)
+    {
+        // Reads proven by CheckDefiniteAssignment do not look the variable up.
+        const DuckString *value = &term.m_literal;
+        if(!term.m_name.empty())
+        {
+            value = term.m_variable != NULL ? term.m_variable : m_symbolTable.GetStringValue(term.m_name);
+            if(value == NULL)
+            {
+                cerr << "Invalid variable: " << term.m_name << endl;
+                cerr << "Cannot find value" << endl;
+                exit(1);
+            }
+        }
+        result = DuckString::Concatenate(result, *value);
+    }
+    return result;
+}
+
+/**
+ * DuckInterpreter::EvaluateStringStatement. Method to evaluate string statements.
+ * Assigns the value of the string expression to the string variable. The expression was checked by CompileStatement.
+ * @param a_statement const CompiledStatement The string statement.
+ * @see EvaluateStringExpression
+ * @see SymbolTable::RecordStringValue
+ */
+void DuckInterpreter::EvaluateStringStatement(const CompiledStatement &a_statement)
+{
+    m_symbolTable.RecordStringValue(a_statement.m_elements[0].m_string, EvaluateStringExpression(a_statement.m_stringCode));
+}
+
+/**
+ * DuckInterpreter::EvaluateIfStatement. Method to evaluate If Statements.
+ * Evaluates an if statement to determine if the goto should be executed.
+ * @param a_statement const CompiledStatement Holds the if statement.
+ * @param a_nextStatement int Current statement position. Used to return the next position of the statement.
+ * @return int The next position of the statement that needs to be executed.
+ * @see ParseNextElement
+ * @see CompileStatement
+ * @see EvaluateArithmeticExpression
+ * @author Salil Maharjan
+ * @date 03/13/19
+ */
+int DuckInterpreter::EvaluateIfStatement(const CompiledStatement &a_statement, int a_nextStatement)
+{
+    // Evaluate the condition, compiled from the arithmentic expression after the "if".
+    // The goto was taken out of it by CompileStatement.
+    double result = EvaluateArithmenticExpression(a_statement.m_code);
+    
+    // If the result is zero, don't execute the goto.
+    if (result == 0)
+        return a_nextStatement + 1;
+    
+    // Return the goto label location.
+    return a_statement.m_labelLocation;
+}
+
+/**
+ * DuckInterpreter::EvaluateIfGotoExpression. Method to evaluate goto expressions in an If statement.
+ * Searches till the end of the statement for the label and returns it.
+ * Then replaces the goto statement with ";"
+ * @param a_statement string Holds the if statement.
+ * @return string The label associated with the goto statement.
+ * @author Salil Maharjan
+ * @date 03/13/19
+ */
+string DuckInterpreter::EvaluateIfGotoExpression(string &a_statement)
+{
+    // Holds the next string element
+    string buffer;
+    // Holds the last item - label.
+    string end_item;
+    
+    // Parsing the last element string
+    // Not using ParseNextElement to reduce overheads.
+    istringstream line(a_statement);
+    for(;;)
+    {
+        buffer="";
+        line>>buffer;
+        int test = (int)buffer.size();
+        if( test == 0 )
+            break;
+        end_item = buffer;
+    }
+    
+    // Checking for end of statement semi-colon and removing it
+    if(end_item.find(";") && end_item.find(";")==end_item.length()-1)
+        end_item.pop_back();
+    
+    // Replacing the goto statement with ";"
+    a_statement.replace(a_statement.find(" goto"), a_statement.find(";"), ";");
+    
+    // Returning the label.
+    return end_item;
+    
+}
+
+/**
+ * DuckInterpreter::EvaluateQuotedPrompt. Method to evaluate quoted prompts.
+ * Function that evaluates quoted prompts. Used by EvaluatePrintStatement and EvaluateReadStatement to evaluate prompts
+ * in quotations. Parameters are passed by reference from the calling function.
+ * @param a_elements const vector<Element> Holds the elements of the statement with quoted prompt.
+ * @param quoted bool flag used to track quoted part of the statement.
+ * @param nextPos int Position of the current element in the statement where we need to start evaluating from.
+ * @param resultString string Position holder to get string element from ParseNextElement
+ * @param placeHolder double Position holder to get numeric element from ParseNextElement.
+ * @see ParseNextElement
+ * @see EvaluatePrintStatement
+ * @see EvaluateReadStatement
+ * @see Statement::StandardSpaceFormat
+ * @author Salil Maharjan
+ * @date 03/13/19
+ */
+// Evaluates Quoted Prompts. Used by EvaluatePrintStatement and EvaluateReadStatement.
+void DuckInterpreter::EvaluateQuotedPrompt(const vector<Element> &a_elements, bool &quoted, int &nextPos, string &resultString, double &placeHolder)
+{
+    // Checking for a quotation that is a single element, which holds the closing quotation too.
+    size_t opening = resultString.find("\"");
+    size_t closing = resultString.find("\"", opening + 1);
+    if(quoted == false && closing != string::npos)
+    {
+        cout << resultString.substr(opening + 1, closing - opening - 1);
+        return;
+    }
+    
+    // Checking for the starting quotations:
+    if(quoted == false && (resultString.find("\"") != resultString.length()-1))
+        cout << resultString.substr(resultString.find("\"")+1,string::npos)<<" ";
+    // Case where we have separate multiple quotations.
+    else
+        // Since we are parsing by whitespaces, it is removed. Printing out the removed delimiter.
+        cout<<" ";
+    
+    // Updating quote flag for the calling function.
+    quoted = true;
+    
+    // Printing the entire quotation until the end quotation is reached, or the end of the statement if it is not
+    // closed.
+    while(quoted == true && nextPos != INT_MAX)
+    {
+        nextPos = ParseNextElement(a_elements, nextPos, resultString, placeHolder);
+        
+        // If we find the ending quotations
+        if(resultString.find("\"") != string::npos)
+        {
+            quoted = false;
+            // Checking if there are elements before ending quotation
+            if(resultString.find("\"") != 0 )
+                cout<<resultString.substr(0,resultString.find("\""));
+            break;
+        }
+        else
+            // Printing whitespace as we parse elements by whitespace and is removed.
+            cout << resultString << " ";
+    }
+    
+    // Asserting that nothing is attached to commas in the statement.
+    // Spaces would have been added by function Statement::StandardSpaceFormat
+    if(resultString.find(",") != string::npos && quoted == false)
+        assert(resultString.find(",")==0 || resultString.find(",")==resultString.length()-1);
+    
+}
+
+/**
+ * DuckInterpreter::EvaluatePrintStatement. Method to evaluate Print statements.
+ * Evaluates print statements. Asserts for "print" keyword, prints the quoted prompts and variables that are comma separated
+ * in the code. String variables are printed one piece of their rope at a time. Numbers are formatted by FormatNumber
+ * and written straight into the buffer of the output. When regions are spawned, the output lock is held while the
+ * line is printed, so that the lines of the threads do not mix.
+ * @param a_statement const CompiledStatement Holds the print statement.
+ * @see ParseNextElement
+ * @see EvaluateQuotedPrompt
+ * @see SymbolTable::GetVariableValue
+ * @see FormatNumber
+ * @author Salil Maharjan
+ * @date 03/13/19
+ */
+void DuckInterpreter::EvaluatePrintStatement(const CompiledStatement &a_statement)
+{
+    unique_lock<mutex> outputLock;
+    if(m_parallel != NULL)
+        outputLock = unique_lock<mutex>(m_parallel->m_outputLock);
+    
+    // Flag used to check for quotations.
+    bool quoted = false;
+    
+    // Get past of the "print" in the print statement.
+    int nextPos = 0;
+    string resultString;
+    double placeHolder;
+    nextPos = ParseNextElement(a_statement.m_elements, nextPos, resultString, placeHolder);
+    assert(resultString == "print");
+    
+    // Evaluating the print expression.
+    while(nextPos!=INT_MAX)
+    {
+        nextPos = ParseNextElement(a_statement.m_elements, nextPos, resultString, placeHolder);
+        
+        // Checking for separate commas.
+        if(resultString.find(",") != string::npos && resultString.length()==1)
+            continue;
+        
+        // Checking for quotations and calling EvaluateQuotedPrompt to print quotations.
+        if(resultString.find("\"") != string::npos)
+        {
+            EvaluateQuotedPrompt(a_statement.m_elements, quoted, nextPos, resultString, placeHolder);
+            continue;
+        }
+        
+        // Checking for variables and printing them out.
+        if(IsStringName(resultString))
+        {
+            const DuckString *value = m_symbolTable.GetStringValue(resultString);
+            if(value != NULL)
+                value->Write(cout);
+        }
+        else if(m_symbolTable.GetVariableValue(resultString, placeHolder) == true)
+        {
+            char text[NUMBER_TEXT_CAPACITY];
+            cout.rdbuf()->sputn(text, FormatNumber(text, placeHolder, m_numberFormat) - text);
+        }
+    }
+    
+    // End of Print Statement
+    cout<<endl;
+}
+
+/**
+ * DuckInterpreter::EvaluateReadStatement. Method to evaluate Read statements.
+ * Evaluates read statements. Asserts for "read" keyword, prints the quoted prompts and gets input from the user
+ * for the specified variables. String variables read a word, up to the next white space. Holds the output lock like
+ * print statements, so that the prompts and the input of a thread go together.
+ * @param a_statement const CompiledStatement Holds the read statement.
+ * @see ParseNextElement
+ * @see EvaluateQuotedPrompt
+ * @see SymbolTable::GetVariableValue
+ * @see SymbolTable::RecordVariableValue
+ * @author Salil Maharjan
+ * @date 03/13/19
+ */
+void DuckInterpreter::EvaluateReadStatement(const CompiledStatement &a_statement)
+{
+    unique_lock<mutex> outputLock;
+    if(m_parallel != NULL)
+        outputLock = unique_lock<mutex>(m_parallel->m_outputLock);
+    
+    // Flag used to check for quotations.
+    bool quoted = false;
+    
+    // Get past of the "read" in the read statement.
+    int nextPos = 0;
+    string resultString;
+    double placeHolder;
+    nextPos = ParseNextElement(a_statement.m_elements, nextPos, resultString, placeHolder);
+    assert(resultString == "read");
+    
+    // Evaluating the entire read statement.
+    while(nextPos!=INT_MAX)
+    {
+        nextPos = ParseNextElement(a_statement.m_elements, nextPos, resultString, placeHolder);
+        
+        // Checking for separate commas.
+        if(resultString.find(",") != string::npos && resultString.length()==1)
+            continue;
+        
+        // Checking for prompt.
+        if(resultString.find("\"") != string::npos)
+        {
+            EvaluateQuotedPrompt(a_statement.m_elements, quoted, nextPos, resultString, placeHolder);
+            continue;
+        }
+        // Else it is a variable
+        else
+        {
+            // Checking and removing trailing commas if any.
+            if(resultString.find(",") != string::npos && resultString.find(",")==resultString.length()-1 && resultString.length()>1) resultString.pop_back();
+            
+            // Get input and store it in the variable map. The prompt has to be shown before waiting for input.
+            if(m_asyncOutput != NULL)
+                m_asyncOutput->Drain();
+            if(IsStringName(resultString))
+            {
+                string word;
+                int c = getchar();
+                while(c != EOF && isspace(c))
+                    c = getchar();
+                for(; c != EOF && !isspace(c); c = getchar())
+                    word += (char)c;
+                if(c != EOF)
+                    ungetc(c, stdin);
+                if(word.empty() && m_outputRecorder != NULL)
+                    m_outputRecorder->Discard();
+                m_symbolTable.RecordStringValue(resultString, DuckString(word));
+                continue;
+            }
+            double temp;
+            if(scanf("%lf", &temp) != 1 && m_outputRecorder != NULL)
+                m_outputRecorder->Discard();
+            m_symbolTable.RecordVariableValue(resultString, temp);
+        }
+    }
+    
+    //End of Read Statement
+    cout<<endl;
+}
+
+/**
+ * DuckInterpreter::EvaluateGotoStatement. Method to evaluate Goto statements.
+ * Evaluates goto statements. At this point, we know that it is a goto statement. The label was verified and
+ * resolved to its location by CompileStatement.
+ * @param a_statement const CompiledStatement Holds the goto statement.
+ * @return int Position of the label specified in the goto statement.
+ * @see CompileStatement
+ * @author Salil Maharjan
+ * @date 03/13/19
+ */
+int DuckInterpreter::EvaluateGotoStatement(const CompiledStatement &a_statement)
+{
+    return a_statement.m_labelLocation;
+}
+
+/**
+ * DuckInterpreter::EvaluateGosubStatement. Method to evaluate gosub statements.
+ * Pushes the statement after the gosub on the return stack and jumps to the label, which was resolved when the
+ * program was loaded. Terminates if the gosub statements are nested deeper than RETURN_STACK_DEPTH.
+ * @param a_statement const CompiledStatement Holds the gosub statement.
+ * @param a_nextStatement int Current statement number.
+ * @return int Position of the label specified in the gosub statement.
+ * @see EvaluateReturnStatement
+ * @see ResolveSubroutineCalls
+ */
+int DuckInterpreter::EvaluateGosubStatement(const CompiledStatement &a_statement, int a_nextStatement)
+{
+    if(m_returnStack.size() == RETURN_STACK_DEPTH)
+    {
+        cerr << "Too many nested gosub statements: " << m_statements.GetStatement(a_nextStatement) << endl;
+        exit(1);
+    }
+    m_returnStack.push_back(a_nextStatement + 1);
+    return a_statement.m_labelLocation;
+}
+
+/**
+ * DuckInterpreter::EvaluateReturnStatement. Method to evaluate return statements.
+ * Pops the statement to go back to from the return stack. Terminates if there is no gosub to return from.
+ * @return int Position of the statement after the last gosub.
+ * @see EvaluateGosubStatement
+ */
+int DuckInterpreter::EvaluateReturnStatement()
+{
+    if(m_returnStack.empty())
+    {
+        cerr << "Return statement without a gosub" << endl;
+        exit(1);
+    }
+    int returnStatement = m_returnStack.back();
+    m_returnStack.pop_back();
+    return returnStatement;
+}
+
+/**
+ * DuckInterpreter::ResolveSubroutineCalls. Method to resolve the labels of gosub statements.
+ * Compiles every gosub statement of the program as soon as it is loaded, which resolves its label through the label
+ * map of Statement. A gosub to a missing label is reported before the program runs. So is a spawn.
+ * @see CompileStatement
+ * @see Statement::GetLabelLocation
+ */
+void DuckInterpreter::ResolveSubroutineCalls()
+{
+    for(int i = 0; i < m_statements.GetStatementCount(); i++)
+    {
+        Keyword keyword = GetKeyword(m_statements.GetRecordedStatement(i));
+        if(keyword == Keyword::Gosub || keyword == Keyword::Spawn)
+            GetCompiledStatement(i);
+    }
+}
+
+/**
+ * DuckInterpreter::DeclareSharedVariables. Method to declare the shared variables.
+ * Shared statements are declarations. The variables that they list are shared between all the threads of the
+ * program, from the time it is loaded, and start at 0. The interpreter of the program creates the state shared with
+ * the regions if the program has spawn or shared statements, and keeps a copy of the program there, that the
+ * interpreters of the regions are compiled from. When the program is reloaded, the interpreters of the regions are
+ * compiled again. Interpreters of regions find the values of the shared variables in the state.
+ * @see SymbolTable::ShareVariable
+ */
+void DuckInterpreter::DeclareSharedVariables()
+{
+    vector<int> declarations;
+    bool spawns = false;
+    for(int i = 0; i < m_statements.GetStatementCount(); i++)
+    {
+        Keyword keyword = GetKeyword(m_statements.GetRecordedStatement(i));
+        if(keyword == Keyword::Shared)
+            declarations.push_back(i);
+        spawns |= keyword == Keyword::Spawn;
+    }
+    
+    if(!m_regionInterpreter)
+    {
+        if(m_parallel == NULL)
+        {
+            if(declarations.empty() && !spawns)
+                return;
+            m_ownParallelState.reset(new ParallelState());
+            m_parallel = m_ownParallelState.get();
+        }
+        m_parallel->m_program = m_statements;
+        lock_guard<mutex> lock(m_parallel->m_idleLock);
+        m_parallel->m_idleInterpreters.clear();
+    }
+    
+    // shared variable , variable ...
+    for(int statement : declarations)
+    {
+        const CompiledStatement &compiled = GetCompiledStatement(statement);
+        for(size_t i = 1; i < compiled.m_elements.size(); i++)
+        {
+            string name = compiled.m_elements[i].m_string;
+            if(name == "," || name == ";")
+                continue;
+            if(!name.empty() && name.back() == ',')
+                name.pop_back();
+            if(name.empty() || name == "NULL" || IsStringName(name))
+            {
+                cerr << "Only numeric variables can be shared: " << m_statements.GetStatement(statement) << endl;
+                exit(1);
+            }
+            
+            // Only the interpreter of the program adds shared variables. The regions run the same program.
+            unordered_map<string, atomic<double> *>::iterator shared = m_parallel->m_sharedVariables.find(name);
+            if(shared == m_parallel->m_sharedVariables.end())
+            {
+                m_parallel->m_sharedValues.emplace_back(0.0);
+                shared = m_parallel->m_sharedVariables.insert(make_pair(name, &m_parallel->m_sharedValues.back())).first;
+            }
+            m_symbolTable.ShareVariable(name, shared->second);
+        }
+    }
+}
+
+/**
+ * DuckInterpreter::GetSharedValue. Accessor to get the value of a shared variable.
+ * @param a_variable const string Name of the variable.
+ * @return atomic<double>* The value that the threads share. NULL if the variable is not shared.
+ * @see DeclareSharedVariables
+ */
+atomic<double> *DuckInterpreter::GetSharedValue(const string &a_variable)
+{
+    if(m_parallel == NULL)
+        return NULL;
+    unordered_map<string, atomic<double> *>::const_iterator shared = m_parallel->m_sharedVariables.find(a_variable);
+    return shared == m_parallel->m_sharedVariables.end() ? NULL : shared->second;
+}
+
+/**
+ * DuckInterpreter::EvaluateSpawnStatement. Method to evaluate spawn statements.
+ * Saves the variables, other than the shared ones, and queues a task that runs the region at the label of the spawn
+ * with a copy of them, on an interpreter of its own. The region runs until it returns from the label, and its
+ * variables and arrays are private: other threads only see what it stores in shared variables. The pool of threads
+ * is started by the first spawn, with a thread per core.
+ * @param a_statement const CompiledStatement Holds the spawn statement.
+ * @param a_nextStatement int Current statement number.
+ * @return int Position of the statement after the spawn.
+ * @see RunRegion
+ * @see JoinRegions
+ * @see TaskPool::Spawn
+ */
+int DuckInterpreter::EvaluateSpawnStatement(const CompiledStatement &a_statement, int a_nextStatement)
+{
+    ParallelState *state = m_parallel;
+    if(!state->m_pool)
+        state->m_pool.reset(new TaskPool((int)thread::hardware_concurrency()));
+    
+    string variables;
+    m_symbolTable.SaveVariables(variables, false);
+    int label = a_statement.m_labelLocation;
+    NumberFormat numberFormat = m_numberFormat;
+    state->m_pool->Spawn(m_spawnedRegions, [state, label, numberFormat, variables = move(variables)]()
+    {
+        unique_ptr<DuckInterpreter> interpreter = AcquireRegionInterpreter(state);
+        interpreter->m_numberFormat = numberFormat;
+        interpreter->RunRegion(label, variables);
+        ReleaseRegionInterpreter(state, move(interpreter));
+    });
+    return a_nextStatement + 1;
+}
+
+/**
+ * DuckInterpreter::JoinRegions. Method to wait for the spawned regions.
+ * Waits until the regions spawned by this interpreter have returned. Regions join the regions they spawned before
+ * they return, so all the regions spawned from here have returned too.
+ * @see TaskPool::Wait
+ */
+void DuckInterpreter::JoinRegions()
+{
+    if(m_parallel != NULL && m_parallel->m_pool)
+        m_parallel->m_pool->Wait(m_spawnedRegions);
+}
+
+/**
+ * DuckInterpreter::StopRegions. Method to finish the regions when the program stops.
+ * The program waits for the regions it spawned before it stops, as if it joined them. Regions end by returning, and
+ * terminate with an error if they try to stop the program, which would leave the other threads running.
+ * @param a_nextStatement int The stop or end statement.
+ */
+void DuckInterpreter::StopRegions(int a_nextStatement)
+{
+    if(m_regionInterpreter)
+    {
+        cerr << "A spawned region must return instead of stopping the program: " << m_statements.GetStatement(a_nextStatement) << endl;
+        exit(1);
+    }
+    JoinRegions();
+}
+
+/**
+ * DuckInterpreter::RunRegion. Method to run a spawned region.
+ * Forgets the private variables and arrays of the previous region that ran on this interpreter, restores the
+ * variables saved by the spawn statement, computes the temporaries from them, and runs statements from the label of
+ * the region until it returns to REGION_END. The regions that it spawned are joined before it ends.
+ * @param a_label int Statement number of the label of the region.
+ * @param a_variables const string The variables of the spawn statement, saved by SymbolTable::SaveVariables.
+ * @see EvaluateSpawnStatement
+ * @see RunStatements
+ */
+void DuckInterpreter::RunRegion(int a_label, const string &a_variables)
+{
+    const char *data = a_variables.data();
+    m_symbolTable.ClearVariables();
+    m_symbolTable.RestoreVariables(data, data + a_variables.size());
+    ComputeTemporaries();
+    
+    // A trace being recorded when the previous region returned would go on in this one.
+    m_recordingAnchor = -1;
+    m_recordBuffer.clear();
+    
+    m_returnStack.clear();
+    m_returnStack.push_back(REGION_END);
+    RunStatements(a_label);
+    JoinRegions();
+}
+
+/**
+ * DuckInterpreter::AcquireRegionInterpreter. Method to get an interpreter for a region.
+ * Takes an idle interpreter if there is one. Otherwise compiles the program in a new one, which shares the shared
+ * variables of a_state. There are as many interpreters as regions running at the same time, which is the number of
+ * threads unless regions wait for the regions they spawn.
+ * @param a_state ParallelState The state shared by the interpreters.
+ * @return unique_ptr<DuckInterpreter> The interpreter.
+ * @see ReleaseRegionInterpreter
+ */
+unique_ptr<DuckInterpreter> DuckInterpreter::AcquireRegionInterpreter(ParallelState *a_state)
+{
+    {
+        lock_guard<mutex> lock(a_state->m_idleLock);
+        if(!a_state->m_idleInterpreters.empty())
+        {
+            unique_ptr<DuckInterpreter> interpreter = move(a_state->m_idleInterpreters.back());
+            a_state->m_idleInterpreters.pop_back();
+            return interpreter;
+        }
+    }
+    
+    unique_ptr<DuckInterpreter> interpreter(new DuckInterpreter());
+    interpreter->m_parallel = a_state;
+    interpreter->m_regionInterpreter = true;
+    interpreter->m_statements = a_state->m_program;
+    interpreter->LoadProgram();
+    return interpreter;
+}
+
+/**
+ * DuckInterpreter::ReleaseRegionInterpreter. Method to give back the interpreter of a region.
+ * Keeps the interpreter to run another region, with the program compiled and the traces it recorded.
+ * @param a_state ParallelState The state shared by the interpreters.
+ * @param a_interpreter unique_ptr<DuckInterpreter> The interpreter, which has finished its region.
+ * @see AcquireRegionInterpreter
+ */
+void DuckInterpreter::ReleaseRegionInterpreter(ParallelState *a_state, unique_ptr<DuckInterpreter> a_interpreter)
+{
+    lock_guard<mutex> lock(a_state->m_idleLock);
+    a_state->m_idleInterpreters.push_back(move(a_interpreter));
+}
+
+/**
+ * DuckInterpreter::GetVariableAccesses. Method to get the variables that a statement reads and assigns.
+ * Gets the variables read by the expressions of the statement and by unary statements, with the place their address
+ * goes once the read is proven, and then the variables assigned by arithmetic and read statements. The variables of
+ * a read statement are its elements outside of the quoted prompts and the commas. Print statements skip variables
+ * that were never assigned, so their variables are not reads. String variables are read by string assignments and
+ * by comparisons of strings.
+ * @param a_statement CompiledStatement The compiled statement.
+ * @param a_reads vector<VariableRead> Receives the reads of variables, in the order they are evaluated.
+ * @param a_writes vector<string> Receives the variables assigned.
+ * @see CheckDefiniteAssignment
+ */
+void DuckInterpreter::GetVariableAccesses(CompiledStatement &a_statement, vector<VariableRead> &a_reads,
+                                          vector<string> &a_writes)
+{
+    a_reads.clear();
+    a_writes.clear();
+    
+    if(a_statement.m_type == StatementType::ArithmeticStat && a_statement.m_unaryStep != 0
+       && a_statement.m_arrayName.empty())
+    {
+        a_reads.push_back({&a_statement.m_unaryVariable, &a_statement.m_unaryAddress});
+        a_writes.push_back(a_statement.m_unaryVariable);
+        return;
+    }
+    
+    auto addStringReads = [&a_reads](vector<StringTerm> &a_terms)
+    {
+        for(StringTerm &term : a_terms)
+        {
+            if(!term.m_name.empty())
+                a_reads.push_back({&term.m_name, NULL, &term.m_variable});
+        }
+    };
+    
+    for(vector<Instruction> *code : {&a_statement.m_indexCode, &a_statement.m_code})
+    {
+        for(Instruction &instruction : *code)
+        {
+            if(instruction.m_op == OpCode::LoadVariable)
+                a_reads.push_back({&instruction.m_name, &instruction.m_variable});
+            else if(instruction.m_op == OpCode::CompareStrings)
+            {
+                addStringReads(instruction.m_comparison->m_left);
+                addStringReads(instruction.m_comparison->m_right);
+            }
+        }
+    }
+    addStringReads(a_statement.m_stringCode);
+    
+    if((a_statement.m_type == StatementType::ArithmeticStat && a_statement.m_arrayName.empty())
+       || a_statement.m_type == StatementType::StringStat)
+        a_writes.push_back(a_statement.m_elements[0].m_string);
+    
+    if(a_statement.m_type == StatementType::ReadStat)
+    {
+        bool quoted = false;
+        for(size_t i = 1; i < a_statement.m_elements.size(); i++)
+        {
+            string element = a_statement.m_elements[i].m_string;
+            if(element.find('"') != string::npos)
+            {
+                if(count(element.begin(), element.end(), '"') % 2 == 1)
+                    quoted = !quoted;
+                continue;
+            }
+            if(quoted || element == "," || element == ";" || element == "NULL" || element.empty())
+                continue;
+            if(element.back() == ',')
+                element.pop_back();
+            a_writes.push_back(element);
+        }
+    }
+}
+
+/**
+ * DuckInterpreter::BuildFlowGraph. Method to build the control flow graph of the program.
+ * Compiles the statements that can be reached from the entries of a_graph, and finds their successors: gotos and ifs
+ * go to their labels, gosubs go to their labels, and returns go back to the statement after every gosub, and to the
+ * return statements of the gosubs in progress. Spawns go both to their labels, where their region starts with the
+ * variables of the spawn, and to the next statement. The statements are then split into basic blocks. A basic block
+ * starts at every entry, and at every statement that is not only reached by falling through from the statement before
+ * it. Statements that cannot be reached are left to be compiled when they are reached, as before.
+ * @param a_graph FlowGraph Holds the entries, and receives the control flow graph.
+ */
+void DuckInterpreter::BuildFlowGraph(FlowGraph &a_graph)
+{
+    int count = m_statements.GetStatementCount();
+    vector< vector<int> > &successors = a_graph.m_successors;
+    vector< vector<int> > &predecessors = a_graph.m_predecessors;
+    vector<bool> &reachable = a_graph.m_reachable;
+    successors.assign(count, vector<int>());
+    predecessors.assign(count, vector<int>());
+    reachable.assign(count, false);
+    
+    // Finding the statements that can be reached, and their successors. Return statements are linked to the
+    // statements after the gosubs once all of them are found.
+    vector<int> pending = a_graph.m_entries;
+    vector<int> returnStatements;
+    vector<int> returnSites;
+    for(int returnStatement : m_returnStack)
+    {
+        if(returnStatement >= 0 && returnStatement < count)
+            returnSites.push_back(returnStatement);
+    }
+    while(!pending.empty())
+    {
+        while(!pending.empty())
+        {
+            int statement = pending.back();
+            pending.pop_back();
+            if(statement < 0 || statement >= count || reachable[statement])
+                continue;
+            reachable[statement] = true;
+            
+            const CompiledStatement &compiled = GetCompiledStatement(statement);
+            vector<int> &next = successors[statement];
+            switch (compiled.m_type)
+            {
+                case StatementType::StopStat:
+                case StatementType::EndStat:
+                    break;
+                case StatementType::GotoStat:
+                    next.push_back(compiled.m_labelLocation);
+                    break;
+                case StatementType::IfStat:
+                    next.push_back(compiled.m_labelLocation);
+                    next.push_back(statement + 1);
+                    break;
+                case StatementType::GosubStat:
+                    next.push_back(compiled.m_labelLocation);
+                    returnSites.push_back(statement + 1);
+                    break;
+                case StatementType::SpawnStat:
+                    next.push_back(compiled.m_labelLocation);
+                    next.push_back(statement + 1);
+                    break;
+                case StatementType::ReturnStat:
+                    returnStatements.push_back(statement);
+                    break;
+                default:
+                    next.push_back(statement + 1);
+                    break;
+            }
+            
+            // Running past the last statement is reported when it happens.
+            next.erase(remove_if(next.begin(), next.end(), [count](int a_next) { return a_next < 0 || a_next >= count; }),
+                       next.end());
+            pending.insert(pending.end(), next.begin(), next.end());
+        }
+        
+        if(!returnStatements.empty())
+        {
+            for(int site : returnSites)
+            {
+                if(site < count && !reachable[site])
+                    pending.push_back(site);
+            }
+        }
+    }
+    for(int statement : returnStatements)
+    {
+        for(int site : returnSites)
+        {
+            if(site < count)
+                successors[statement].push_back(site);
+        }
+    }
+    
+    // Finding the predecessors and the basic blocks.
+    for(int statement = 0; statement < count; statement++)
+    {
+        for(int next : successors[statement])
+            predecessors[next].push_back(statement);
+    }
+    a_graph.m_blockOf.assign(count, -1);
+    a_graph.m_blockStarts.clear();
+    for(int statement = 0; statement < count; statement++)
+    {
+        if(!reachable[statement])
+            continue;
+        bool entry = find(a_graph.m_entries.begin(), a_graph.m_entries.end(), statement) != a_graph.m_entries.end();
+        bool fallsThrough = !entry && statement > 0 && predecessors[statement].size() == 1
+                            && predecessors[statement][0] == statement - 1 && successors[statement - 1].size() == 1;
+        if(!fallsThrough)
+            a_graph.m_blockStarts.push_back(statement);
+        a_graph.m_blockOf[statement] = (int)a_graph.m_blockStarts.size() - 1;
+    }
+}
+
+/**
+ * DuckInterpreter::CheckDefiniteAssignment. Method to prove that variables are assigned before they are read.
+ * A forward dataflow analysis over the basic blocks of a_graph finds the variables that are assigned on every path
+ * to each block: a block starts with the variables assigned at the end of all its predecessors, and ends with those
+ * and the variables it assigns. Entries also start with the variables of the symbol table that are assigned, which
+ * are none when the program is loaded, and the ones assigned so far when it is reloaded. Reads of variables that
+ * are not assigned on every path are reported, and the program is not run. The proven reads keep the address of their
+ * variable, so that they are evaluated without looking the variable up. Shared variables are always assigned, and are
+ * always looked up, since their value is not in the table.
+ * @param a_graph const FlowGraph The control flow graph of the program.
+ * @see BuildFlowGraph
+ * @see GetVariableAccesses
+ */
+void DuckInterpreter::CheckDefiniteAssignment(const FlowGraph &a_graph)
+{
+    int count = m_statements.GetStatementCount();
+    const vector< vector<int> > &predecessors = a_graph.m_predecessors;
+    const vector<bool> &reachable = a_graph.m_reachable;
+    const vector<int> &blockOf = a_graph.m_blockOf;
+    const vector<int> &blockStarts = a_graph.m_blockStarts;
+    int blockCount = (int)blockStarts.size();
+    
+    // Numbering the variables, and finding the variables assigned by each block.
+    unordered_map<string, int> variableNumbers;
+    auto getVariableNumber = [&variableNumbers](const string &a_variable)
+    {
+        return variableNumbers.insert(make_pair(a_variable, (int)variableNumbers.size())).first->second;
+    };
+    vector<VariableRead> reads;
+    vector<string> writes;
+    vector< vector<int> > blockWrites(blockCount);
+    for(int statement = 0; statement < count; statement++)
+    {
+        if(!reachable[statement])
+            continue;
+        GetVariableAccesses(m_compiled[statement], reads, writes);
+        for(const VariableRead &read : reads)
+            getVariableNumber(*read.m_name);
+        for(const string &write : writes)
+            blockWrites[blockOf[statement]].push_back(getVariableNumber(write));
+    }
+    
+    // Finding the variables assigned on every path to each block, as bit sets. Blocks start with all the variables,
+    // so that the predecessors that are not visited yet do not remove any, and are visited until nothing changes.
+    size_t words = (variableNumbers.size() + 63) / 64;
+    vector<uint64_t> assignedIn(blockCount * words, ~0ULL);
+    vector<uint64_t> assignedOut(blockCount * words, ~0ULL);
+    vector<uint64_t> assigned(words);
+    
+    // The variables assigned at the entries. Variables are never unassigned, so they stay assigned whenever an entry
+    // is reached.
+    vector<uint64_t> assignedAtEntry(words, 0);
+    for(const pair<const string, int> &variable : variableNumbers)
+    {
+        if(m_symbolTable.IsAssigned(variable.first))
+            assignedAtEntry[variable.second / 64] |= 1ULL << (variable.second % 64);
+    }
+    vector<bool> entryBlock(blockCount, false);
+    for(int entry : a_graph.m_entries)
+    {
+        if(entry >= 0 && entry < count && reachable[entry])
+            entryBlock[blockOf[entry]] = true;
+    }
+    
+    bool changed = true;
+    while(changed)
+    {
+        changed = false;
+        for(int block = 0; block < blockCount; block++)
+        {
+            int first = blockStarts[block];
+            if(entryBlock[block])
+                assigned = assignedAtEntry;
+            else
+                fill(assigned.begin(), assigned.end(), ~0ULL);
+            for(int previous : predecessors[first])
+            {
+                for(size_t w = 0; w < words; w++)
+                    assigned[w] &= assignedOut[blockOf[previous] * words + w];
+            }
+            copy(assigned.begin(), assigned.end(), assignedIn.begin() + block * words);
+            
+            for(int variable : blockWrites[block])
+                assigned[variable / 64] |= 1ULL << (variable % 64);
+            if(!equal(assigned.begin(), assigned.end(), assignedOut.begin() + block * words))
+            {
+                copy(assigned.begin(), assigned.end(), assignedOut.begin() + block * words);
+                changed = true;
+            }
+        }
+    }
+    
+    // Checking the reads of each statement against the variables assigned before it, and binding the proven ones.
+    bool failed = false;
+    for(int statement = 0; statement < count; statement++)
+    {
+        if(!reachable[statement])
+            continue;
+        int block = blockOf[statement];
+        if(blockStarts[block] == statement)
+            copy(assignedIn.begin() + block * words, assignedIn.begin() + (block + 1) * words, assigned.begin());
+        
+        GetVariableAccesses(m_compiled[statement], reads, writes);
+        for(const VariableRead &read : reads)
+        {
+            if(read.m_stringAddress == NULL && m_symbolTable.IsShared(*read.m_name))
+                continue;
+            int variable = variableNumbers[*read.m_name];
+            if(assigned[variable / 64] & (1ULL << (variable % 64)))
+            {
+                if(read.m_stringAddress != NULL)
+                    *read.m_stringAddress = m_symbolTable.GetStringAddress(*read.m_name);
+                else
+                    *read.m_address = m_symbolTable.GetVariableAddress(*read.m_name);
+            }
+            else
+            {
+                cerr << "Error: Variable " << *read.m_name << " may be read before it is assigned, on line "
+                     << m_statements.GetLineNumber(statement) << ": " << m_statements.GetRecordedStatement(statement) << endl;
+                failed = true;
+            }
+        }
+        for(const string &write : writes)
+        {
+            int variable = variableNumbers[write];
+            assigned[variable / 64] |= 1ULL << (variable % 64);
+        }
+    }
+    
+    if(failed)
+        exit(1);
+}
+
+/**
+ * DuckInterpreter::AnalyzeProgram. Method to analyze the program once it is loaded.
+ * Builds the control flow graph of the program, proves that its variables are assigned before they are read, and
+ * optimizes its expressions across statements. Called again when the source is reloaded, with the statement that the
+ * program goes on at. The statements that used the temporaries of the previous program were marked as rewritten, and
+ * were reset by the reload.
+ * @param a_nextStatement int The statement that the program is executed from.
+ * @see BuildFlowGraph
+ * @see CheckDefiniteAssignment
+ * @see HoistLoopInvariants
+ * @see ShareCommonSubexpressions
+ */
+void DuckInterpreter::AnalyzeProgram(int a_nextStatement)
+{
+    m_temporaries.clear();
+    m_loops.clear();
+    
+    FlowGraph graph;
+    if(a_nextStatement < m_statements.GetStatementCount())
+        graph.m_entries.push_back(a_nextStatement);
+    for(int returnStatement : m_returnStack)
+    {
+        if(returnStatement >= 0 && returnStatement < m_statements.GetStatementCount())
+            graph.m_entries.push_back(returnStatement);
+    }
+    BuildFlowGraph(graph);
+    CheckDefiniteAssignment(graph);
+    if(m_optimize)
+    {
+        HoistLoopInvariants(graph);
+        ShareCommonSubexpressions(graph);
+    }
+    ComputeTemporaries();
+}
+
+/**
+ * DuckInterpreter::FindSubexpressions. Method to find the subexpressions of compiled code.
+ * Runs the code on a stack of subexpressions instead of values: each instruction pops the subexpressions of its
+ * operands and pushes its own, which starts where its first operand starts. Array elements and sums are not pure,
+ * since arrays can change without an assignment, and neither are calls to builtins that are not pure. Comparisons of
+ * strings are not pure either, since the subexpressions only follow the numeric variables. Code with
+ * jumps, from && and ||, is left alone.
+ * @param a_code const vector<Instruction> The compiled code.
+ * @param a_subexpressions vector<Subexpression> Receives the subexpression that ends at each instruction.
+ * @return bool False if the code has jumps.
+ */
+bool DuckInterpreter::FindSubexpressions(const vector<Instruction> &a_code, vector<Subexpression> &a_subexpressions)
+{
+    a_subexpressions.assign(a_code.size(), Subexpression());
+    
+    // Subexpressions whose values are on the stack, by the instruction they end at.
+    vector<int> stack;
+    for(int i = 0; i < (int)a_code.size(); i++)
+    {
+        const Instruction &instruction = a_code[i];
+        Subexpression &subexpression = a_subexpressions[i];
+        subexpression.m_start = i;
+        int operands = 0;
+        switch (instruction.m_op)
+        {
+            case OpCode::PushNumber:
+                break;
+            case OpCode::LoadVariable:
+                subexpression.m_pure = instruction.m_variable != NULL;
+                subexpression.m_hasVariable = true;
+                break;
+            case OpCode::SumArray:
+            case OpCode::CompareStrings:
+                subexpression.m_pure = false;
+                break;
+            case OpCode::LoadArrayElement:
+                subexpression.m_pure = false;
+                operands = 1;
+                break;
+            case OpCode::CallBuiltin:
+                subexpression.m_pure = instruction.m_builtin->m_pure;
+                subexpression.m_hasOperation = true;
+                operands = instruction.m_builtin->m_arity;
+                break;
+            case OpCode::Not:
+                subexpression.m_hasOperation = true;
+                operands = 1;
+                break;
+            case OpCode::ToBoolean:
+            case OpCode::JumpIfFalse:
+            case OpCode::JumpIfTrue:
+            case OpCode::StoreTemporary:
+                return false;
+            default:
+                subexpression.m_hasOperation = true;
+                operands = 2;
+                break;
+        }
+        
+        if((int)stack.size() < operands)
+            return false;
+        for(int operand = 0; operand < operands; operand++)
+        {
+            const Subexpression &value = a_subexpressions[stack.back()];
+            stack.pop_back();
+            subexpression.m_start = value.m_start;
+            subexpression.m_pure = subexpression.m_pure && value.m_pure;
+            subexpression.m_hasOperation = subexpression.m_hasOperation || value.m_hasOperation;
+            subexpression.m_hasVariable = subexpression.m_hasVariable || value.m_hasVariable;
+        }
+        stack.push_back(i);
+    }
+    return true;
+}
+
+/**
+ * DuckInterpreter::GetSubexpressionKey. Method to get the key of a subexpression.
+ * Builds a string from the instructions of the subexpression, which is the same for identical subexpressions.
+ * @param a_code const vector<Instruction> The compiled code.
+ * @param a_start int First instruction of the subexpression.
+ * @param a_end int Last instruction of the subexpression.
+ * @param a_variables vector<string>* Receives the variables read by the subexpression, if not NULL.
+ * @return string The key.
+ */
+string DuckInterpreter::GetSubexpressionKey(const vector<Instruction> &a_code, int a_start, int a_end,
+                                            vector<string> *a_variables)
+{
+    string key;
+    for(int i = a_start; i <= a_end; i++)
+    {
+        const Instruction &instruction = a_code[i];
+        switch (instruction.m_op)
+        {
+            case OpCode::PushNumber:
+            {
+                uint64_t bits;
+                memcpy(&bits, &instruction.m_number, sizeof(bits));
+                key += "n" + to_string(bits);
+                break;
+            }
+            case OpCode::LoadVariable:
+                key += "v" + instruction.m_name;
+                if(a_variables != NULL)
+                    a_variables->push_back(instruction.m_name);
+                break;
+            case OpCode::CallBuiltin:
+                key += "f" + instruction.m_builtin->m_name;
+                break;
+            default:
+                key += "o" + to_string((int)instruction.m_op);
+                break;
+        }
+        key += " ";
+    }
+    return key;
+}
+
+/**
+ * DuckInterpreter::AddTemporary. Method to add a temporary of the optimizer.
+ * @param a_code const vector<Instruction> The compiled code that has the subexpression.
+ * @param a_start int First instruction of the subexpression.
+ * @param a_end int Last instruction of the subexpression.
+ * @return int Number of the temporary.
+ */
+int DuckInterpreter::AddTemporary(const vector<Instruction> &a_code, int a_start, int a_end)
+{
+    Temporary temporary;
+    temporary.m_name = "%t" + to_string(m_temporaries.size());
+    temporary.m_code.assign(a_code.begin() + a_start, a_code.begin() + a_end + 1);
+    m_temporaries.push_back(temporary);
+    return (int)m_temporaries.size() - 1;
+}
+
+/**
+ * DuckInterpreter::LoadTemporary. Method to replace a subexpression with a temporary.
+ * The subexpression is replaced with a LoadVariable of the temporary, which is evaluated like a proven variable.
+ * @param a_code vector<Instruction> The compiled code that has the subexpression.
+ * @param a_start int First instruction of the subexpression.
+ * @param a_end int Last instruction of the subexpression.
+ * @param a_temporary int Number of the temporary.
+ */
+void DuckInterpreter::LoadTemporary(vector<Instruction> &a_code, int a_start, int a_end, int a_temporary)
+{
+    Instruction load;
+    load.m_op = OpCode::LoadVariable;
+    load.m_name = m_temporaries[a_temporary].m_name;
+    load.m_variable = &m_temporaries[a_temporary].m_value;
+    
+    a_code.erase(a_code.begin() + a_start + 1, a_code.begin() + a_end + 1);
+    a_code[a_start] = load;
+}
+
+/**
+ * DuckInterpreter::HoistLoopInvariants. Method to hoist loop invariant subexpressions.
+ * Finds the loops of the program from the gotos and ifs that jump back: a loop is the statements from the label to
+ * the last jump back to it. Loops that can be entered elsewhere than at their header, or that have gosub or return
+ * statements, are left alone. In the other loops, the largest pure subexpressions that only read variables that the
+ * loop does not assign are replaced with temporaries. The temporaries are computed by the statements outside of
+ * the loop that go to its header, after they execute, so they are computed once each time the loop is entered.
+ * Outer loops are done first, so that the temporaries of an inner loop can use the ones of the outer loop.
+ * @param a_graph const FlowGraph The control flow graph of the program.
+ * @see EnterLoops
+ */
+void DuckInterpreter::HoistLoopInvariants(const FlowGraph &a_graph)
+{
+    int count = m_statements.GetStatementCount();
+    const vector<bool> &reachable = a_graph.m_reachable;
+    
+    // Finding the loops. A header that several statements jump back to gets the largest loop.
+    map<int,int> loopEnds;
+    for(int statement = 0; statement < count; statement++)
+    {
+        if(!reachable[statement])
+            continue;
+        const CompiledStatement &compiled = m_compiled[statement];
+        if((compiled.m_type == StatementType::GotoStat || compiled.m_type == StatementType::IfStat)
+           && compiled.m_labelLocation > 0 && compiled.m_labelLocation <= statement)
+        {
+            map<int,int>::iterator loop = loopEnds.insert(make_pair(compiled.m_labelLocation, statement)).first;
+            loop->second = max(loop->second, statement);
+        }
+    }
+    vector< pair<int,int> > loops(loopEnds.begin(), loopEnds.end());
+    sort(loops.begin(), loops.end(), [](const pair<int,int> &a_first, const pair<int,int> &a_second)
+         { return a_first.second - a_first.first > a_second.second - a_second.first; });
+    
+    vector<VariableRead> reads;
+    vector<string> writes;
+    vector<Subexpression> subexpressions;
+    for(const pair<int,int> &loop : loops)
     {
-        // Get next element.
-        a_nextPos = ParseNextElement(a_statement, a_nextPos, stringValue, numValue);
+        int header = loop.first;
+        int end = loop.second;
         
-        // Checking for separate semi-colons and unary not operator.
-        if(stringValue == ";" || stringValue == "!")
-            continue;
+        // A gosub right before the header returns into the loop.
+        bool valid = !reachable[header-1] || m_compiled[header-1].m_type != StatementType::GosubStat;
         
-        // Checking for a string value
-        if(numValue==INT_MAX)
+        // Finding the variables and temporaries assigned in the loop, and the statements that enter it.
+        unordered_set<string> assigned;
+        vector<int> entries;
+        for(int statement = header; statement <= end && valid; statement++)
         {
-            // Checking for opening brace.
-            if(stringValue == "(")
-                m_operatorStack.push_back(stringValue);
+            if(!reachable[statement])
+                continue;
+            CompiledStatement &compiled = m_compiled[statement];
+            if(compiled.m_type == StatementType::GosubStat || compiled.m_type == StatementType::ReturnStat)
+                valid = false;
             
-            // Checking if it is a variable.
-            else if(m_symbolTable.GetVariableValue(stringValue, temp) == true)
-                // Pushing the value in temp to the stack.
-                m_numberStack.push_back(temp);
+            GetVariableAccesses(compiled, reads, writes);
+            assigned.insert(writes.begin(), writes.end());
+            for(int entered : compiled.m_loopEntries)
+            {
+                for(int temporary : m_loops[entered].m_temporaries)
+                    assigned.insert(m_temporaries[temporary].m_name);
+            }
             
-            // Solving brace if closing brace found.
-            else if (stringValue == ")")
+            for(int previous : a_graph.m_predecessors[statement])
             {
-                // Performing value1 (t_operator) value2
-                while(!m_operatorStack.empty() && m_operatorStack.back() != "(")
-                {
-                    // Getting values from the stacks.
-                    int value2 = m_numberStack.back();
-                    m_numberStack.pop_back();
-                    
-                    int value1 = m_numberStack.back();
-                    m_numberStack.pop_back();
-                    
-                    string t_operator = m_operatorStack.back();
-                    m_operatorStack.pop_back();
-                    
-                    m_numberStack.push_back(DoOperation(value1, value2, t_operator));
-                }
-                
-                // Remove opening brace
-                m_operatorStack.pop_back();
+                if(previous >= header && previous <= end)
+                    continue;
+                if(statement != header)
+                    valid = false;
+                else if(find(entries.begin(), entries.end(), previous) == entries.end())
+                    entries.push_back(previous);
             }
-            // An operator.
-            else
+        }
+        if(!valid || entries.empty())
+            continue;
+        
+        // Replacing the largest invariant subexpressions of each statement, from the last instruction back.
+        map<string,int> hoisted;
+        vector<int> temporaries;
+        for(int statement = header; statement <= end; statement++)
+        {
+            if(!reachable[statement])
+                continue;
+            CompiledStatement &compiled = m_compiled[statement];
+            for(vector<Instruction> *code : {&compiled.m_indexCode, &compiled.m_code})
             {
-                // While the top operator has same or greater precedence than the current operator.
-                // We perform t_operator to the top two values on stack.
-                while(!m_operatorStack.empty() && GetOperatorPrecedence(m_operatorStack.back())
-                      >= GetOperatorPrecedence(stringValue))
+                if(!FindSubexpressions(*code, subexpressions))
+                    continue;
+                for(int i = (int)code->size() - 1; i >= 0; i--)
                 {
-                    int value2 = m_numberStack.back();
-                    m_numberStack.pop_back();
-                    
-                    int value1 = m_numberStack.back();
-                    m_numberStack.pop_back();
-                    
-                    string t_operator = m_operatorStack.back();
-                    m_operatorStack.pop_back();
+                    const Subexpression &subexpression = subexpressions[i];
+                    if(!subexpression.m_pure || !subexpression.m_hasOperation || !subexpression.m_hasVariable)
+                        continue;
+                    vector<string> variables;
+                    string key = GetSubexpressionKey(*code, subexpression.m_start, i, &variables);
+                    bool invariant = true;
+                    for(const string &variable : variables)
+                        invariant = invariant && assigned.find(variable) == assigned.end();
+                    if(!invariant)
+                        continue;
                     
-                    m_numberStack.push_back(DoOperation(value1, value2, t_operator));
+                    map<string,int>::iterator temporary = hoisted.find(key);
+                    if(temporary == hoisted.end())
+                    {
+                        temporary = hoisted.insert(make_pair(key, AddTemporary(*code, subexpression.m_start, i))).first;
+                        temporaries.push_back(temporary->second);
+                    }
+                    int start = subexpression.m_start;
+                    LoadTemporary(*code, start, i, temporary->second);
+                    compiled.m_rewritten = true;
+                    i = start;
                 }
-                // Push current element to stack, which is the result of the operation performed.
-                m_operatorStack.push_back(stringValue);
             }
         }
-        // Else it is a numeric value
-        else
-            m_numberStack.push_back(numValue);
-    }
-    
-    // Checking for any remaining operations in the operator stack.
-    if(!m_operatorStack.empty())
-    {
-        // Performing the top operation of m_operatorStack on the top two values of m_numberStack.
-        while (m_operatorStack.back() != "\0" && !m_operatorStack.empty())
+        if(temporaries.empty())
+            continue;
+        
+        Loop hoistedLoop;
+        hoistedLoop.m_header = header;
+        hoistedLoop.m_end = end;
+        hoistedLoop.m_temporaries = temporaries;
+        hoistedLoop.m_entries = entries;
+        for(int entry : entries)
         {
-            int value2 = m_numberStack.back();
-            m_numberStack.pop_back();
-            
-            int value1 = m_numberStack.back();
-            m_numberStack.pop_back();
-            
-            string t_operator = m_operatorStack.back();
-            m_operatorStack.pop_back();
-            
-            m_numberStack.push_back(DoOperation(value1, value2, t_operator));
+            m_compiled[entry].m_loopEntries.push_back((int)m_loops.size());
+            m_compiled[entry].m_rewritten = true;
         }
+        m_loops.push_back(hoistedLoop);
     }
-    
-    // The top contains the final result.
-    return m_numberStack.back();
 }
 
 /**
- * DuckInterpreter::CheckNotOperator. Method to check for not(!) operator in the statement.
- * Checks and counts for not(!) operators in the statement and determines if we need to perform the not(!) operation.
- * Handles cases when there are multiple not operators and determines if the not operation cancels out or not.
- * Removes the ! operation recorded from the statement and returns a bool if we need to perform the operation or not.
- * @param a_statement const string Holds the arithmetic expression.
- * @return bool Whether we need to perform the not(!) operation.
- * @author Salil Maharjan
- * @date 03/13/19
+ * DuckInterpreter::ShareCommonSubexpressions. Method to share identical subexpressions within basic blocks.
+ * Goes through the statements of each basic block in the order they are evaluated, and finds the pure
+ * subexpressions that are computed again while the variables they read have not been assigned. The largest ones are
+ * shared first: the first one stores its value to a temporary as it is computed, and the others load it.
+ * @param a_graph const FlowGraph The control flow graph of the program.
  */
-bool DuckInterpreter::CheckNotOperator(string &a_statement)
+void DuckInterpreter::ShareCommonSubexpressions(const FlowGraph &a_graph)
 {
-    // Not operator flag.
-    bool notOperator = false;
+    int count = m_statements.GetStatementCount();
+    
+    // A subexpression in the code of a statement.
+    struct Occurrence
+    {
+        int m_statement;
+        vector<Instruction> *m_code;
+        int m_start;
+        int m_end;
+    };
+    
+    // A change to the code: the subexpression is stored to a temporary, or replaced with a load of it.
+    struct Change
+    {
+        vector<Instruction> *m_code;
+        int m_start;
+        int m_end;
+        int m_temporary;
+        bool m_store;
+    };
     
-    // Checking for unary "!" operator.
-    if(a_statement.find("!") != string::npos && (a_statement.find("=") != a_statement.find("!")+1))
+    vector<VariableRead> reads;
+    vector<string> writes;
+    vector<Subexpression> subexpressions;
+    for(int block = 0; block < (int)a_graph.m_blockStarts.size(); block++)
     {
-        // Counting the instances unary "!" operator
-        size_t notOperatorCount = std::count(a_statement.begin(), a_statement.end(),'!');
+        // Finding the occurrences of each subexpression while the variables it reads are not assigned.
+        unordered_map<string,int> available;
+        vector< vector<Occurrence> > occurrences;
+        vector< vector<string> > readVariables;
+        for(int statement = a_graph.m_blockStarts[block]; statement < count && a_graph.m_blockOf[statement] == block;
+            statement++)
+        {
+            CompiledStatement &compiled = m_compiled[statement];
+            for(vector<Instruction> *code : {&compiled.m_indexCode, &compiled.m_code})
+            {
+                if(!FindSubexpressions(*code, subexpressions))
+                    continue;
+                for(int i = 0; i < (int)code->size(); i++)
+                {
+                    const Subexpression &subexpression = subexpressions[i];
+                    if(!subexpression.m_pure || !subexpression.m_hasOperation || !subexpression.m_hasVariable)
+                        continue;
+                    vector<string> variables;
+                    string key = GetSubexpressionKey(*code, subexpression.m_start, i, &variables);
+                    Occurrence occurrence = {statement, code, subexpression.m_start, i};
+                    unordered_map<string,int>::iterator shared = available.find(key);
+                    if(shared != available.end())
+                        occurrences[shared->second].push_back(occurrence);
+                    else
+                    {
+                        available[key] = (int)occurrences.size();
+                        occurrences.push_back(vector<Occurrence>(1, occurrence));
+                        readVariables.push_back(variables);
+                    }
+                }
+            }
+            
+            GetVariableAccesses(compiled, reads, writes);
+            for(const string &write : writes)
+            {
+                for(unordered_map<string,int>::iterator shared = available.begin(); shared != available.end();)
+                {
+                    const vector<string> &variables = readVariables[shared->second];
+                    if(find(variables.begin(), variables.end(), write) != variables.end())
+                        shared = available.erase(shared);
+                    else
+                        shared++;
+                }
+            }
+        }
         
-        // Checking for !=
-        if(a_statement.find("!=") != string::npos)
-            notOperatorCount--;
+        // Sharing the largest subexpressions first. Subexpressions inside a replaced one are not computed anymore.
+        vector<int> order;
+        for(int shared = 0; shared < (int)occurrences.size(); shared++)
+        {
+            if(occurrences[shared].size() > 1)
+                order.push_back(shared);
+        }
+        if(order.empty())
+            continue;
+        stable_sort(order.begin(), order.end(), [&occurrences](int a_first, int a_second)
+                    { return occurrences[a_first][0].m_end - occurrences[a_first][0].m_start
+                             > occurrences[a_second][0].m_end - occurrences[a_second][0].m_start; });
         
-        // Check if we need to perform the logical not operation
-        if(notOperatorCount%2 != 0)
-            notOperator = true;
+        vector<Change> changes;
+        auto isReplaced = [&changes](const Occurrence &a_occurrence)
+        {
+            for(const Change &change : changes)
+            {
+                if(!change.m_store && change.m_code == a_occurrence.m_code && a_occurrence.m_start <= change.m_end
+                   && a_occurrence.m_end >= change.m_start)
+                    return true;
+            }
+            return false;
+        };
+        for(int shared : order)
+        {
+            const vector<Occurrence> &found = occurrences[shared];
+            if(isReplaced(found[0]))
+                continue;
+            vector<Occurrence> uses;
+            for(size_t i = 1; i < found.size(); i++)
+            {
+                if(!isReplaced(found[i]))
+                    uses.push_back(found[i]);
+            }
+            if(uses.empty())
+                continue;
+            
+            int temporary = AddTemporary(*found[0].m_code, found[0].m_start, found[0].m_end);
+            changes.push_back({found[0].m_code, found[0].m_start, found[0].m_end, temporary, true});
+            m_compiled[found[0].m_statement].m_rewritten = true;
+            for(const Occurrence &use : uses)
+            {
+                changes.push_back({use.m_code, use.m_start, use.m_end, temporary, false});
+                m_compiled[use.m_statement].m_rewritten = true;
+            }
+        }
         
-        // Removing ! operators.
-        while(notOperatorCount != 0)
+        // Changing the code from its last instruction back, so that the positions of the other changes stay valid.
+        sort(changes.begin(), changes.end(), [](const Change &a_first, const Change &a_second)
+             { return a_first.m_code != a_second.m_code ? a_first.m_code < a_second.m_code : a_first.m_end > a_second.m_end; });
+        for(const Change &change : changes)
         {
-            a_statement.replace(a_statement.find("!"), 1, "");
-            notOperatorCount--;
+            if(change.m_store)
+            {
+                Instruction store;
+                store.m_op = OpCode::StoreTemporary;
+                store.m_name = m_temporaries[change.m_temporary].m_name;
+                store.m_variable = &m_temporaries[change.m_temporary].m_value;
+                change.m_code->insert(change.m_code->begin() + change.m_end + 1, store);
+            }
+            else
+                LoadTemporary(*change.m_code, change.m_start, change.m_end, change.m_temporary);
         }
     }
-    return notOperator;
 }
 
 /**
- * DuckInterpreter::EvaluateIfStatement. Method to evaluate If Statements.
- * Evaluates an if statement to determine if the goto should be executed.
- * @param a_statement const string Holds the if statement.
- * @param a_nextStatement int Current statement position. Used to return the next position of the statement.
- * @return int The next position of the statement that needs to be executed.
- * @see ParseNextElement
- * @see EevaluateIfGotoExpression
- * @see CheckNotOperator
- * @see EvaluateArithmeticExpression
- * @author Salil Maharjan
- * @date 03/13/19
+ * DuckInterpreter::ComputeTemporaries. Method to compute all the temporaries of the optimizer.
+ * Temporaries are computed in the order they were added, so that the ones of outer loops are ready for the ones
+ * of inner loops. Used when execution starts from a snapshot or after a reload, where the loops and blocks were
+ * not entered from their start. The subexpressions only read variables that do not change in their loop or block,
+ * so computing them from the current variables gives the values they would have had.
  */
-int DuckInterpreter::EvaluateIfStatement(string a_statement, int a_nextStatement)
+void DuckInterpreter::ComputeTemporaries()
 {
-    // Flag to track if we find a logical not(!) operator
-    bool notOperator = false;
-    
-    // Get past of the "if" in the if statement.
-    int nextPos = 0;
-    string resultString;
-    double placeHolder;
-    nextPos = ParseNextElement(a_statement, nextPos, resultString, placeHolder);
-    assert(resultString == "if");
-    
-    // Searching from the end, find the goto statement and replace it by ";"  Record
-    // the label in the goto.
-    string label = EvaluateIfGotoExpression(a_statement);
-    int labelLocation = m_statements.GetLabelLocation(label);
-    
-    // Verify that the label from the goto exists.
-    m_statements.GetStatement(labelLocation);
-    
-    // Checking for Not(!) operators
-    notOperator = CheckNotOperator(a_statement);
-  
-    // Evaluate the remaining arithmentic expression.
-    double result = EvaluateArithmenticExpression(a_statement, nextPos);
-    
-    // Doing the not operation if flagged.
-    if(notOperator)
-        result = (!result);
-    
-    // If the result is zero, don't execute the goto.
-    if (result == 0)
-        return a_nextStatement + 1;
-    
-    // Return the goto label location.
-    return labelLocation;
+    for(Temporary &temporary : m_temporaries)
+        temporary.m_value = EvaluateArithmenticExpression(temporary.m_code);
 }
 
 /**
- * DuckInterpreter::EvaluateIfGotoExpression. Method to evaluate goto expressions in an If statement.
- * Searches till the end of the statement for the label and returns it.
- * Then replaces the goto statement with ";"
- * @param a_statement string Holds the if statement.
- * @return string The label associated with the goto statement.
- * @author Salil Maharjan
- * @date 03/13/19
+ * DuckInterpreter::EnterLoops. Method to enter loops with hoisted subexpressions.
+ * Computes the temporaries of the loops that a_statement enters, if it goes to their header.
+ * @param a_statement const CompiledStatement The statement that was executed.
+ * @param a_nextStatement int The statement it goes to.
+ * @see HoistLoopInvariants
  */
-string DuckInterpreter::EvaluateIfGotoExpression(string &a_statement)
+void DuckInterpreter::EnterLoops(const CompiledStatement &a_statement, int a_nextStatement)
 {
-    // Holds the next string element
-    string buffer;
-    // Holds the last item - label.
-    string end_item;
-    
-    // Parsing the last element string
-    // Not using ParseNextElement to reduce overheads.
-    istringstream line(a_statement.c_str(), (int)a_statement.size());
-    for(;;)
+    for(int loop : a_statement.m_loopEntries)
     {
-        buffer="";
-        line>>buffer;
-        int test = (int)buffer.size();
-        if( test == 0 )
-            break;
-        end_item = buffer;
+        if(m_loops[loop].m_header != a_nextStatement)
+            continue;
+        for(int temporary : m_loops[loop].m_temporaries)
+            m_temporaries[temporary].m_value = EvaluateArithmenticExpression(m_temporaries[temporary].m_code);
     }
-    
-    // Checking for end of statement semi-colon and removing it
-    if(end_item.find(";") && end_item.find(";")==end_item.length()-1)
-        end_item.pop_back();
-    
-    // Replacing the goto statement with ";"
-    a_statement.replace(a_statement.find(" goto"), a_statement.find(";"), ";");
-    
-    // Returning the label.
-    return end_item;
-    
 }
 
 /**
- * DuckInterpreter::EvaluateQuotedPrompt. Method to evaluate quoted prompts.
- * Function that evaluates quoted prompts. Used by EvaluatePrintStatement and EvaluateReadStatement to evaluate prompts
- * in quotations. Parameters are passed by reference from the calling function.
- * @param a_statement string Holds the statement with quoted prompt.
- * @param quoted bool flag used to track quoted part of the statement.
- * @param nextPos int Position of the current element in the statement where we need to start evaluating from.
- * @param resultString string Position holder to get string element from ParseNextElement
- * @param placeHolder double Position holder to get numeric element from ParseNextElement.
- * @see ParseNextElement
- * @see EvaluatePrintStatement
- * @see EvaluateReadStatement
- * @see Statement::StandardSpaceFormat
- * @author Salil Maharjan
- * @date 03/13/19
+ * DuckInterpreter::FormatCode. Method to format compiled code.
+ * Formats the instructions in postfix order, with operators as they are written in the source.
+ * @param a_code const vector<Instruction> The compiled code.
+ * @return string The formatted code.
+ * @see DumpOptimizedProgram
  */
-// Evaluates Quoted Prompts. Used by EvaluatePrintStatement and EvaluateReadStatement.
-void DuckInterpreter::EvaluateQuotedPrompt(string &a_statement, bool &quoted, int &nextPos, string &resultString, double &placeHolder)
+string DuckInterpreter::FormatCode(const vector<Instruction> &a_code)
 {
-    // Checking for the starting quotations:
-    if(quoted == false && (resultString.find("\"") != resultString.length()-1))
-        cout << resultString.substr(resultString.find("\"")+1,string::npos)<<" ";
-    // Case where we have separate multiple quotations.
-    else
-        // Since we are parsing by whitespaces, it is removed. Printing out the removed delimiter.
-        cout<<" ";
-    
-    // Updating quote flag for the calling function.
-    quoted = true;
+    static const char *const OPERATORS[] = {"+", "-", "*", "/", "%", "<", "<=", ">", ">=", "==", "!="};
     
-    // Printing the entire quotation until the end quotation is reached.
-    while(quoted == true)
+    ostringstream text;
+    for(size_t i = 0; i < a_code.size(); i++)
     {
-        nextPos = ParseNextElement(a_statement, nextPos, resultString, placeHolder);
-        
-        // If we find the ending quotations
-        if(resultString.find("\"") != string::npos)
+        const Instruction &instruction = a_code[i];
+        if(i > 0)
+            text << " ";
+        switch (instruction.m_op)
         {
-            quoted = false;
-            // Checking if there are elements before ending quotation
-            if(resultString.find("\"") != 0 )
-                cout<<resultString.substr(0,resultString.find("\""));
-            break;
+            case OpCode::PushNumber:
+                text << instruction.m_number;
+                break;
+            case OpCode::LoadVariable:
+                text << instruction.m_name;
+                break;
+            case OpCode::LoadArrayElement:
+                text << instruction.m_name << "[]";
+                break;
+            case OpCode::SumArray:
+                text << "sum(" << instruction.m_name << ")";
+                break;
+            case OpCode::CallBuiltin:
+                text << instruction.m_builtin->m_name << "()";
+                break;
+            case OpCode::Not:
+                text << "!";
+                break;
+            case OpCode::ToBoolean:
+                text << "bool";
+                break;
+            case OpCode::JumpIfFalse:
+                text << "jump-if-false@" << instruction.m_jump;
+                break;
+            case OpCode::JumpIfTrue:
+                text << "jump-if-true@" << instruction.m_jump;
+                break;
+            case OpCode::StoreTemporary:
+                text << "=>" << instruction.m_name;
+                break;
+            case OpCode::CompareStrings:
+                text << "(" << FormatStringCode(instruction.m_comparison->m_left) << " "
+                     << OPERATORS[(int)instruction.m_comparison->m_op - (int)OpCode::Add] << " "
+                     << FormatStringCode(instruction.m_comparison->m_right) << ")";
+                break;
+            default:
+                text << OPERATORS[(int)instruction.m_op - (int)OpCode::Add];
+                break;
         }
-        else
-            // Printing whitespace as we parse elements by whitespace and is removed.
-            cout << resultString << " ";
     }
-    
-    // Asserting that nothing is attached to commas in the statement.
-    // Spaces would have been added by function Statement::StandardSpaceFormat
-    if(resultString.find(",") != string::npos && quoted == false)
-        assert(resultString.find(",")==0 || resultString.find(",")==resultString.length()-1);
-    
+    return text.str();
 }
 
 /**
- * DuckInterpreter::EvaluatePrintStatement. Method to evaluate Print statements.
- * Evaluates print statements. Asserts for "print" keyword, prints the quoted prompts and variables that are comma separated
- * in the code.
- * @param a_statement string Holds the print statement.
- * @see ParseNextElement
- * @see EvaluateQuotedPrompt
- * @see SymbolTable::GetVariableValue
- * @author Salil Maharjan
- * @date 03/13/19
+ * DuckInterpreter::FormatStringCode. Method to format the terms of a string expression, for --dump-optimized.
+ * @param a_terms const vector<StringTerm> The terms.
+ * @return string The terms, quoted strings and variables, separated by +.
+ * @see FormatCode
  */
-void DuckInterpreter::EvaluatePrintStatement(string a_statement)
+string DuckInterpreter::FormatStringCode(const vector<StringTerm> &a_terms)
 {
-    // Flag used to check for quotations.
-    bool quoted = false;
-    
-    // Get past of the "print" in the print statement.
-    int nextPos = 0;
-    string resultString;
-    double placeHolder;
-    nextPos = ParseNextElement(a_statement, nextPos, resultString, placeHolder);
-    assert(resultString == "print");
-    
-    // Evaluating the print expression.
-    while(nextPos!=INT_MAX)
+    string text;
+    for(size_t i = 0; i < a_terms.size(); i++)
     {
-        nextPos = ParseNextElement(a_statement, nextPos, resultString, placeHolder);
-        
-        // Checking for separate commas.
-        if(resultString.find(",") != string::npos && resultString.length()==1)
-            continue;
-        
-        // Checking for quotations and calling EvaluateQuotedPrompt to print quotations.
-        if(resultString.find("\"") != string::npos)
+        if(i > 0)
+            text += " + ";
+        if(!a_terms[i].m_name.empty())
+            text += a_terms[i].m_name;
+        else
         {
-            EvaluateQuotedPrompt(a_statement, quoted, nextPos, resultString, placeHolder);
-            continue;
+            text += '"';
+            a_terms[i].m_literal.AppendTo(text);
+            text += '"';
         }
-        
-        // Checking for variables and printing them out.
-        if(m_symbolTable.GetVariableValue(resultString, placeHolder) == true)
-            cout << placeHolder;
     }
-    
-    // End of Print Statement
-    cout<<endl;
+    return text;
 }
 
 /**
- * DuckInterpreter::EvaluateReadStatement. Method to evaluate Read statements.
- * Evaluates read statements. Asserts for "read" keyword, prints the quoted prompts and gets input from the user
- * for the specified variables.
- * @param a_statement string Holds the read statement.
- * @see ParseNextElement
- * @see EvaluateQuotedPrompt
- * @see SymbolTable::GetVariableValue
- * @see SymbolTable::RecordVariableValue
- * @author Salil Maharjan
- * @date 03/13/19
+ * DuckInterpreter::DumpOptimizedProgram. Method to print the optimized program, for --dump-optimized.
+ * Prints the loops with hoisted subexpressions, with the code of their temporaries and the statements that compute
+ * them, then the code of each statement that can be reached, in postfix order. Temporaries are named %t0, %t1...
+ * @param a_out ostream Stream to print to.
+ * @see FormatCode
  */
-void DuckInterpreter::EvaluateReadStatement(string a_statement)
+void DuckInterpreter::DumpOptimizedProgram(ostream &a_out)
 {
-    // Flag used to check for quotations.
-    bool quoted = false;
-    
-    // Get past of the "read" in the read statement.
-    int nextPos = 0;
-    string resultString;
-    double placeHolder;
-    nextPos = ParseNextElement(a_statement, nextPos, resultString, placeHolder);
-    assert(resultString == "read");
+    for(const Loop &loop : m_loops)
+    {
+        a_out << "loop: lines " << m_statements.GetLineNumber(loop.m_header) << " to "
+              << m_statements.GetLineNumber(loop.m_end) << ", entered from line";
+        for(int entry : loop.m_entries)
+            a_out << " " << m_statements.GetLineNumber(entry);
+        a_out << endl;
+        for(int temporary : loop.m_temporaries)
+            a_out << "    " << m_temporaries[temporary].m_name << " = " << FormatCode(m_temporaries[temporary].m_code) << endl;
+    }
     
-    // Evaluating the entire read statement.
-    while(nextPos!=INT_MAX)
+    for(int statement = 0; statement < (int)m_compiled.size(); statement++)
     {
-        nextPos = ParseNextElement(a_statement, nextPos, resultString, placeHolder);
-        
-        // Checking for separate commas.
-        if(resultString.find(",") != string::npos && resultString.length()==1)
+        const CompiledStatement &compiled = m_compiled[statement];
+        if(!compiled.m_compiled)
             continue;
         
-        // Checking for prompt.
-        if(resultString.find("\"") != string::npos)
-        {
-            EvaluateQuotedPrompt(a_statement, quoted, nextPos, resultString, placeHolder);
-            continue;
-        }
-        // Else it is a variable
-        else
-        {
-            // Checking and removing trailing commas if any.
-            if(resultString.find(",") != string::npos && resultString.find(",")==resultString.length()-1 && resultString.length()>1) resultString.pop_back();
-            
-            // Get input and store it in the variable map.
-            double temp;
-            scanf("%lf", &temp);
-            m_symbolTable.RecordVariableValue(resultString, temp);
-        }
+        string label;
+        a_out << "line " << m_statements.GetLineNumber(statement) << ": ";
+        if(m_statements.HasLabel(statement) && m_statements.FindEnclosingLabel(statement, label))
+            a_out << label << ":";
+        a_out << m_statements.GetRecordedStatement(statement) << endl;
+        if(!compiled.m_indexCode.empty())
+            a_out << "    index: " << FormatCode(compiled.m_indexCode) << endl;
+        if(!compiled.m_code.empty())
+            a_out << "    code: " << FormatCode(compiled.m_code) << endl;
+        if(compiled.m_accumulate != 0)
+            a_out << "    atomic: " << compiled.m_elements[0].m_string << (compiled.m_accumulate > 0 ? " += code" : " -= code") << endl;
+        if(!compiled.m_stringCode.empty())
+            a_out << "    string: " << FormatStringCode(compiled.m_stringCode) << endl;
     }
-    
-    //End of Read Statement
-    cout<<endl;
 }
 
 /**
- * DuckInterpreter::EvaluateGotoStatement. Method to evaluate Goto statements.
- * Evaluates goto statements. At this point, we know that it is a goto statement. The label is the second syntatic element.
- * We parse it and verify that it is a valid label and return the corresponding value of its location.
- * @param a_statement const string Holds the goto statement.
- * @return int Position of the label specified in the goto statement.
- * @see ParseNextElement
- * @see Statement::GetLabelLocation
- * @see Statement::GetStatement
- * @author Salil Maharjan
- * @date 03/13/19
+ * DuckInterpreter::PrepareMemoization. Method to prepare the program for the output cache.
+ * The output of a program only depends on its read input if it does not call builtins that are not pure, and does
+ * not spawn regions, whose lines come in the order that the threads print them. The statements that can be reached
+ * were compiled by the analysis of the program, so only they are checked.
+ * Hashes the normalized program once, so that requests for a cached program do not format it again. The format of
+ * the printed numbers is part of the hash.
+ * @see Statement::GetNormalizedHash
  */
-int DuckInterpreter::EvaluateGotoStatement(const string &a_statement)
+void DuckInterpreter::PrepareMemoization()
 {
-    string label;
-    double placeHolder;
-    
-    // Label is the second syntactic element.
-    ParseNextElement(a_statement, 1, label, placeHolder);
-    
-    int labelLocation = m_statements.GetLabelLocation(label);
-    
-    // Verify that the label exists.
-    m_statements.GetStatement(labelLocation);
+    m_memoizable = true;
+    for(const CompiledStatement &compiled : m_compiled)
+    {
+        if(compiled.m_compiled && compiled.m_type == StatementType::SpawnStat)
+            m_memoizable = false;
+        for(const vector<Instruction> *code : {&compiled.m_indexCode, &compiled.m_code})
+        {
+            for(const Instruction &instruction : *code)
+            {
+                if(instruction.m_op == OpCode::CallBuiltin && !instruction.m_builtin->m_pure)
+                    m_memoizable = false;
+            }
+        }
+    }
+    m_normalizedHash = m_statements.GetNormalizedHash();
     
-    return labelLocation;
+    // Outputs cached by older versions printed numbers with 6 digits, and are still found in that format.
+    if(m_numberFormat != NumberFormat::SixDigits)
+        m_normalizedHash = OutputCache::HashBytes("shortest", 8, m_normalizedHash);
 }
@@ -12,9 +12,20 @@
 //#include "stdafx.h"
 #include "Statement.hpp"
 #include "SymbolTable.hpp"
+#include "Builtins.hpp"
+#include "FlightRecorder.hpp"
+#include "PerfCounters.hpp"
+#include "AsyncOutput.hpp"
+#include "SamplingProfiler.hpp"
+#include "OutputCache.hpp"
+#include "TaskPool.hpp"
+#include "NumberFormat.hpp"
 
 class DuckInterpreter
 {
+    // duckbench times the building blocks of the interpreter in isolation.
+    friend class MicroBenchmark;
+    
 public:
     DuckInterpreter();
     ~DuckInterpreter();
@@ -23,25 +34,165 @@ public:
     // Calls Statement::RecordStatements.
     void RecordStatements(string a_fileName)
     {
+        m_sourceFileName = a_fileName;
         m_statements.RecordStatements(a_fileName);
-        
+        LoadProgram();
+    }
+    
+    // Method to record statements from the text of a source file that was already read from a_fileName.
+    // Calls Statement::RecordSource.
+    void RecordSource(const string &a_fileName, const string &a_source)
+    {
+        m_sourceFileName = a_fileName;
+        m_statements.RecordSource(a_source, a_fileName);
+        LoadProgram();
+    }
+    
+    // Method to compile every statement up front, instead of the first time they are reached.
+    void CompileStatements()
+    {
+        for(int i = 0; i < m_statements.GetStatementCount(); i++)
+            GetCompiledStatement(i);
     }
     
     // Method that runs the interpreter.
     void RunInterpreter();
     
+    // Method to reload the source whenever it changes while the interpreter runs.
+    void EnableWatch()
+    {
+        m_watch = true;
+        m_sourceStamp = GetSourceStamp();
+    }
+    
+    // Method to write a snapshot of the interpreter state to a_fileName every a_interval statements, and on SIGUSR2.
+    // An interval of 0 only writes snapshots on SIGUSR2.
+    void EnableCheckpoints(const string &a_fileName, long a_interval);
+    
+    // Method to set the file that the flight recorder is dumped to. By default it is duck-<pid>.trace.
+    void SetTraceFile(const string &a_fileName)
+    {
+        m_traceFileName = a_fileName;
+    }
+    
+    // Method to report how many statements each peephole rule rewrote, when the program stops.
+    void EnableOptimizationStats()
+    {
+        m_optimizationStats = true;
+    }
+    
+    // Method to run the statements as they are parsed, without the peephole rules, the optimizations across statements
+    // and the traces of hot loops. Must be called before RecordStatements.
+    void DisableOptimizations()
+    {
+        m_optimize = false;
+    }
+    
+    // Method to read performance counters while the interpreter runs, and report them when the program stops.
+    void EnableStats()
+    {
+        m_stats = true;
+    }
+    
+    // Method to sample the statement being executed a_frequency times per second of CPU time. When the program stops,
+    // the samples are written as collapsed stacks to a_fileName, and the a_top statements and labels are reported.
+    void EnableSampling(const string &a_fileName, int a_frequency, int a_top)
+    {
+        m_sampleFileName = a_fileName;
+        m_sampleFrequency = a_frequency;
+        m_sampleTop = a_top;
+    }
+    
+    // Method to find out whether the output of the program only depends on its read input, and to hash the program,
+    // for the output cache. Must be called after RecordStatements.
+    void PrepareMemoization();
+    
+    // Accessor to check whether the output of the program can be cached. See PrepareMemoization.
+    bool IsMemoizable() const
+    {
+        return m_memoizable;
+    }
+    
+    // Accessor to get the hash of the normalized program, the program part of its output cache key.
+    uint64_t GetNormalizedProgramHash() const
+    {
+        return m_normalizedHash;
+    }
+    
+    // Method to set the recorder of the output of a run that is cached. The run is discarded if a read finds no input.
+    void SetOutputRecorder(OutputRecorder *a_recorder)
+    {
+        m_outputRecorder = a_recorder;
+    }
+    
+    // Method to set how print statements write numbers. By default, with the fewest digits that read back exactly.
+    void SetNumberFormat(NumberFormat a_format)
+    {
+        m_numberFormat = a_format;
+    }
+    
+    // Method to write the output on a separate thread, so that printing does not wait for slow readers.
+    void EnableAsyncOutput()
+    {
+        m_asyncOutput.reset(new AsyncOutput(STDOUT_FILENO));
+        m_asyncOutput->Start();
+    }
+    
+    // Method to print the statements that can be reached as they are optimized, with the loops and their hoisted code.
+    void DumpOptimizedProgram(ostream &a_out);
+    
+    // Method to restore the interpreter state from a snapshot written by a checkpoint.
+    // Must be called after RecordStatements, with the same program.
+    void ResumeFromSnapshot(const string &a_fileName);
+    
 private:
+    // Identifies snapshot files, and the version of their format.
+    static const char SNAPSHOT_MAGIC[8];
+    static const uint32_t SNAPSHOT_VERSION = 4;
+    
+    // File that checkpoints are written to. Empty if checkpoints are disabled.
+    string m_checkpointFileName;
+    
+    // Number of statements between checkpoints, 0 if they are only taken on a signal,
+    // and the number of statements executed since the last one.
+    long m_checkpointInterval = 0;
+    long m_statementsSinceCheckpoint = 0;
+    
+    // Statement that RunInterpreter starts from.
+    int m_startStatement = 0;
+    
+    // Number of statements executed between two safe points.
+    static const int SAFE_POINT_INTERVAL = 4096;
+    
+    // Name of the source file the statements were recorded from.
+    string m_sourceFileName;
+    
+    // Whether the source is reloaded when it changes, and the modification stamp of the loaded source.
+    bool m_watch = false;
+    string m_sourceStamp;
+    
+    // Trace of the last statements executed, dumped on errors and on SIGUSR1, and the file it is dumped to.
+    FlightRecorder m_flightRecorder;
+    string m_traceFileName;
+    
+    // Statements left until the next safe point.
+    int m_safePointCountdown = SAFE_POINT_INTERVAL;
+    
     // Statement variable that holds the code statements.
     Statement m_statements;
     
     // SymbolTable variable that holds the value of all variables.
     SymbolTable m_symbolTable;
     
-    // Operator stack used for evaluating arithmetic statements.
-    vector<string> m_operatorStack;
-    // Number stack used for evaluating arithmetic statements.
+    // Number stack used for evaluating arithmetic expressions.
     vector<double> m_numberStack;
     
+    // Maximum depth of nested gosub statements.
+    static const int RETURN_STACK_DEPTH = 1024;
+    
+    // Statements that return statements go back to, innermost last. Allocated once for RETURN_STACK_DEPTH entries.
+    vector<int> m_returnStack;
+    
     // Class of all the different types of statements in the Duck Language.
     enum class StatementType
     {
@@ -53,57 +204,554 @@ private:
         EndStat,
         GotoStat,
         CommentStat,
+        DimStat,
+        FillStat,
+        CopyStat,
+        SortStat,
+        GosubStat,
+        ReturnStat,
+        // Assignment to a string variable. Recorded as an arithmetic statement, and told apart when it is compiled.
+        StringStat,
+        SpawnStat,
+        JoinStat,
+        SharedStat,
+    };
+    
+    // A syntactic element of a statement, in the form returned by ParseNextElement.
+    struct Element
+    {
+        // The element if it is not a number, "NULL" otherwise.
+        string m_string;
+        // The element if it is a number, INT_MAX otherwise.
+        double m_number;
+        // True if the element ends the statement.
+        bool m_endOfStatement;
+    };
+    
+    // Operations of compiled arithmetic expressions.
+    enum class OpCode
+    {
+        PushNumber,
+        LoadVariable,
+        LoadArrayElement,
+        SumArray,
+        CallBuiltin,
+        Add,
+        Subtract,
+        Multiply,
+        Divide,
+        Modulo,
+        Less,
+        LessEqual,
+        Greater,
+        GreaterEqual,
+        Equal,
+        NotEqual,
+        Not,
+        // Turns the top value into 1 if it is not 0. Ends the right operand of && and ||.
+        ToBoolean,
+        // Left operand of &&. If it is false, jumps to m_jump leaving it as the result. Otherwise pops it.
+        JumpIfFalse,
+        // Left operand of ||. If it is true, jumps to m_jump leaving 1 as the result. Otherwise pops it.
+        JumpIfTrue,
+        // Copies the top value to the temporary at m_variable. Stores a subexpression shared with later statements.
+        StoreTemporary,
+        // Compares the string expressions of m_comparison, and pushes the result like the numeric comparisons.
+        CompareStrings,
+    };
+    
+    // A term of a string expression: a quoted literal, or a string variable.
+    struct StringTerm
+    {
+        DuckString m_literal;
+        // Name of the string variable. Empty for a literal.
+        string m_name;
+        // Address of the variable, once CheckDefiniteAssignment proved that it is assigned.
+        DuckString *m_variable = NULL;
+    };
+    
+    // A comparison of two string expressions, whose terms are concatenated. m_op is a comparison operation.
+    struct StringComparison
+    {
+        vector<StringTerm> m_left;
+        vector<StringTerm> m_right;
+        OpCode m_op;
+    };
+    
+    // An instruction of a compiled arithmetic expression. Expressions are compiled to postfix order,
+    // and run on m_numberStack.
+    struct Instruction
+    {
+        OpCode m_op;
+        // Value pushed by PushNumber.
+        double m_number = 0;
+        // Variable or array of LoadVariable, LoadArrayElement and SumArray.
+        string m_name;
+        // Address of the variable of a LoadVariable, once CheckDefiniteAssignment proved that it is assigned,
+        // or of the temporary of a LoadVariable or StoreTemporary introduced by the optimizer.
+        double *m_variable = NULL;
+        // Function called by CallBuiltin.
+        const Builtin *m_builtin = NULL;
+        // Instruction that JumpIfFalse and JumpIfTrue jump to.
+        int m_jump = 0;
+        // Strings compared by CompareStrings. Shared by the copies of the instruction.
+        shared_ptr<StringComparison> m_comparison;
+    };
+    
+    // An operator waiting on the operator stack while an expression is compiled.
+    struct PendingOperator
+    {
+        string m_operator;
+        // Array indexed by a "[" operator.
+        string m_arrayName;
+        // Builtin called by a "(" operator, and the number of commas between its arguments.
+        const Builtin *m_builtin = NULL;
+        int m_commaCount = 0;
+        // Number of values on the stack when a bracket was opened, to count the values inside it.
+        int m_depth = 0;
+        // Jump instruction of a && or || operator, patched to skip its right operand.
+        int m_jumpInstruction = -1;
+    };
+    
+    // Compiled form of a statement. Built from the source text the first time the statement is reached.
+    struct CompiledStatement
+    {
+        // Whether the statement is ready to execute. Statements are parsed by CompileStatement, then go through
+        // the peephole optimizer.
+        bool m_compiled = false;
+        bool m_parsed = false;
+        // Whether the peephole optimizer rewrote the statement based on other statements.
+        bool m_rewritten = false;
+        StatementType m_type;
+        
+        // Elements of the statement. For if statements, the goto is replaced by ";".
+        vector<Element> m_elements;
+        
+        // Variable and amount for unary ++ and -- statements, and increments found by the peephole optimizer.
+        // m_unaryStep is 0 for other statements.
+        string m_unaryVariable;
+        double m_unaryStep = 0;
+        // Address of the unary variable, once CheckDefiniteAssignment proved that it is assigned.
+        double *m_unaryAddress = NULL;
+        // Whether the variable is truncated before the step is added, like the operands of the increments found by
+        // the peephole optimizer. ++ and -- do not truncate.
+        bool m_unaryTruncates = false;
+        
+        // Value of the variable assigned by an arithmetic statement, if it is shared between threads. m_accumulate is
+        // 1 or -1 if the statement adds m_code to it or subtracts m_code from it, which is done atomically.
+        atomic<double> *m_sharedValue = NULL;
+        int m_accumulate = 0;
+        
+        // Array of a dim, fill, copy or sort statement, or of an indexed assignment. For copy, the destination.
+        string m_arrayName;
+        // Source array of a copy statement.
+        string m_sourceArrayName;
+        
+        // Expression of an arithmetic statement, the condition of an if statement, or the value of a fill statement.
+        vector<Instruction> m_code;
+        // Expression of the size of a dim statement, or of the index of an indexed assignment.
+        vector<Instruction> m_indexCode;
+        // Terms of the expression of a string assignment.
+        vector<StringTerm> m_stringCode;
+        
+        // Label and its statement number for a goto, an if ... goto or a gosub.
+        string m_label;
+        int m_labelLocation = -1;
+        
+        // Loops whose temporaries are computed when this statement goes to their header from outside the loop.
+        vector<int> m_loopEntries;
     };
+    
+    // Control flow graph of the statements that can be reached.
+    struct FlowGraph
+    {
+        vector< vector<int> > m_successors;
+        vector< vector<int> > m_predecessors;
+        vector<bool> m_reachable;
+        // Statements that execution starts at: the first one, or after a reload the next one and the return statements
+        // of the gosubs in progress.
+        vector<int> m_entries;
+        // Basic block of each statement that can be reached, -1 for the others, and the first statement of each block.
+        vector<int> m_blockOf;
+        vector<int> m_blockStarts;
+    };
+    
+    // A temporary introduced by the optimizer, and the code of the subexpression it holds.
+    struct Temporary
+    {
+        double m_value = 0;
+        string m_name;
+        vector<Instruction> m_code;
+    };
+    
+    // Temporaries of the optimizer. A deque, so that their addresses stay valid as more are added.
+    deque<Temporary> m_temporaries;
+    
+    // A loop found from a jump back to its header, with the temporaries computed when it is entered and the
+    // statements outside of it that go to its header.
+    struct Loop
+    {
+        int m_header;
+        int m_end;
+        vector<int> m_temporaries;
+        vector<int> m_entries;
+    };
+    
+    // Loops with hoisted subexpressions.
+    vector<Loop> m_loops;
+    
+    // A subexpression of compiled code, from the instruction at m_start to the one it ends at, in postfix order.
+    // It is pure if it only reads constants and proven variables through operations without side effects.
+    struct Subexpression
+    {
+        int m_start = 0;
+        bool m_pure = true;
+        bool m_hasOperation = false;
+        bool m_hasVariable = false;
+    };
+    
+    // Compiled statements indexed by statement number.
+    vector<CompiledStatement> m_compiled;
+    
+    // Rules of the peephole optimizer.
+    enum PeepholeRule
+    {
+        // A jump to a goto jumps to the target of the goto instead.
+        PEEPHOLE_JUMP_THREADING,
+        // A goto or an if ... goto to the next statement does nothing.
+        PEEPHOLE_JUMP_TO_NEXT,
+        // y = x; right after x = y; does nothing.
+        PEEPHOLE_REDUNDANT_COPY,
+        // x = x + c; and x = x - c; are increments.
+        PEEPHOLE_INCREMENT,
+        // x = x + e; and x = x - e; are atomic additions when x is shared.
+        PEEPHOLE_ATOMIC_ADD,
+        PEEPHOLE_RULE_COUNT
+    };
+    
+    // Names of the peephole rules, for --opt-stats.
+    static const char *const PEEPHOLE_RULE_NAMES[PEEPHOLE_RULE_COUNT];
+    
+    // Number of statements rewritten by each peephole rule, and whether they are reported when the program stops.
+    long m_peepholeHits[PEEPHOLE_RULE_COUNT] = {};
+    bool m_optimizationStats = false;
+    
+    // Whether statements are optimized and hot loops are traced. Cleared by --no-opt.
+    bool m_optimize = true;
+    
+    // Performance counters read while the interpreter runs, for --stats.
+    PerfCounters m_perfCounters;
+    bool m_stats = false;
+    
+    // Statement being executed, -1 before the first one. Read by the sampling profiler from its signal handler.
+    atomic<int> m_programCounter{-1};
+    
+    // Sampling profiler for --sample, the file its collapsed stacks are written to, empty if it is not used, its
+    // frequency, and the number of statements and labels it reports.
+    SamplingProfiler m_sampler;
+    string m_sampleFileName;
+    int m_sampleFrequency = SAMPLE_DEFAULT_FREQUENCY;
+    int m_sampleTop = SAMPLE_DEFAULT_TOP;
+    
+    // Whether the output of the program only depends on its input, the hash of the normalized program, and the
+    // recorder of its output when it is cached.
+    bool m_memoizable = false;
+    uint64_t m_normalizedHash = 0;
+    OutputRecorder *m_outputRecorder = NULL;
+    
+    // How print statements write numbers.
+    NumberFormat m_numberFormat = NumberFormat::Shortest;
+    
+    // Output written by a separate thread, for --async-output. Null if the output is written directly.
+    unique_ptr<AsyncOutput> m_asyncOutput;
+
+    // Statement that the return of a spawned region goes back to, which ends the region.
+    static constexpr int REGION_END = -1;
+    
+    // Shared variables are updated with atomic operations, without locks.
+    static_assert(atomic<double>::is_always_lock_free, "Shared variables need lock-free atomic doubles.");
+    
+    // State shared by an interpreter and the interpreters that run the regions that it spawns. Created when the
+    // program is loaded, if it has spawn or shared statements.
+    struct ParallelState
+    {
+        // The program that the interpreters of the regions are compiled from.
+        Statement m_program;
+        // Values of the shared variables, by name. A deque, so that their addresses stay valid as more are added.
+        deque< atomic<double> > m_sharedValues;
+        unordered_map<string, atomic<double> *> m_sharedVariables;
+        // Interpreters of regions that are not running one, with the program compiled.
+        mutex m_idleLock;
+        vector< unique_ptr<DuckInterpreter> > m_idleInterpreters;
+        // Held by print and read statements, so that the lines of the threads are not mixed up.
+        mutex m_outputLock;
+        // Threads that run the regions. Started by the first spawn statement.
+        unique_ptr<TaskPool> m_pool;
+    };
+    
+    // State shared with the regions, owned by the interpreter of the program. Null if the program does not use them.
+    unique_ptr<ParallelState> m_ownParallelState;
+    ParallelState *m_parallel = NULL;
+    
+    // Whether this interpreter runs spawned regions, and the regions that it spawned and did not join yet.
+    bool m_regionInterpreter = false;
+    TaskGroup m_spawnedRegions;
 
+    // Number of times a back-edge target has to be reached before we record a trace for it.
+    static const int TRACE_HOT_THRESHOLD = 50;
+    
+    // Longest trace that we record before giving up on a loop.
+    static const int TRACE_MAX_LENGTH = 512;
+    
+    // One recorded step of a trace. m_next is the statement that followed m_statement while recording,
+    // and acts as the guard when the trace is replayed.
+    struct TraceEntry
+    {
+        int m_statement;
+        StatementType m_type;
+        int m_next;
+    };
+    
+    // A recorded trace for a hot loop header. Blacklisted traces are never recorded again.
+    struct Trace
+    {
+        vector<TraceEntry> m_entries;
+        bool m_blacklisted = false;
+    };
+    
+    // Number of times each statement has been reached through a back-edge.
+    vector<int> m_backEdgeCount;
+    
+    // Traces keyed by the statement number of the loop header they start at.
+    unordered_map<int, Trace> m_traces;
+    
+    // Loop header of the trace currently being recorded. -1 if we are not recording.
+    int m_recordingAnchor = -1;
+    
+    // Steps of the trace currently being recorded.
+    vector<TraceEntry> m_recordBuffer;
+    
+    // Compiles and analyzes the recorded statements.
+    void LoadProgram()
+    {
+        // Statements are compiled lazily the first time they are reached. The ones that can be reached are compiled
+        // now by the analysis of the program.
+        m_compiled.assign(m_statements.GetStatementCount(), CompiledStatement());
+        DeclareSharedVariables();
+        ResolveSubroutineCalls();
+        AnalyzeProgram();
+    }
+    
+    // Runs statements from a_statement, until a return leaves the region that the interpreter runs.
+    void RunStatements(int a_statement);
+    
+    // Does the work that has to be done between statements. Returns the next statement to execute.
+    int AtSafePoint(int a_nextStatement);
+    
+    // Writes a snapshot of the interpreter state, to be executed from a_nextStatement.
+    void WriteCheckpoint(int a_nextStatement);
+    
+    // Gets a stamp of the modification time and size of the source file.
+    string GetSourceStamp();
+    
+    // Reloads the source, keeping the compiled statements of unchanged lines. Returns the next statement to execute.
+    // The program keeps running as it was if the source can not be loaded.
+    int ReloadStatements(int a_nextStatement);
+    
+    // Checks in a child process that a_source loads over the current program, without stopping the interpreter.
+    bool ProbeReload(const string &a_source, int a_nextStatement);
+    
+    // Swaps in the statements of a_source. Loading errors exit, so it is only called once ProbeReload succeeded.
+    int ApplyReload(const string &a_source, int a_nextStatement);
+    
+    // Method to get the compiled form of a statement, compiling it if this is the first time it is reached.
+    const CompiledStatement &GetCompiledStatement(int a_statementNum);
+    
+    // Method to compile a statement.
+    void CompileStatement(const string &a_statement, CompiledStatement &a_compiled);
+    
+    // Peephole optimizer. Rewrites a parsed statement using the statements around it and the ones it jumps to.
+    void OptimizeStatement(int a_statementNum, CompiledStatement &a_compiled);
+    
+    // Follows a chain of goto statements from a_target. Returns the statement at the end of the chain.
+    int ThreadJump(int a_target);
+    
+    // A read of a variable by a compiled statement, and where the address of the variable goes once it is proven.
+    // Reads of string variables have an m_stringAddress instead.
+    struct VariableRead
+    {
+        const string *m_name;
+        double **m_address;
+        DuckString **m_stringAddress = NULL;
+    };
+    
+    // Gets the variables read and then assigned by a compiled statement, in that order.
+    void GetVariableAccesses(CompiledStatement &a_statement, vector<VariableRead> &a_reads, vector<string> &a_writes);
+    
+    // Builds the control flow graph of the statements that can be reached from the entries of a_graph, compiling them.
+    void BuildFlowGraph(FlowGraph &a_graph);
+    
+    // Proves that the variables read by the statements that can be reached are assigned on every path before.
+    void CheckDefiniteAssignment(const FlowGraph &a_graph);
+    
+    // Analyzes and optimizes the program once it is loaded or reloaded, for execution from a_nextStatement.
+    void AnalyzeProgram(int a_nextStatement = 0);
+    
+    // Finds the subexpression that ends at each instruction of a_code. Returns false if the code has jumps.
+    bool FindSubexpressions(const vector<Instruction> &a_code, vector<Subexpression> &a_subexpressions);
+    
+    // Gets a key that is the same for identical subexpressions, and the variables they read.
+    string GetSubexpressionKey(const vector<Instruction> &a_code, int a_start, int a_end, vector<string> *a_variables);
+    
+    // Adds a temporary holding a subexpression of a_code. Returns its number.
+    int AddTemporary(const vector<Instruction> &a_code, int a_start, int a_end);
+    
+    // Replaces a subexpression of a_code with a load of a temporary.
+    void LoadTemporary(vector<Instruction> &a_code, int a_start, int a_end, int a_temporary);
+    
+    // Hoists the subexpressions that do not change within loops to temporaries computed when the loops are entered.
+    void HoistLoopInvariants(const FlowGraph &a_graph);
+    
+    // Shares identical subexpressions within basic blocks through temporaries.
+    void ShareCommonSubexpressions(const FlowGraph &a_graph);
+    
+    // Computes all the temporaries from the current variables. Used when execution does not start from the beginning.
+    void ComputeTemporaries();
+    
+    // Computes the temporaries of the loops that a_statement enters by going to a_nextStatement.
+    void EnterLoops(const CompiledStatement &a_statement, int a_nextStatement);
+    
+    // Formats compiled code in postfix order, for --dump-optimized.
+    string FormatCode(const vector<Instruction> &a_code);
+    
+    // Formats the terms of a string expression, for --dump-optimized.
+    string FormatStringCode(const vector<StringTerm> &a_terms);
+    
+    // Gets a statement parsed by CompileStatement, without optimizing it.
+    CompiledStatement &GetParsedStatement(int a_statementNum);
+    
+    // Reports the statistics that were asked for on the command line. Called when the program stops.
+    void ReportStatistics();
+    
+    // Method to split a statement into its elements. With a_literals, quoted strings are kept whole.
+    void SplitElements(const string &a_statement, vector<Element> &a_elements, bool a_literals = false);
+    
     // Method to execute statements.
-    int ExecuteStatement(string a_statement, int a_nextStatement);
+    int ExecuteStatement(const CompiledStatement &a_statement, int a_nextStatement);
+    
+    // Counts a back-edge to a_target and starts recording a trace once it is hot.
+    void NoteBackEdge(int a_target);
+    
+    // Records one executed statement into the trace being recorded.
+    void RecordTraceStep(int a_statement, StatementType a_type, int a_next);
+    
+    // Replays the trace recorded for a_anchor until one of its guards fails. Returns the next statement.
+    int RunTrace(const Trace &a_trace, int a_anchor);
     
     // Method to parse elements.
-    int ParseNextElement(const string &a_statement, int a_nextPos, string &a_stringValue, double &numValue);
+    int ParseNextElement(const vector<Element> &a_elements, int a_nextPos, string &a_stringValue, double &numValue);
     
     // Method to get statement type.
     StatementType GetStatementStype(const string &a_string);
     
-    // Checks if a_checkItem is inside quotes in string a_statement.
-    bool InsideQuotes(string a_checkItem, string a_statement);
+    // Evaluate an arithmetic statement.
+    void EvaluateArithmeticStatement(const CompiledStatement &a_statement);
     
-    // Checks if a_checkItem is in the comment section.
-    bool IsCommented(string a_checkItem, string a_string);
+    // Compile an arithmetic expression, starting at element a_nextPos, to postfix instructions.
+    void CompileExpression(const vector<Element> &a_elements, int a_nextPos, vector<Instruction> &a_code);
     
-    // Evaluate an arithmetic statement.
-    void EvaluateArithmeticStatement(const string &a_statement );
+    // Emits the instruction for a_operator while compiling an expression, folding it if its operands are constants.
+    void EmitOperation(const PendingOperator &a_operator, vector<Instruction> &a_code);
+    
+    // Gets the operation of an arithmetic or comparison operator. Returns false if a_operator is not one.
+    bool GetOperationCode(const string &a_operator, OpCode &a_op);
+    
+    // Evaluate a compiled arithmetic expression.  Return the value.
+    double EvaluateArithmenticExpression(const vector<Instruction> &a_code);
+    
+    // Checks if a name is the name of a string variable.
+    static bool IsStringName(const string &a_name)
+    {
+        return !a_name.empty() && a_name.back() == '$';
+    }
+    
+    // Compile a string expression, starting at element a_nextPos. Returns the position of the element after it.
+    int CompileStringExpression(const vector<Element> &a_elements, int a_nextPos, vector<StringTerm> &a_terms);
+    
+    // Evaluate a compiled string expression. Return the value.
+    DuckString EvaluateStringExpression(const vector<StringTerm> &a_terms);
+    
+    // Evaluate a string statement.
+    void EvaluateStringStatement(const CompiledStatement &a_statement);
+    
+    // Splits the index elements between the brackets that open at a_openPos. Returns the position after the brackets.
+    int SplitIndexElements(const vector<Element> &a_elements, int a_openPos, vector<Element> &a_indexElements);
+    
+    // Gets an array, terminating if it has not been declared.
+    vector<double> &GetDeclaredArray(const string &a_array);
+    
+    // Gets an element of an array, terminating if the index is out of bounds.
+    double &GetArrayElement(vector<double> &a_array, double a_index);
     
-    // Evaluate an arithmetic expression.  Return the value.
-    double EvaluateArithmenticExpression(const string &a_statement, int nextPos);
+    // Evaluates dim, fill, copy and sort statements.
+    void EvaluateArrayStatement(const CompiledStatement &a_statement);
     
     // Gets Operator Precedence of t_operator. Used by EvaluateArithmeticExpression.
     int GetOperatorPrecedence(const string a_operator);
     
     // Does operation on val1 and val2. Used by EvaluateArithmeticExpression.
-    double DoOperation(double a_val1, double a_val2, string a_operation);
-    
-    // Checks and counts for not(!) operators and returns if we need to perform the operation or not.
-    // Removes the unary operators once recorded.
-    bool CheckNotOperator(string &a_statement);
+    double DoOperation(double a_val1, double a_val2, OpCode a_operation);
     
     // Evaluates an if statement to determine if the goto should be executed.
-    int EvaluateIfStatement(string a_statement, int a_nextStatement);
+    int EvaluateIfStatement(const CompiledStatement &a_statement, int a_nextStatement);
     
     // Searches till the end of the statement for the label and returns it
     // And replaces the goto statement with ";"
     string EvaluateIfGotoExpression(string &a_statement);
 
     // Evaluates Quoted Prompts. Used by EvaluatePrintStatement and EvaluateReadStatement.
-    void EvaluateQuotedPrompt(string &a_statement, bool &quoted, int &nextPos, string &resultString, double &placeHolder);
+    void EvaluateQuotedPrompt(const vector<Element> &a_elements, bool &quoted, int &nextPos, string &resultString, double &placeHolder);
     
     // Evaluates Print statements.
-    void EvaluatePrintStatement(string a_statement);
+    void EvaluatePrintStatement(const CompiledStatement &a_statement);
     
     // Evaluates Read statements.
-    void EvaluateReadStatement(string a_statement);
+    void EvaluateReadStatement(const CompiledStatement &a_statement);
     
     // Evaluates Goto statement.
-    int EvaluateGotoStatement(const string &a_statement);
+    int EvaluateGotoStatement(const CompiledStatement &a_statement);
+    
+    // Evaluates gosub statements. Pushes the return statement and returns the statement of the label.
+    int EvaluateGosubStatement(const CompiledStatement &a_statement, int a_nextStatement);
+    
+    // Evaluates return statements. Pops and returns the statement to go back to.
+    int EvaluateReturnStatement();
+    
+    // Compiles the gosub statements when the program is loaded, so that their labels are resolved before it runs.
+    void ResolveSubroutineCalls();
+    
+    // Makes the variables of the shared statements shared, creating the state shared with the regions if the program
+    // spawns them.
+    void DeclareSharedVariables();
+    
+    // Gets the value of a shared variable. Returns NULL if the variable is not shared.
+    atomic<double> *GetSharedValue(const string &a_variable);
+    
+    // Evaluates spawn statements. Queues the region at the label, with a copy of the variables.
+    int EvaluateSpawnStatement(const CompiledStatement &a_statement, int a_nextStatement);
+    
+    // Waits for the regions spawned by this interpreter. Called by join statements and at the end of regions.
+    void JoinRegions();
+    
+    // Joins the regions before the program stops. Terminates if a region tries to stop the program.
+    void StopRegions(int a_nextStatement);
+    
+    // Runs a spawned region from statement a_label, with the variables saved in a_variables.
+    void RunRegion(int a_label, const string &a_variables);
+    
+    // Gets an interpreter to run a region, with the program of a_state compiled, and gives it back once it is done.
+    static unique_ptr<DuckInterpreter> AcquireRegionInterpreter(ParallelState *a_state);
+    static void ReleaseRegionInterpreter(ParallelState *a_state, unique_ptr<DuckInterpreter> a_interpreter);
     
 };
 
@@ -0,0 +1,192 @@
+/**
+ *  DuckString.cpp
+ *  Implementation of DuckString.hpp
+ */
+
+#include "PrefixHeader.pch"
+//#include "stdafx.h"
+#include "DuckString.hpp"
+
+/**
+ * DuckString::DuckString. Constructor for DuckString class.
+ * Copies a_text inline if it is short enough, or into a flat piece otherwise.
+ * @param a_text string_view The characters of the string.
+ */
+DuckString::DuckString(string_view a_text) : m_length(a_text.size())
+{
+    if(IsInline())
+        memcpy(m_inline, a_text.data(), m_length);
+    else
+    {
+        m_rope = new RopeNode;
+        m_rope->m_length = m_length;
+        m_rope->m_text.assign(a_text.data(), a_text.size());
+    }
+}
+
+/**
+ * DuckString::Concatenate. Method to concatenate two strings.
+ * Short results are stored inline, and results up to DUCK_STRING_FLAT_LIMIT characters are copied into a flat piece.
+ * Longer results share their operands in a new concatenation node. When a short string is appended to a rope that
+ * ends with a small flat piece, that piece is copied with the short string appended instead, so that a string built
+ * from many small appends has pieces of about DUCK_STRING_FLAT_LIMIT characters rather than one node per append.
+ * Either way, a concatenation copies at most DUCK_STRING_FLAT_LIMIT characters.
+ * @param a_left const DuckString The first string.
+ * @param a_right const DuckString The string appended to it.
+ * @return DuckString The concatenation.
+ */
+DuckString DuckString::Concatenate(const DuckString &a_left, const DuckString &a_right)
+{
+    if(a_right.m_length == 0)
+        return a_left;
+    if(a_left.m_length == 0)
+        return a_right;
+    
+    DuckString result;
+    size_t length = a_left.m_length + a_right.m_length;
+    if(length <= DUCK_STRING_INLINE_CAPACITY)
+    {
+        memcpy(result.m_inline, a_left.m_inline, a_left.m_length);
+        memcpy(result.m_inline + a_left.m_length, a_right.m_inline, a_right.m_length);
+        result.m_length = length;
+        return result;
+    }
+    
+    if(length <= DUCK_STRING_FLAT_LIMIT)
+        result.m_rope = MakeFlat(length, a_left, a_right);
+    else
+    {
+        // Extending the last piece of the left rope.
+        const RopeNode *left = a_left.IsInline() ? NULL : a_left.m_rope;
+        const RopeNode *last = left != NULL ? left->m_right : NULL;
+        if(last != NULL && last->m_left == NULL && last->m_length + a_right.m_length <= DUCK_STRING_FLAT_LIMIT)
+        {
+            RopeNode *piece = new RopeNode;
+            piece->m_length = last->m_length + a_right.m_length;
+            piece->m_text.reserve(piece->m_length);
+            piece->m_text = last->m_text;
+            a_right.AppendTo(piece->m_text);
+            left->m_left->m_references++;
+            result.m_rope = MakeConcatenation(left->m_left, piece);
+        }
+        else
+            result.m_rope = MakeConcatenation(a_left.GetRope(), a_right.GetRope());
+    }
+    result.m_length = length;
+    return result;
+}
+
+/**
+ * DuckString::Compare. Method to compare two strings.
+ * Compares the characters in order, like strcmp. Strings that share their rope are equal without reading it.
+ * @param a_other const DuckString The string to compare with.
+ * @return int Negative if this string comes first, 0 if they are equal, positive if a_other comes first.
+ */
+int DuckString::Compare(const DuckString &a_other) const
+{
+    if(IsInline() && a_other.IsInline())
+    {
+        int order = memcmp(m_inline, a_other.m_inline, min(m_length, a_other.m_length));
+        return order != 0 ? order : (m_length > a_other.m_length) - (m_length < a_other.m_length);
+    }
+    if(!IsInline() && m_length == a_other.m_length && m_rope == a_other.m_rope)
+        return 0;
+    
+    string text, otherText;
+    AppendTo(text);
+    a_other.AppendTo(otherText);
+    return text.compare(otherText);
+}
+
+/**
+ * DuckString::AppendTo. Method to get the characters of the string.
+ * @param a_buffer string Buffer that the characters are appended to.
+ */
+void DuckString::AppendTo(string &a_buffer) const
+{
+    a_buffer.reserve(a_buffer.size() + m_length);
+    ForEachPiece([&a_buffer](const char *a_text, size_t a_length) { a_buffer.append(a_text, a_length); });
+}
+
+/**
+ * DuckString::Write. Method to write the string.
+ * Writes the pieces of the string directly, without making a flat copy of it.
+ * @param a_out ostream Stream to write to.
+ */
+void DuckString::Write(ostream &a_out) const
+{
+    ForEachPiece([&a_out](const char *a_text, size_t a_length) { a_out.write(a_text, a_length); });
+}
+
+/**
+ * DuckString::GetRope. Method to get the string as a rope node.
+ * @return RopeNode* The rope of the string with a new reference, or a new flat piece if the string is inline.
+ */
+DuckString::RopeNode *DuckString::GetRope() const
+{
+    if(IsInline())
+        return MakeFlat(m_length, *this, DuckString());
+    
+    m_rope->m_references++;
+    return m_rope;
+}
+
+/**
+ * DuckString::MakeFlat. Method to make a flat piece.
+ * @param a_length size_t Number of characters of the piece, the sum of the lengths of a_left and a_right.
+ * @param a_left const DuckString The first characters of the piece.
+ * @param a_right const DuckString The characters after them.
+ * @return RopeNode* The new piece, with one reference.
+ */
+DuckString::RopeNode *DuckString::MakeFlat(size_t a_length, const DuckString &a_left, const DuckString &a_right)
+{
+    RopeNode *piece = new RopeNode;
+    piece->m_length = a_length;
+    piece->m_text.reserve(a_length);
+    a_left.AppendTo(piece->m_text);
+    a_right.AppendTo(piece->m_text);
+    return piece;
+}
+
+/**
+ * DuckString::MakeConcatenation. Method to make a concatenation node.
+ * @param a_left RopeNode* The first part. Its reference is taken over by the node.
+ * @param a_right RopeNode* The second part. Its reference is taken over by the node.
+ * @return RopeNode* The new node, with one reference.
+ */
+DuckString::RopeNode *DuckString::MakeConcatenation(RopeNode *a_left, RopeNode *a_right)
+{
+    RopeNode *node = new RopeNode;
+    node->m_length = a_left->m_length + a_right->m_length;
+    node->m_left = a_left;
+    node->m_right = a_right;
+    return node;
+}
+
+/**
+ * DuckString::Release. Method to drop a reference to a rope node.
+ * Deletes the node if it was the last reference, and the children that it held the last reference to. The nodes are
+ * deleted with a stack of their own rather than by recursion, since ropes built by appends are as deep as they are
+ * long.
+ * @param a_node RopeNode* The node.
+ */
+void DuckString::Release(RopeNode *a_node)
+{
+    if(--a_node->m_references != 0)
+        return;
+    
+    vector<RopeNode *> unused(1, a_node);
+    while(!unused.empty())
+    {
+        RopeNode *node = unused.back();
+        unused.pop_back();
+        if(node->m_left != NULL)
+        {
+            if(--node->m_left->m_references == 0)
+                unused.push_back(node->m_left);
+            if(--node->m_right->m_references == 0)
+                unused.push_back(node->m_right);
+        }
+        delete node;
+    }
+}
@@ -0,0 +1,145 @@
+/**
+ *  DuckString.hpp
+ *  DuckString Class header file.
+ *  Value of the string variables of the Duck language. Short strings are stored inline, without allocating. Longer
+ *  strings are ropes: immutable, reference counted trees of flat pieces, so that a concatenation shares its operands
+ *  instead of copying them, and building a long string one piece at a time does not copy it again at every step.
+ */
+
+#pragma once
+#include "PrefixHeader.pch"
+//#include "stdafx.h"
+
+// Longest string stored inline in a DuckString.
+static const size_t DUCK_STRING_INLINE_CAPACITY = 24;
+
+// Longest concatenation that is copied into a flat piece. Longer ones share their operands in a rope.
+static const size_t DUCK_STRING_FLAT_LIMIT = 256;
+
+class DuckString
+{
+public:
+    DuckString() : m_length(0) {}
+    
+    // Makes a string from a_text.
+    explicit DuckString(string_view a_text);
+    
+    DuckString(const DuckString &a_other) : m_length(a_other.m_length)
+    {
+        if(a_other.IsInline())
+            memcpy(m_inline, a_other.m_inline, m_length);
+        else
+        {
+            m_rope = a_other.m_rope;
+            m_rope->m_references++;
+        }
+    }
+    
+    DuckString(DuckString &&a_other) noexcept : m_length(a_other.m_length)
+    {
+        if(a_other.IsInline())
+            memcpy(m_inline, a_other.m_inline, m_length);
+        else
+        {
+            m_rope = a_other.m_rope;
+            a_other.m_length = 0;
+        }
+    }
+    
+    DuckString &operator=(DuckString a_other) noexcept
+    {
+        swap(m_length, a_other.m_length);
+        swap(m_inline, a_other.m_inline);
+        return *this;
+    }
+    
+    ~DuckString()
+    {
+        if(!IsInline())
+            Release(m_rope);
+    }
+    
+    // Accessor to get the number of characters of the string.
+    size_t GetLength() const
+    {
+        return m_length;
+    }
+    
+    // Accessor to check if the string is stored inline, without a rope.
+    bool IsInline() const
+    {
+        return m_length <= DUCK_STRING_INLINE_CAPACITY;
+    }
+    
+    // Concatenates two strings.
+    static DuckString Concatenate(const DuckString &a_left, const DuckString &a_right);
+    
+    // Compares the characters of two strings. Returns a negative number, 0 or a positive number, like strcmp.
+    int Compare(const DuckString &a_other) const;
+    
+    // Appends the characters of the string to a_buffer.
+    void AppendTo(string &a_buffer) const;
+    
+    // Writes the characters of the string to a_out, one flat piece at a time.
+    void Write(ostream &a_out) const;
+    
+private:
+    // A node of a rope. Flat pieces have their characters in m_text, concatenations have both children.
+    // Nodes are never changed once they are shared.
+    struct RopeNode
+    {
+        size_t m_references = 1;
+        size_t m_length = 0;
+        RopeNode *m_left = NULL;
+        RopeNode *m_right = NULL;
+        string m_text;
+    };
+    
+    // Number of characters of the string.
+    size_t m_length;
+    
+    // The characters of an inline string, or the rope of a longer one.
+    union
+    {
+        char m_inline[DUCK_STRING_INLINE_CAPACITY];
+        RopeNode *m_rope;
+    };
+    
+    // Gets a rope node for the string, making a flat piece of an inline string. The caller owns a reference.
+    RopeNode *GetRope() const;
+    
+    // Makes a flat piece of a_length characters, the characters of a_left followed by those of a_right.
+    static RopeNode *MakeFlat(size_t a_length, const DuckString &a_left, const DuckString &a_right);
+    
+    // Makes a concatenation of two nodes, taking over the references of the caller.
+    static RopeNode *MakeConcatenation(RopeNode *a_left, RopeNode *a_right);
+    
+    // Drops a reference to a node, deleting the nodes that are no longer used.
+    static void Release(RopeNode *a_node);
+    
+    // Calls a_function with each flat piece of the string, in order. Ropes can be deeper than the call stack allows,
+    // so they are walked with a stack of their own.
+    template<typename Function>
+    void ForEachPiece(Function a_function) const
+    {
+        if(IsInline())
+        {
+            a_function(m_inline, m_length);
+            return;
+        }
+    
+        vector<const RopeNode *> pending(1, m_rope);
+        while(!pending.empty())
+        {
+            const RopeNode *node = pending.back();
+            pending.pop_back();
+            if(node->m_left == NULL)
+                a_function(node->m_text.data(), node->m_text.size());
+            else
+            {
+                pending.push_back(node->m_right);
+                pending.push_back(node->m_left);
+            }
+        }
+    }
+};
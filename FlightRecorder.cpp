@@ -0,0 +1,121 @@
+/**
+ *  FlightRecorder.cpp
+ *  Implementation of FlightRecorder.hpp
+ */
+
+#include "FlightRecorder.hpp"
+#include "PrefixHeader.pch"
+//#include "stdafx.h"
+
+// The recorder that the signal and exit handlers dump.
+static FlightRecorder *s_installed = NULL;
+
+/**
+ * DumpOnSignal. Signal handler for SIGUSR1 and fatal signals.
+ * Dumps the installed recorder. Execution carries on after SIGUSR1. Fatal signals are raised again with their default
+ * action once the dump is written.
+ * @param a_signal int The signal.
+ */
+static void DumpOnSignal(int a_signal)
+{
+    if(s_installed != NULL)
+        s_installed->Dump(a_signal == SIGUSR1 ? 0 : 128 + a_signal);
+    
+    if(a_signal != SIGUSR1)
+    {
+        signal(a_signal, SIG_DFL);
+        raise(a_signal);
+    }
+}
+
+/**
+ * DumpOnExit. Exit handler.
+ * Dumps the installed recorder when the program exits with a non-zero status, i.e. on every error.
+ * @param a_status int The exit status.
+ * @param a_argument void* Unused.
+ */
+static void DumpOnExit(int a_status, void *a_argument)
+{
+    if(a_status != 0 && s_installed != NULL)
+        s_installed->Dump((uint32_t)a_status);
+}
+
+/**
+ * FlightRecorder::Install. Method to install the recorder.
+ * Makes this the recorder that is dumped to a_fileName on SIGUSR1, when the program exits with a non-zero status, and
+ * on SIGSEGV, SIGBUS, SIGFPE and SIGABRT.
+ * @param a_fileName const string The file to dump to.
+ * @param a_programHash uint64_t Hash of the program, written in the dump so the decoder can check the source.
+ */
+void FlightRecorder::Install(const string &a_fileName, uint64_t a_programHash)
+{
+    m_fileName = a_fileName;
+    m_programHash = a_programHash;
+    
+    if(s_installed == NULL)
+    {
+        on_exit(DumpOnExit, NULL);
+        signal(SIGUSR1, DumpOnSignal);
+        signal(SIGSEGV, DumpOnSignal);
+        signal(SIGBUS, DumpOnSignal);
+        signal(SIGFPE, DumpOnSignal);
+        signal(SIGABRT, DumpOnSignal);
+    }
+    s_installed = this;
+}
+
+/**
+ * FlightRecorder::Uninstall. Method to uninstall the recorder.
+ * If this is the installed recorder, it is no longer dumped, and the signals go back to their default action. The
+ * exit handler stays registered, but has nothing to dump.
+ */
+void FlightRecorder::Uninstall()
+{
+    if(s_installed != this)
+        return;
+    
+    s_installed = NULL;
+    signal(SIGUSR1, SIG_DFL);
+    signal(SIGSEGV, SIG_DFL);
+    signal(SIGBUS, SIG_DFL);
+    signal(SIGFPE, SIG_DFL);
+    signal(SIGABRT, SIG_DFL);
+}
+
+/**
+ * FlightRecorder::Dump. Method to dump the records.
+ * Writes the header and the records, oldest first, to the dump file. The file is written with open and write only, so
+ * that it can be dumped from a signal handler.
+ * @param a_reason uint32_t Why the dump is written. See FlightRecorderHeader::m_reason.
+ */
+void FlightRecorder::Dump(uint32_t a_reason)
+{
+    int fd = open(m_fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0)
+        return;
+    
+    uint64_t position = m_position;
+    uint64_t count = position < FLIGHT_RECORDER_SIZE ? position : FLIGHT_RECORDER_SIZE;
+    
+    FlightRecorderHeader header;
+    memcpy(header.m_magic, FLIGHT_RECORDER_MAGIC, sizeof(header.m_magic));
+    header.m_version = FLIGHT_RECORDER_VERSION;
+    header.m_reason = a_reason;
+    header.m_programHash = m_programHash;
+    header.m_totalRecords = position;
+    header.m_recordCount = count;
+    
+    ssize_t result = write(fd, &header, sizeof(header));
+    
+    // Before the ring wraps, the records start at 0. After, the oldest is the next one to be overwritten.
+    if(count < FLIGHT_RECORDER_SIZE)
+        result = write(fd, m_records, count * sizeof(FlightRecord));
+    else
+    {
+        size_t oldest = (size_t)(position & (FLIGHT_RECORDER_SIZE - 1));
+        result = write(fd, m_records + oldest, (FLIGHT_RECORDER_SIZE - oldest) * sizeof(FlightRecord));
+        result = write(fd, m_records, oldest * sizeof(FlightRecord));
+    }
+    (void)result;
+    close(fd);
+}
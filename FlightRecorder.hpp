@@ -0,0 +1,104 @@
+/**
+ *  FlightRecorder.hpp
+ *  Always-on trace of the statements executed by the interpreter.
+ *  The last FLIGHT_RECORDER_SIZE statements are kept in a ring buffer, and dumped to a binary file on an abnormal exit
+ *  or on SIGUSR1. The dump is read back by ducktrace (TraceDecoder.cpp).
+ *  Reading the cycle counter costs about as much as a simple statement, so it is only read for one record in
+ *  FLIGHT_RECORDER_CYCLE_INTERVAL. That keeps the cost of recording to a couple of stores per statement.
+ */
+
+#pragma once
+#include "PrefixHeader.pch"
+//#include "stdafx.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Identifies flight recorder dumps, and the version of their format.
+// A dump is a FlightRecorderHeader followed by m_recordCount FlightRecords, oldest first.
+#define FLIGHT_RECORDER_MAGIC "DUCKFLTR"
+static const uint32_t FLIGHT_RECORDER_VERSION = 1;
+
+// Number of records in the ring buffer. Must be a power of two.
+static const size_t FLIGHT_RECORDER_SIZE = 8192;
+
+// One record in this many has the cycle counter. Must be a power of two.
+static const size_t FLIGHT_RECORDER_CYCLE_INTERVAL = 64;
+
+// A statement that was executed, and the cycle counter when it started. m_cycles is 0 for records without it.
+// m_reserved is always 0, so that dumps do not carry uninitialized memory.
+struct FlightRecord
+{
+    uint32_t m_statement;
+    uint32_t m_reserved;
+    uint64_t m_cycles;
+};
+
+// Header of a dump.
+struct FlightRecorderHeader
+{
+    char m_magic[8];
+    uint32_t m_version;
+    // Why the dump was written: 0 for SIGUSR1, the exit status for exits, or the number of a fatal signal + 128.
+    uint32_t m_reason;
+    // Hash of the program, from Statement::GetProgramHash.
+    uint64_t m_programHash;
+    // Number of statements recorded since the program started, and the number of records in the dump.
+    uint64_t m_totalRecords;
+    uint64_t m_recordCount;
+};
+
+// Reads the cycle counter. Falls back to a nanosecond clock where there is no cycle counter.
+inline uint64_t ReadCycleCounter()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+#endif
+}
+
+class FlightRecorder
+{
+public:
+    FlightRecorder() {}
+    
+    // Records the start of a statement. Called by the dispatch loop of the interpreter.
+    void Record(int a_statement)
+    {
+        FlightRecord &record = m_records[m_position & (FLIGHT_RECORDER_SIZE - 1)];
+        record.m_statement = (uint32_t)a_statement;
+        record.m_reserved = 0;
+        record.m_cycles = (m_position & (FLIGHT_RECORDER_CYCLE_INTERVAL - 1)) == 0 ? ReadCycleCounter() : 0;
+        m_position++;
+    }
+    
+    // Accessor to get the number of statements recorded since the program started.
+    uint64_t GetRecordCount() const
+    {
+        return m_position;
+    }
+    
+    // Makes this the recorder that is dumped to a_fileName on SIGUSR1, on exits with a non-zero status, and on
+    // fatal signals.
+    void Install(const string &a_fileName, uint64_t a_programHash);
+    
+    // Stops dumping this recorder. Used in forked children, which would dump the records of the parent to its file.
+    void Uninstall();
+    
+    // Writes the records to the dump file. Only uses async-signal-safe calls.
+    void Dump(uint32_t a_reason);
+    
+private:
+    // The records, written round robin. Aligned so that records never straddle cache lines.
+    alignas(64) FlightRecord m_records[FLIGHT_RECORDER_SIZE];
+    
+    // Number of records written since the program started.
+    uint64_t m_position = 0;
+    
+    // Dump file and hash of the recorded program.
+    string m_fileName;
+    uint64_t m_programHash = 0;
+};
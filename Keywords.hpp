@@ -0,0 +1,177 @@
+/**
+ *  Keywords.hpp
+ *  Character classes and keywords of the Duck language.
+ *  Used by Statement to format and record statements, and by DuckInterpreter to classify them.
+ */
+
+#pragma once
+#include "PrefixHeader.pch"
+//#include "stdafx.h"
+
+// Character classes. A character is in exactly one class.
+enum CharacterClass : unsigned char
+{
+    // Letters, digits, underscores, and the $ that ends the names of string variables.
+    CHAR_IDENTIFIER = 1,
+    // Spaces.
+    CHAR_SPACE = 2,
+    // Statement terminators.
+    CHAR_TERMINATOR = 4,
+    // Everything else: operators, quotes, tabs... Statement::StandardSpaceFormat checks spaces around them.
+    CHAR_OPERATOR = 8,
+};
+
+// Table of the class of each character.
+struct CharacterClassTable
+{
+    unsigned char m_classes[256];
+    
+    constexpr CharacterClassTable() : m_classes()
+    {
+        for(int c = 0; c < 256; c++)
+        {
+            if((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '$')
+                m_classes[c] = CHAR_IDENTIFIER;
+            else if(c == ' ')
+                m_classes[c] = CHAR_SPACE;
+            else if(c == ';')
+                m_classes[c] = CHAR_TERMINATOR;
+            else
+                m_classes[c] = CHAR_OPERATOR;
+        }
+    }
+};
+
+inline constexpr CharacterClassTable CHARACTER_CLASSES;
+
+// Gets the class of a_char.
+inline constexpr unsigned char GetCharacterClass(char a_char)
+{
+    return CHARACTER_CLASSES.m_classes[(unsigned char)a_char];
+}
+
+// Keywords that start a statement.
+enum class Keyword
+{
+    None,
+    If,
+    Read,
+    Print,
+    Stop,
+    End,
+    Goto,
+    Dim,
+    Fill,
+    Copy,
+    Sort,
+    Gosub,
+    Return,
+    Spawn,
+    Join,
+    Shared,
+};
+
+// An entry of the keyword table.
+struct KeywordEntry
+{
+    const char *m_word = nullptr;
+    Keyword m_keyword = Keyword::None;
+};
+
+// Keywords of the language.
+inline constexpr KeywordEntry KEYWORDS[] =
+{
+    {"if", Keyword::If},
+    {"read", Keyword::Read},
+    {"print", Keyword::Print},
+    {"stop", Keyword::Stop},
+    {"end", Keyword::End},
+    {"goto", Keyword::Goto},
+    {"dim", Keyword::Dim},
+    {"fill", Keyword::Fill},
+    {"copy", Keyword::Copy},
+    {"sort", Keyword::Sort},
+    {"gosub", Keyword::Gosub},
+    {"return", Keyword::Return},
+    {"spawn", Keyword::Spawn},
+    {"join", Keyword::Join},
+    {"shared", Keyword::Shared},
+};
+
+// Size of the keyword hash table. Must be a power of two.
+inline constexpr size_t KEYWORD_TABLE_SIZE = 32;
+
+// Perfect hash of the keywords, from their length and first and last characters.
+inline constexpr size_t KeywordHash(const char *a_word, size_t a_length)
+{
+    return (a_length * 9 + (unsigned char)a_word[0] * 5 + (unsigned char)a_word[a_length-1]) & (KEYWORD_TABLE_SIZE - 1);
+}
+
+// Length of a null terminated keyword.
+inline constexpr size_t KeywordLength(const char *a_word)
+{
+    size_t length = 0;
+    while(a_word[length] != '\0')
+        length++;
+    return length;
+}
+
+// Hash table of the keywords. Slots without a keyword have a null m_word.
+struct KeywordTable
+{
+    KeywordEntry m_slots[KEYWORD_TABLE_SIZE];
+    bool m_perfect;
+    
+    constexpr KeywordTable() : m_slots(), m_perfect(true)
+    {
+        for(const KeywordEntry &entry : KEYWORDS)
+        {
+            size_t slot = KeywordHash(entry.m_word, KeywordLength(entry.m_word));
+            if(m_slots[slot].m_word != nullptr)
+                m_perfect = false;
+            m_slots[slot] = entry;
+        }
+    }
+};
+
+inline constexpr KeywordTable KEYWORD_TABLE;
+static_assert(KEYWORD_TABLE.m_perfect, "KeywordHash has collisions. Change its constants or KEYWORD_TABLE_SIZE.");
+
+/**
+ * GetKeyword. Method to get the keyword that starts a statement.
+ * Finds the first word of a_statement, made of identifier characters after any leading spaces, and looks it up in the
+ * keyword hash table. Only the first word is read, so keywords inside names, quotes or comments are never matched.
+ * A keyword that is assigned to, like stop = 1; or end[0] = 1;, is the name of a variable or an array, as sum is.
+ * @param a_statement string_view The statement.
+ * @return Keyword The keyword that starts the statement. Keyword::None if it does not start with a keyword.
+ */
+inline Keyword GetKeyword(string_view a_statement)
+{
+    // Skipping leading white space.
+    size_t start = 0;
+    while(start < a_statement.size() && (a_statement[start] == ' ' || a_statement[start] == '\t'))
+        start++;
+    
+    size_t end = start;
+    while(end < a_statement.size() && GetCharacterClass(a_statement[end]) == CHAR_IDENTIFIER)
+        end++;
+    
+    if(end == start)
+        return Keyword::None;
+    
+    const KeywordEntry &entry = KEYWORD_TABLE.m_slots[KeywordHash(a_statement.data() + start, end - start)];
+    if(entry.m_word == nullptr || a_statement.compare(start, end - start, entry.m_word) != 0)
+        return Keyword::None;
+    
+    // Checking for an assignment, an indexed element or a unary operation, which no keyword can be followed by.
+    size_t next = a_statement.find_first_not_of(" \t", end);
+    if(next != string_view::npos)
+    {
+        string_view rest = a_statement.substr(next);
+        if((rest[0] == '=' && rest.compare(0, 2, "==") != 0) || rest[0] == '['
+           || rest.compare(0, 2, "++") == 0 || rest.compare(0, 2, "--") == 0)
+            return Keyword::None;
+    }
+    
+    return entry.m_keyword;
+}
@@ -0,0 +1,517 @@
+/**
+ *  MicroBenchmark.cpp
+ *  Main for duckbench, the microbenchmarks of the building blocks of the interpreter.
+ *  Times statement formatting, element parsing, statement classification, expression evaluation, variable and label
+ *  lookups, string concatenation and number formatting in isolation, on synthetic inputs of growing size: statement
+ *  length, expression length, number of variables, number of labels, number of appends and digits per number. Each
+ *  benchmark reports the time and the number of heap allocations per operation, so that costs that do not grow
+ *  linearly with the input show up when the sizes are compared.
+ */
+
+#include "PrefixHeader.pch"
+//#include "stdafx.h"
+#include "DuckInterpreter.hpp"
+#include <chrono>
+#include <new>
+
+// Number of heap allocations made by the program. Counted by the replacements of operator new below.
+static uint64_t s_allocationCount = 0;
+
+void *operator new(size_t a_size)
+{
+    s_allocationCount++;
+    void *memory = malloc(a_size == 0 ? 1 : a_size);
+    if(memory == NULL)
+        throw bad_alloc();
+    return memory;
+}
+
+void *operator new[](size_t a_size)
+{
+    return operator new(a_size);
+}
+
+void operator delete(void *a_memory) noexcept
+{
+    free(a_memory);
+}
+
+void operator delete[](void *a_memory) noexcept
+{
+    free(a_memory);
+}
+
+void operator delete(void *a_memory, size_t) noexcept
+{
+    free(a_memory);
+}
+
+void operator delete[](void *a_memory, size_t) noexcept
+{
+    free(a_memory);
+}
+
+// Sizes of the synthetic inputs: characters per statement, terms per expression, variables and labels.
+static const int LINE_LENGTHS[] = {16, 64, 256, 1024, 4096};
+static const int EXPRESSION_LENGTHS[] = {4, 16, 64, 256};
+static const int VARIABLE_COUNTS[] = {10, 100, 1000, 10000, 100000};
+static const int LABEL_COUNTS[] = {10, 100, 1000, 10000, 100000};
+static const int APPEND_COUNTS[] = {10, 100, 1000, 10000, 100000};
+static const int NUMBER_DIGITS[] = {1, 6, 12, 17};
+
+// Number of distinct lookups cycled through by the lookup benchmarks, so that they do not always hit the same entry.
+static const int LOOKUP_KEYS = 1024;
+
+// Results are added to this, so that the compiler can not drop the work that is timed.
+static volatile double s_sink = 0;
+
+class MicroBenchmark
+{
+public:
+    MicroBenchmark(const string &a_filter, double a_minimumTime) : m_filter(a_filter), m_minimumTime(a_minimumTime) {}
+    
+    // Runs the benchmarks whose name contains the filter.
+    void RunAll();
+    
+private:
+    // Names of the benchmarks to run, and the least time that each one is run for, in seconds.
+    string m_filter;
+    double m_minimumTime;
+    
+    // Times a_operation, which does a_batch operations per call, and prints its cost per operation.
+    // The number of calls is doubled until they take m_minimumTime.
+    template<typename Operation>
+    void Measure(const string &a_name, int a_size, int a_batch, Operation a_operation);
+    
+    void BenchmarkStandardSpaceFormat();
+    void BenchmarkParseNextElement();
+    void BenchmarkGetStatementStype();
+    void BenchmarkEvaluateArithmenticExpression();
+    void BenchmarkSymbolTable();
+    void BenchmarkGetLabelLocation();
+    void BenchmarkDuckString();
+    void BenchmarkFormatNumber();
+    
+    // Makes a statement of about a_length characters, without spaces around its operators.
+    static string MakeStatement(int a_length);
+    
+    // Makes an expression of a_terms variables x0, x1... with spaces around its operators, ended by a semicolon.
+    static string MakeExpression(int a_terms);
+    
+    // Whether a benchmark is run.
+    bool IsSelected(const string &a_name) const
+    {
+        return a_name.find(m_filter) != string::npos;
+    }
+};
+
+/**
+ * MicroBenchmark::Measure. Method to time an operation.
+ * Runs a_operation once to warm up, then doubles the number of calls until they take m_minimumTime, and prints the
+ * time and the heap allocations per operation of the last round.
+ * @param a_name const string Name of the benchmark.
+ * @param a_size int Size of its input.
+ * @param a_batch int Number of operations done by one call of a_operation.
+ * @param a_operation Operation The operation.
+ */
+template<typename Operation>
+void MicroBenchmark::Measure(const string &a_name, int a_size, int a_batch, Operation a_operation)
+{
+    a_operation();
+    
+    for(long calls = 1; ; calls *= 2)
+    {
+        uint64_t allocations = s_allocationCount;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for(long call = 0; call < calls; call++)
+            a_operation();
+        double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        allocations = s_allocationCount - allocations;
+    
+        if(elapsed >= m_minimumTime)
+        {
+            double operations = (double)calls * a_batch;
+            cout << left << setw(40) << a_name << right << setw(10) << a_size << fixed << setprecision(1)
+                 << setw(14) << elapsed * 1e9 / operations << setprecision(2) << setw(14) << allocations / operations
+                 << endl;
+            return;
+        }
+    }
+}
+
+/**
+ * MicroBenchmark::RunAll. Method to run the benchmarks.
+ */
+void MicroBenchmark::RunAll()
+{
+    cout << left << setw(40) << "benchmark" << right << setw(10) << "size" << setw(14) << "ns/op" << setw(14)
+         << "allocs/op" << endl;
+    
+    BenchmarkStandardSpaceFormat();
+    BenchmarkParseNextElement();
+    BenchmarkGetStatementStype();
+    BenchmarkEvaluateArithmenticExpression();
+    BenchmarkSymbolTable();
+    BenchmarkGetLabelLocation();
+    BenchmarkDuckString();
+    BenchmarkFormatNumber();
+}
+
+/**
+ * MicroBenchmark::MakeStatement. Method to make a statement for the statement benchmarks.
+ * The statement is an assignment of a sum of products, without spaces, as they are usually written.
+ * @param a_length int Approximate number of characters.
+ * @return string The statement, e.g. "x=a0*3+a1*3;".
+ */
+string MicroBenchmark::MakeStatement(int a_length)
+{
+    string statement = "x=a0*3";
+    for(int term = 1; (int)statement.size() < a_length - 1; term++)
+        statement += "+a" + to_string(term) + "*3";
+    return statement + ";";
+}
+
+/**
+ * MicroBenchmark::MakeExpression. Method to make an expression for the evaluation benchmark.
+ * The operators alternate between +, - and *, so that constant folding can not remove them.
+ * @param a_terms int Number of variables in the expression.
+ * @return string The expression, e.g. "x0 + x1 - x2 ;".
+ */
+string MicroBenchmark::MakeExpression(int a_terms)
+{
+    static const char *const OPERATORS[] = {" + ", " - ", " * "};
+    
+    string expression = "x0";
+    for(int term = 1; term < a_terms; term++)
+        expression += OPERATORS[term % 3] + ("x" + to_string(term));
+    return expression + " ;";
+}
+
+/**
+ * MicroBenchmark::BenchmarkStandardSpaceFormat. Benchmark of Statement::StandardSpaceFormat.
+ * One operation formats one statement. The statement is copied into a string that already has the room for it, so
+ * the copy does not allocate.
+ */
+void MicroBenchmark::BenchmarkStandardSpaceFormat()
+{
+    if(!IsSelected("StandardSpaceFormat"))
+        return;
+    
+    for(int length : LINE_LENGTHS)
+    {
+        string statement = MakeStatement(length);
+        string formatted;
+        formatted.reserve(statement.size() * 4);
+        Measure("StandardSpaceFormat", length, 1, [&]()
+        {
+            formatted.assign(statement);
+            Statement::StandardSpaceFormat(formatted);
+            s_sink = s_sink + formatted.size();
+        });
+    }
+}
+
+/**
+ * MicroBenchmark::BenchmarkParseNextElement. Benchmarks of DuckInterpreter::SplitElements and ParseNextElement.
+ * SplitElements tokenizes a formatted statement once, when it is compiled. ParseNextElement is then called for each
+ * element. One operation splits, or parses all the elements of, one statement.
+ */
+void MicroBenchmark::BenchmarkParseNextElement()
+{
+    DuckInterpreter interpreter;
+    for(int length : LINE_LENGTHS)
+    {
+        string statement = MakeStatement(length);
+        Statement::StandardSpaceFormat(statement);
+        vector<DuckInterpreter::Element> elements;
+    
+        if(IsSelected("SplitElements"))
+        {
+            Measure("SplitElements", length, 1, [&]()
+            {
+                interpreter.SplitElements(statement, elements);
+                s_sink = s_sink + elements.size();
+            });
+        }
+    
+        interpreter.SplitElements(statement, elements);
+        if(IsSelected("ParseNextElement"))
+        {
+            string stringValue;
+            double numValue;
+            Measure("ParseNextElement", length, 1, [&]()
+            {
+                int position = 0;
+                while(position != INT_MAX && position <= (int)elements.size())
+                    position = interpreter.ParseNextElement(elements, position, stringValue, numValue);
+                s_sink = s_sink + numValue;
+            });
+        }
+    }
+}
+
+/**
+ * MicroBenchmark::BenchmarkGetStatementStype. Benchmark of DuckInterpreter::GetStatementStype.
+ * One operation classifies one statement. The statements cycle through every kind, with arithmetic statements of
+ * the given length, so a lookup that scans the whole statement grows with it.
+ */
+void MicroBenchmark::BenchmarkGetStatementStype()
+{
+    if(!IsSelected("GetStatementStype"))
+        return;
+    
+    DuckInterpreter interpreter;
+    for(int length : LINE_LENGTHS)
+    {
+        vector<string> statements = {MakeStatement(length), "if ( x > 3 ) goto top ;", "print \"x \" , x ;",
+                                     "read x ;", "goto top ;", "gosub sub ;", "return ;", "// comment", "stop ;"};
+        for(string &statement : statements)
+            Statement::StandardSpaceFormat(statement);
+    
+        Measure("GetStatementStype", length, (int)statements.size(), [&]()
+        {
+            int types = 0;
+            for(const string &statement : statements)
+                types += (int)interpreter.GetStatementStype(statement);
+            s_sink = s_sink + types;
+        });
+    }
+}
+
+/**
+ * MicroBenchmark::BenchmarkEvaluateArithmenticExpression. Benchmark of DuckInterpreter::EvaluateArithmenticExpression.
+ * One operation evaluates one compiled expression. The expression is evaluated as it is compiled, with its variables
+ * looked up by name, and with their addresses bound, as they are once CheckDefiniteAssignment proved them assigned.
+ */
+void MicroBenchmark::BenchmarkEvaluateArithmenticExpression()
+{
+    if(!IsSelected("EvaluateArithmenticExpression"))
+        return;
+    
+    for(int terms : EXPRESSION_LENGTHS)
+    {
+        DuckInterpreter interpreter;
+        for(int term = 0; term < terms; term++)
+            interpreter.m_symbolTable.RecordVariableValue("x" + to_string(term), term + 1);
+    
+        vector<DuckInterpreter::Element> elements;
+        vector<DuckInterpreter::Instruction> code;
+        interpreter.SplitElements(MakeExpression(terms), elements);
+        interpreter.CompileExpression(elements, 0, code);
+    
+        Measure("EvaluateArithmenticExpression", terms, 1, [&]()
+        {
+            interpreter.m_numberStack.clear();
+            s_sink = s_sink + interpreter.EvaluateArithmenticExpression(code);
+        });
+    
+        for(DuckInterpreter::Instruction &instruction : code)
+        {
+            if(instruction.m_op == DuckInterpreter::OpCode::LoadVariable)
+                instruction.m_variable = interpreter.m_symbolTable.GetVariableAddress(instruction.m_name);
+        }
+        Measure("EvaluateArithmenticExpression/bound", terms, 1, [&]()
+        {
+            interpreter.m_numberStack.clear();
+            s_sink = s_sink + interpreter.EvaluateArithmenticExpression(code);
+        });
+    }
+}
+
+/**
+ * MicroBenchmark::BenchmarkSymbolTable. Benchmarks of SymbolTable::GetVariableValue and RecordVariableValue.
+ * One operation reads, or assigns, one variable of a table with the given number of variables. The operations cycle
+ * through LOOKUP_KEYS of the variables.
+ */
+void MicroBenchmark::BenchmarkSymbolTable()
+{
+    for(int count : VARIABLE_COUNTS)
+    {
+        SymbolTable table;
+        vector<string> names;
+        for(int variable = 0; variable < count; variable++)
+            table.RecordVariableValue("variable" + to_string(variable), variable);
+        for(int key = 0; key < LOOKUP_KEYS; key++)
+            names.push_back("variable" + to_string((key * 7919) % count));
+    
+        if(IsSelected("SymbolTable::GetVariableValue"))
+        {
+            Measure("SymbolTable::GetVariableValue", count, LOOKUP_KEYS, [&]()
+            {
+                double sum = 0, value;
+                for(const string &name : names)
+                {
+                    table.GetVariableValue(name, value);
+                    sum += value;
+                }
+                s_sink = s_sink + sum;
+            });
+        }
+        if(IsSelected("SymbolTable::RecordVariableValue"))
+        {
+            Measure("SymbolTable::RecordVariableValue", count, LOOKUP_KEYS, [&]()
+            {
+                for(const string &name : names)
+                    table.RecordVariableValue(name, 1);
+            });
+        }
+    }
+}
+
+/**
+ * MicroBenchmark::BenchmarkGetLabelLocation. Benchmark of Statement::GetLabelLocation.
+ * Records a program with the given number of labels from a temporary file. One operation looks up one label. The
+ * lookups cycle through LOOKUP_KEYS of the labels.
+ */
+void MicroBenchmark::BenchmarkGetLabelLocation()
+{
+    if(!IsSelected("GetLabelLocation"))
+        return;
+    
+    for(int count : LABEL_COUNTS)
+    {
+        char fileName[] = "/tmp/duckbench-XXXXXX";
+        int file = mkstemp(fileName);
+        if(file == -1)
+        {
+            cerr << "Could not create a temporary file: " << strerror(errno) << endl;
+            exit(1);
+        }
+        close(file);
+        {
+            ofstream program(fileName);
+            for(int label = 0; label < count; label++)
+                program << "label" << label << ": x = " << label << ";\n";
+            program << "end;\n";
+        }
+    
+        Statement statements;
+        statements.RecordStatements(fileName);
+        unlink(fileName);
+    
+        vector<string> labels;
+        for(int key = 0; key < LOOKUP_KEYS; key++)
+            labels.push_back("label" + to_string((key * 7919) % count));
+    
+        Measure("GetLabelLocation", count, LOOKUP_KEYS, [&]()
+        {
+            int sum = 0;
+            for(const string &label : labels)
+                sum += statements.GetLabelLocation(label);
+            s_sink = s_sink + sum;
+        });
+    }
+}
+
+/**
+ * MicroBenchmark::BenchmarkDuckString. Benchmarks of DuckString::Concatenate and Compare.
+ * One operation appends a short piece to a string built from the given number of appends, as a loop building its
+ * output does. The cost of an append stays the same as the string grows, since the rope does not copy it. Comparing
+ * compares two long strings built the same way, and is reported per character.
+ */
+void MicroBenchmark::BenchmarkDuckString()
+{
+    DuckString piece(string_view("0123456789"));
+    for(int count : APPEND_COUNTS)
+    {
+        if(IsSelected("DuckString::Concatenate"))
+        {
+            Measure("DuckString::Concatenate", count, count, [&]()
+            {
+                DuckString text;
+                for(int append = 0; append < count; append++)
+                    text = DuckString::Concatenate(text, piece);
+                s_sink = s_sink + text.GetLength();
+            });
+        }
+        if(IsSelected("DuckString::Compare"))
+        {
+            DuckString text, other;
+            for(int append = 0; append < count; append++)
+            {
+                text = DuckString::Concatenate(text, piece);
+                other = DuckString::Concatenate(other, piece);
+            }
+            Measure("DuckString::Compare", count, (int)text.GetLength(), [&]()
+            {
+                s_sink = s_sink + text.Compare(other);
+            });
+        }
+    }
+}
+
+/**
+ * MicroBenchmark::BenchmarkFormatNumber. Benchmarks of the formatting of printed numbers.
+ * One operation writes one number to a string stream, with operator<<, as print statements used to, and with
+ * FormatNumber in both formats, writing to the buffer of the stream as print statements do. The numbers have the
+ * given number of significant digits, and the stream is rewound after each batch, so that only the formatting and
+ * the copy into the buffer are timed.
+ * @see FormatNumber
+ */
+void MicroBenchmark::BenchmarkFormatNumber()
+{
+    for(int digits : NUMBER_DIGITS)
+    {
+        vector<double> values;
+        for(int key = 0; key < LOOKUP_KEYS; key++)
+        {
+            double mantissa = 1 + (double)((key * 7919) % 1000) / 1000;
+            values.push_back(round(mantissa * pow(10, digits - 1)) * pow(10, key % 7 - 3));
+        }
+    
+        ostringstream out;
+        if(IsSelected("operator<<"))
+        {
+            Measure("operator<<", digits, LOOKUP_KEYS, [&]()
+            {
+                out.seekp(0);
+                for(double value : values)
+                    out << value;
+            });
+        }
+        if(IsSelected("FormatNumber::Shortest"))
+        {
+            Measure("FormatNumber::Shortest", digits, LOOKUP_KEYS, [&]()
+            {
+                out.seekp(0);
+                char text[NUMBER_TEXT_CAPACITY];
+                for(double value : values)
+                    out.rdbuf()->sputn(text, FormatNumber(text, value, NumberFormat::Shortest) - text);
+            });
+        }
+        if(IsSelected("FormatNumber::SixDigits"))
+        {
+            Measure("FormatNumber::SixDigits", digits, LOOKUP_KEYS, [&]()
+            {
+                out.seekp(0);
+                char text[NUMBER_TEXT_CAPACITY];
+                for(double value : values)
+                    out.rdbuf()->sputn(text, FormatNumber(text, value, NumberFormat::SixDigits) - text);
+            });
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    // Checking for correct arguments
+    string filter;
+    double minimumTime = 0.1;
+    for(int i = 1; i < argc; i++)
+    {
+        string argument = argv[i];
+        if(argument == "--min-time" && i+1 < argc)
+            minimumTime = atof(argv[++i]) / 1000;
+        else if(filter.empty() && argument.compare(0, 2, "--") != 0)
+            filter = argument;
+        else
+        {
+            cerr<<"Usage: duckbench [--min-time <milliseconds>] [<benchmark name filter>]"<<endl;
+            return 1;
+        }
+    }
+    
+    MicroBenchmark benchmark(filter, minimumTime);
+    benchmark.RunAll();
+    return 0;
+}
@@ -0,0 +1,35 @@
+/**
+ *  NumberFormat.cpp
+ *  Implementation of NumberFormat.hpp
+ */
+
+#include "NumberFormat.hpp"
+#include "PrefixHeader.pch"
+//#include "stdafx.h"
+
+// Integers below this are held exactly by doubles.
+static const double NUMBER_EXACT_INTEGERS = 9007199254740992.0;
+
+/**
+ * FormatNumber. Method to write a number as text.
+ * The shortest format is the one std::to_chars picks without a precision, which is exact: reading the text back
+ * gives the same number. Integers that doubles hold exactly are written in full, so that 300000 is not 3e+05. The
+ * 6 digit format is std::to_chars in general notation with a precision of 6, which writes the same text as
+ * printf("%g") and as iostreams with their default settings.
+ * @param a_buffer char* Buffer of NUMBER_TEXT_CAPACITY characters that receives the text.
+ * @param a_value double The number.
+ * @param a_format NumberFormat The format.
+ * @return char* End of the text.
+ */
+char *FormatNumber(char *a_buffer, double a_value, NumberFormat a_format)
+{
+    to_chars_result result;
+    if(a_format == NumberFormat::Shortest && fabs(a_value) < NUMBER_EXACT_INTEGERS && a_value == trunc(a_value))
+        result = to_chars(a_buffer, a_buffer + NUMBER_TEXT_CAPACITY, a_value, chars_format::fixed);
+    else if(a_format == NumberFormat::Shortest)
+        result = to_chars(a_buffer, a_buffer + NUMBER_TEXT_CAPACITY, a_value);
+    else
+        result = to_chars(a_buffer, a_buffer + NUMBER_TEXT_CAPACITY, a_value, chars_format::general, 6);
+    assert(result.ec == errc());
+    return result.ptr;
+}
@@ -0,0 +1,27 @@
+/**
+ *  NumberFormat.hpp
+ *  Formatting of the numbers printed by Duck programs.
+ *  Numbers are written with std::to_chars straight into a character buffer, without the locale and the stream state
+ *  that iostreams go through for every number. Used by DuckInterpreter for print statements.
+ */
+
+#pragma once
+#include "PrefixHeader.pch"
+//#include "stdafx.h"
+
+// How print statements write numbers.
+enum class NumberFormat
+{
+    // The fewest digits that read back as the same number, in fixed or scientific notation, whichever is shorter.
+    // Integers are written in full.
+    Shortest,
+    // 6 significant digits, the default format of iostreams, which older versions printed.
+    SixDigits,
+};
+
+// Size of a buffer that any number fits in. The longest, like -1.2345678901234567e-308, have 24 characters.
+static const size_t NUMBER_TEXT_CAPACITY = 32;
+
+// Writes a_value in a_format to a_buffer, which has room for NUMBER_TEXT_CAPACITY characters. Returns the end of
+// the text, which is not null terminated.
+char *FormatNumber(char *a_buffer, double a_value, NumberFormat a_format);
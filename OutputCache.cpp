@@ -0,0 +1,265 @@
+/**
+ *  OutputCache.cpp
+ *  Implementation of OutputCache.hpp
+ */
+
+#include "OutputCache.hpp"
+#include "PrefixHeader.pch"
+//#include "stdafx.h"
+#include <sys/mman.h>
+
+/**
+ * OutputCache::OutputCache. Constructor for OutputCache class.
+ * Creates the directory if it does not exist.
+ * @param a_capacity size_t Bytes of output kept in memory.
+ * @param a_directory const string Directory that outputs are persisted to. Empty to only keep them in memory.
+ */
+OutputCache::OutputCache(size_t a_capacity, const string &a_directory) : m_capacity(a_capacity), m_directory(a_directory)
+{
+    if(!m_directory.empty() && mkdir(m_directory.c_str(), 0755) != 0 && errno != EEXIST)
+    {
+        cerr << "Could not create the output cache directory: " << m_directory << ": " << strerror(errno) << endl;
+        exit(1);
+    }
+}
+
+/**
+ * OutputCache::Find. Method to look up the output of a run.
+ * Outputs found in the directory are kept in memory too.
+ * @param a_key const OutputKey The run.
+ * @param a_output string Receives the output.
+ * @return bool True if the output is cached.
+ */
+bool OutputCache::Find(const OutputKey &a_key, string &a_output)
+{
+    {
+        lock_guard<mutex> lock(m_mutex);
+        map< pair<uint64_t,uint64_t>, list<Entry>::iterator >::iterator entry =
+            m_index.find(make_pair(a_key.m_program, a_key.m_input));
+        if(entry != m_index.end())
+        {
+            m_entries.splice(m_entries.begin(), m_entries, entry->second);
+            a_output = entry->second->m_output;
+            return true;
+        }
+    }
+    
+    if(m_directory.empty())
+        return false;
+    int file = open(GetFileName(a_key).c_str(), O_RDONLY);
+    if(file == -1)
+        return false;
+    bool found = ReadAll(file, a_output);
+    close(file);
+    if(found)
+    {
+        lock_guard<mutex> lock(m_mutex);
+        Remember(a_key, a_output);
+    }
+    return found;
+}
+
+/**
+ * OutputCache::Insert. Method to keep the output of a run.
+ * Keeps the output in memory and persists it to the directory. The file is written under a temporary name and then
+ * renamed, so that other runs never read a partial output.
+ * @param a_key const OutputKey The run.
+ * @param a_output const string Its output.
+ */
+void OutputCache::Insert(const OutputKey &a_key, const string &a_output)
+{
+    {
+        lock_guard<mutex> lock(m_mutex);
+        Remember(a_key, a_output);
+    }
+    
+    if(m_directory.empty())
+        return;
+    string fileName = GetFileName(a_key);
+    string temporaryName = fileName + "." + to_string(getpid()) + ".tmp";
+    int file = open(temporaryName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(file == -1)
+        return;
+    bool written = WriteAll(file, a_output);
+    close(file);
+    if(!written || rename(temporaryName.c_str(), fileName.c_str()) != 0)
+        unlink(temporaryName.c_str());
+}
+
+/**
+ * OutputCache::Remember. Method to keep an output in memory.
+ * Puts the output first, then evicts the least recently used outputs until the cache is within its capacity.
+ * Outputs larger than the capacity are not kept.
+ * @param a_key const OutputKey The run.
+ * @param a_output const string Its output.
+ */
+void OutputCache::Remember(const OutputKey &a_key, const string &a_output)
+{
+    pair<uint64_t,uint64_t> key = make_pair(a_key.m_program, a_key.m_input);
+    map< pair<uint64_t,uint64_t>, list<Entry>::iterator >::iterator entry = m_index.find(key);
+    if(entry != m_index.end())
+    {
+        m_size -= entry->second->m_output.size();
+        m_entries.erase(entry->second);
+        m_index.erase(entry);
+    }
+    if(a_output.size() > m_capacity)
+        return;
+    
+    m_entries.push_front(Entry{a_key, a_output});
+    m_index[key] = m_entries.begin();
+    m_size += a_output.size();
+    while(m_size > m_capacity)
+    {
+        const Entry &oldest = m_entries.back();
+        m_size -= oldest.m_output.size();
+        m_index.erase(make_pair(oldest.m_key.m_program, oldest.m_key.m_input));
+        m_entries.pop_back();
+    }
+}
+
+/**
+ * OutputCache::GetFileName. Method to get the file of an output.
+ * @param a_key const OutputKey The run.
+ * @return string The file, named after the two hashes in the directory.
+ */
+string OutputCache::GetFileName(const OutputKey &a_key) const
+{
+    char name[64];
+    snprintf(name, sizeof(name), "/%016llx-%016llx.out", (unsigned long long)a_key.m_program,
+             (unsigned long long)a_key.m_input);
+    return m_directory + name;
+}
+
+/**
+ * OutputCache::ReadAll. Method to read a file to its end.
+ * @param a_file int The file.
+ * @param a_data string Receives the data.
+ * @return bool False if the file could not be read.
+ */
+bool OutputCache::ReadAll(int a_file, string &a_data)
+{
+    a_data.clear();
+    char buffer[65536];
+    while(true)
+    {
+        ssize_t count = read(a_file, buffer, sizeof(buffer));
+        if(count == 0)
+            return true;
+        if(count < 0 && errno != EINTR)
+            return false;
+        if(count > 0)
+            a_data.append(buffer, count);
+    }
+}
+
+/**
+ * OutputCache::WriteAll. Method to write all of a_data to a file.
+ * @param a_file int The file.
+ * @param a_data const string The data.
+ * @return bool False if the file could not be written.
+ */
+bool OutputCache::WriteAll(int a_file, const string &a_data)
+{
+    size_t written = 0;
+    while(written < a_data.size())
+    {
+        ssize_t count = write(a_file, a_data.data() + written, a_data.size() - written);
+        if(count < 0 && errno != EINTR)
+            return false;
+        if(count > 0)
+            written += count;
+    }
+    return true;
+}
+
+/**
+ * OutputCache::MakeInputFile. Method to make a file that reads some data.
+ * Used to give a program the input that was read to compute its key.
+ * @param a_data const string The data.
+ * @return int Descriptor of an anonymous file that reads a_data from its start, -1 on errors.
+ */
+int OutputCache::MakeInputFile(const string &a_data)
+{
+    int file = memfd_create("duck-input", 0);
+    if(file == -1)
+        return -1;
+    if(!WriteAll(file, a_data) || lseek(file, 0, SEEK_SET) != 0)
+    {
+        close(file);
+        return -1;
+    }
+    return file;
+}
+
+// The recorder that the exit handler passes the output of.
+static OutputRecorder *s_recording = NULL;
+
+/**
+ * OutputRecorder::Start. Method to start recording.
+ * Flushes what cout has buffered, then makes cout write through the recorder.
+ * @param a_onSuccess function<void(const string&)> Called with the output when the program exits with status 0.
+ */
+void OutputRecorder::Start(function<void(const string &)> a_onSuccess)
+{
+    cout.flush();
+    m_onSuccess = a_onSuccess;
+    m_previous = cout.rdbuf(this);
+    
+    if(s_recording == NULL)
+        on_exit(FinishOnExit, NULL);
+    s_recording = this;
+}
+
+/**
+ * OutputRecorder::FinishOnExit. Exit handler.
+ * Flushes cout and passes the output on if the program exits with status 0 and the run was not discarded.
+ * @param a_status int The exit status.
+ * @param a_argument void* Unused.
+ */
+void OutputRecorder::FinishOnExit(int a_status, void *a_argument)
+{
+    OutputRecorder *recorder = s_recording;
+    if(recorder == NULL)
+        return;
+    s_recording = NULL;
+    
+    cout.flush();
+    cout.rdbuf(recorder->m_previous);
+    if(a_status == 0 && !recorder->m_discarded)
+        recorder->m_onSuccess(recorder->m_output);
+}
+
+/**
+ * OutputRecorder::overflow. Method called by cout to write a character.
+ * @param a_char int The character, or EOF.
+ * @return int a_char, EOF if it could not be written.
+ */
+int OutputRecorder::overflow(int a_char)
+{
+    if(a_char == traits_type::eof())
+        return traits_type::not_eof(a_char);
+    m_output += traits_type::to_char_type(a_char);
+    return m_previous->sputc(traits_type::to_char_type(a_char));
+}
+
+/**
+ * OutputRecorder::xsputn. Method called by cout to write characters.
+ * @param a_data const char* The characters.
+ * @param a_size streamsize Number of characters.
+ * @return streamsize Number of characters written.
+ */
+streamsize OutputRecorder::xsputn(const char *a_data, streamsize a_size)
+{
+    m_output.append(a_data, a_size);
+    return m_previous->sputn(a_data, a_size);
+}
+
+/**
+ * OutputRecorder::sync. Method called by cout on flushes.
+ * @return int 0, -1 if the previous buffer could not be flushed.
+ */
+int OutputRecorder::sync()
+{
+    return m_previous->pubsync();
+}
@@ -0,0 +1,113 @@
+/**
+ *  OutputCache.hpp
+ *  Cache of the output of deterministic runs, for --memoize.
+ *  A program whose behaviour only depends on its read input writes the same output whenever it is given the same
+ *  input. The output of such runs is kept, keyed by a hash of the normalized statements of the program and a hash of
+ *  the input, and written back without running the program when the same pair comes again. The cache is bounded in
+ *  memory with LRU eviction, and can be persisted to a directory so that it is shared between runs and servers.
+ *
+ *  Only runs that exit through stop or end are kept. The input is read to its end before the program runs, since the
+ *  whole input is part of the key.
+ */
+
+#pragma once
+#include "PrefixHeader.pch"
+//#include "stdafx.h"
+
+// Megabytes of output kept in memory, unless given on the command line.
+static const size_t OUTPUT_CACHE_DEFAULT_MEGABYTES = 64;
+
+// Identifies a run: the hash of the normalized program, and the hash of its input.
+struct OutputKey
+{
+    uint64_t m_program = 0;
+    uint64_t m_input = 0;
+};
+
+class OutputCache
+{
+public:
+    OutputCache(size_t a_capacity, const string &a_directory);
+    
+    // Looks up the output of a run, in memory and then in the directory. Returns false if it is not cached.
+    bool Find(const OutputKey &a_key, string &a_output);
+    
+    // Keeps the output of a run, evicting the least recently used outputs to stay within the capacity.
+    void Insert(const OutputKey &a_key, const string &a_output);
+    
+    // Hashes bytes with 64 bit FNV-1a, carrying on from a_hash.
+    static uint64_t HashBytes(const char *a_data, size_t a_size, uint64_t a_hash = 14695981039346656037ULL)
+    {
+        for(size_t i = 0; i < a_size; i++)
+            a_hash = (a_hash ^ (unsigned char)a_data[i]) * 1099511628211ULL;
+        return a_hash;
+    }
+    
+    // Reads a file to its end. Returns false on errors.
+    static bool ReadAll(int a_file, string &a_data);
+    
+    // Writes all of a_data to a file. Returns false on errors.
+    static bool WriteAll(int a_file, const string &a_data);
+    
+    // Makes an anonymous file that reads a_data from its start. Returns its descriptor, -1 on errors.
+    static int MakeInputFile(const string &a_data);
+    
+private:
+    // A cached output.
+    struct Entry
+    {
+        OutputKey m_key;
+        string m_output;
+    };
+    
+    // Gets the file that an output is persisted to.
+    string GetFileName(const OutputKey &a_key) const;
+    
+    // Keeps an output in memory. Must be called with m_mutex locked.
+    void Remember(const OutputKey &a_key, const string &a_output);
+    
+    // Outputs in memory, most recently used first, indexed by their key, and their total size.
+    list<Entry> m_entries;
+    map< pair<uint64_t,uint64_t>, list<Entry>::iterator > m_index;
+    size_t m_size = 0;
+    
+    // Bytes of output kept in memory, and the directory outputs are persisted to, empty if they are not.
+    size_t m_capacity;
+    string m_directory;
+    mutex m_mutex;
+};
+
+// Records what is written to cout while it is still written, so that the output of a run can be cached.
+class OutputRecorder : public streambuf
+{
+public:
+    OutputRecorder() {}
+    
+    // Starts recording cout. a_onSuccess is called with the output when the program exits with status 0, unless
+    // the run was discarded.
+    void Start(function<void(const string &)> a_onSuccess);
+    
+    // Discards the run, e.g. when a read found no input and the output depends on an uninitialized value.
+    void Discard()
+    {
+        m_discarded = true;
+    }
+    
+protected:
+    // Called by cout when it writes a character, a sequence of characters, and on flushes.
+    int overflow(int a_char) override;
+    streamsize xsputn(const char *a_data, streamsize a_size) override;
+    int sync() override;
+    
+private:
+    // Exit handler that passes the output on.
+    static void FinishOnExit(int a_status, void *a_argument);
+    
+    // Output recorded so far, and whether the run was discarded.
+    string m_output;
+    bool m_discarded = false;
+    
+    // Buffer of cout before Start, which the output is still written to, and what is done with the output.
+    streambuf *m_previous = NULL;
+    function<void(const string &)> m_onSuccess;
+};
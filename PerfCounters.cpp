@@ -0,0 +1,132 @@
+/**
+ *  PerfCounters.cpp
+ *  Implementation of PerfCounters.hpp
+ */
+
+#include "PerfCounters.hpp"
+#include "PrefixHeader.pch"
+//#include "stdafx.h"
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+/**
+ * PerfCounters::~PerfCounters. Destructor for PerfCounters class.
+ * Closes the counters.
+ */
+PerfCounters::~PerfCounters()
+{
+    for(int counter = 0; counter < COUNTER_COUNT; counter++)
+    {
+        if(m_counters[counter] != -1)
+            close(m_counters[counter]);
+    }
+}
+
+/**
+ * PerfCounters::OpenCounter. Method to open a counter.
+ * Opens a counter of this process, on any CPU, through perf_event_open. Only user space is counted, which is allowed
+ * without privileges under the default perf_event_paranoid setting. The counter starts disabled.
+ * @param a_type uint32_t The type of the counter: PERF_TYPE_HARDWARE or PERF_TYPE_SOFTWARE.
+ * @param a_config uint64_t The counter of that type.
+ * @return int The file descriptor of the counter. -1 if it is not available.
+ */
+int PerfCounters::OpenCounter(uint32_t a_type, uint64_t a_config)
+{
+    struct perf_event_attr attributes;
+    memset(&attributes, 0, sizeof(attributes));
+    attributes.size = sizeof(attributes);
+    attributes.type = a_type;
+    attributes.config = a_config;
+    attributes.disabled = 1;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    
+    return (int)syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+}
+
+/**
+ * PerfCounters::Start. Method to start counting.
+ * Opens the software and hardware counters, and enables the ones that could be opened.
+ */
+void PerfCounters::Start()
+{
+    m_counters[COUNTER_TASK_CLOCK] = OpenCounter(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK);
+    m_counters[COUNTER_PAGE_FAULTS] = OpenCounter(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS);
+    m_counters[COUNTER_CYCLES] = OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    m_counters[COUNTER_INSTRUCTIONS] = OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    m_counters[COUNTER_BRANCH_MISSES] = OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    m_counters[COUNTER_CACHE_MISSES] = OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    
+    for(int counter = 0; counter < COUNTER_COUNT; counter++)
+    {
+        if(m_counters[counter] != -1)
+        {
+            ioctl(m_counters[counter], PERF_EVENT_IOC_RESET, 0);
+            ioctl(m_counters[counter], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+/**
+ * PerfCounters::Stop. Method to stop counting.
+ * Disables the counters, so that reporting is not counted.
+ */
+void PerfCounters::Stop()
+{
+    for(int counter = 0; counter < COUNTER_COUNT; counter++)
+    {
+        if(m_counters[counter] != -1)
+            ioctl(m_counters[counter], PERF_EVENT_IOC_DISABLE, 0);
+    }
+}
+
+/**
+ * PerfCounters::ReadCounter. Method to read a counter.
+ * @param a_counter Counter The counter to read.
+ * @param a_value uint64_t Receives the count.
+ * @return bool True if the counter is available.
+ */
+bool PerfCounters::ReadCounter(Counter a_counter, uint64_t &a_value)
+{
+    if(m_counters[a_counter] == -1)
+        return false;
+    return read(m_counters[a_counter], &a_value, sizeof(a_value)) == sizeof(a_value);
+}
+
+/**
+ * PerfCounters::Report. Method to report the counts.
+ * Prints each available counter, its cost per statement, and the instructions per cycle when both hardware counters
+ * are available. Hardware counters that are not available, as in most virtual machines, are reported as such.
+ * @param a_out ostream Stream to print to.
+ * @param a_statementCount uint64_t Number of statements executed while counting.
+ */
+void PerfCounters::Report(ostream &a_out, uint64_t a_statementCount)
+{
+    static const char *const NAMES[COUNTER_COUNT] =
+    {
+        "task clock (ns)", "page faults", "cycles", "instructions", "branch misses", "cache misses"
+    };
+    
+    double statements = a_statementCount > 0 ? (double)a_statementCount : 1;
+    uint64_t values[COUNTER_COUNT];
+    bool available[COUNTER_COUNT];
+    
+    a_out << "  " << left << setw(24) << "statements executed" << right << setw(16) << a_statementCount << endl;
+    for(int counter = 0; counter < COUNTER_COUNT; counter++)
+    {
+        available[counter] = ReadCounter((Counter)counter, values[counter]);
+        a_out << "  " << left << setw(24) << NAMES[counter] << right << setw(16);
+        if(!available[counter])
+        {
+            a_out << "not available" << endl;
+            continue;
+        }
+        a_out << values[counter] << setw(14) << fixed << setprecision(2) << values[counter] / statements
+              << " per statement" << defaultfloat << endl;
+    }
+    
+    if(available[COUNTER_CYCLES] && available[COUNTER_INSTRUCTIONS] && values[COUNTER_CYCLES] > 0)
+        a_out << "  " << left << setw(24) << "instructions per cycle" << right << setw(16) << fixed << setprecision(2)
+              << (double)values[COUNTER_INSTRUCTIONS] / values[COUNTER_CYCLES] << defaultfloat << endl;
+}
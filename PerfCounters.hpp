@@ -0,0 +1,48 @@
+/**
+ *  PerfCounters.hpp
+ *  Performance counters read through the Linux perf_event_open interface, for --stats.
+ *  Hardware counters (cycles, instructions, branch and cache misses) are used when the machine has them. The
+ *  software counters (task clock and page faults) are always read, so virtual machines still get a report.
+ */
+
+#pragma once
+#include "PrefixHeader.pch"
+//#include "stdafx.h"
+
+class PerfCounters
+{
+public:
+    PerfCounters() {}
+    ~PerfCounters();
+    
+    // Opens the counters for this process, and starts counting.
+    void Start();
+    
+    // Stops counting.
+    void Stop();
+    
+    // Prints the counts to a_out, with the cost per statement for a_statementCount statements.
+    void Report(ostream &a_out, uint64_t a_statementCount);
+    
+private:
+    // Counters that are read.
+    enum Counter
+    {
+        COUNTER_TASK_CLOCK,
+        COUNTER_PAGE_FAULTS,
+        COUNTER_CYCLES,
+        COUNTER_INSTRUCTIONS,
+        COUNTER_BRANCH_MISSES,
+        COUNTER_CACHE_MISSES,
+        COUNTER_COUNT
+    };
+    
+    // File descriptors of the counters, -1 for the counters that could not be opened.
+    int m_counters[COUNTER_COUNT] = {-1, -1, -1, -1, -1, -1};
+    
+    // Opens a counter. Returns its file descriptor, or -1 if it is not available.
+    int OpenCounter(uint32_t a_type, uint64_t a_config);
+    
+    // Reads a counter. Returns false if it is not available.
+    bool ReadCounter(Counter a_counter, uint64_t &a_value);
+};
@@ -0,0 +1,371 @@
+/**
+ *  ProgramServer.cpp
+ *  Implementation of ProgramServer.hpp
+ */
+
+#include "ProgramServer.hpp"
+#include "PrefixHeader.pch"
+//#include "stdafx.h"
+#include "DuckInterpreter.hpp"
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+/**
+ * ProgramServer::ProgramServer. Constructor for ProgramServer class.
+ * @param a_socketName const string Path of the Unix domain socket to serve on.
+ * @param a_workerCount int Number of requests served at the same time.
+ * @param a_cacheSize size_t Number of loaded programs kept in the cache.
+ */
+ProgramServer::ProgramServer(const string &a_socketName, int a_workerCount, size_t a_cacheSize)
+    : m_socketName(a_socketName), m_workerCount(max(1, a_workerCount)), m_cacheSize(max((size_t)1, a_cacheSize))
+{
+}
+
+/**
+ * ProgramServer::~ProgramServer. Destructor for ProgramServer class.
+ * Closes the socket.
+ */
+ProgramServer::~ProgramServer()
+{
+    if(m_listener != -1)
+        close(m_listener);
+}
+
+/**
+ * ProgramServer::Serve. Method to serve requests.
+ * Creates the socket, replacing the file of a previous server, and serves requests on a fixed pool of worker threads.
+ * Writing to a client that went away must not stop the server, so SIGPIPE is ignored.
+ * @see RunWorker
+ */
+void ProgramServer::Serve()
+{
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(m_socketName.size() >= sizeof(address.sun_path))
+    {
+        cerr << "Socket path is too long: " << m_socketName << endl;
+        exit(1);
+    }
+    strcpy(address.sun_path, m_socketName.c_str());
+
+    m_listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(m_socketName.c_str());
+    if(m_listener == -1 || ::bind(m_listener, (struct sockaddr *)&address, sizeof(address)) != 0
+       || listen(m_listener, SOMAXCONN) != 0)
+    {
+        cerr << "Could not listen on the socket: " << m_socketName << ": " << strerror(errno) << endl;
+        exit(1);
+    }
+    signal(SIGPIPE, SIG_IGN);
+    cerr << "Serving on " << m_socketName << " with " << m_workerCount << " workers" << endl;
+
+    vector<thread> workers;
+    for(int i = 0; i < m_workerCount; i++)
+        workers.push_back(thread(&ProgramServer::RunWorker, this));
+    for(size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+}
+
+/**
+ * ProgramServer::RunWorker. Method run by the worker threads.
+ * Accepts connections and serves their request, one at a time.
+ * @see HandleRequest
+ */
+void ProgramServer::RunWorker()
+{
+    while(true)
+    {
+        int connection = accept(m_listener, NULL, NULL);
+        if(connection == -1)
+            continue;
+        HandleRequest(connection);
+        close(connection);
+    }
+}
+
+/**
+ * ProgramServer::HandleRequest. Method to serve a request.
+ * Receives the path of the program, ended by a newline, and the files of the client attached to it. Runs the program
+ * with those files and sends its exit status back. Malformed requests are dropped.
+ * @param a_connection int The connection of the client.
+ * @see RunProgram
+ */
+void ProgramServer::HandleRequest(int a_connection)
+{
+    int files[SERVER_REQUEST_FILES] = {-1, -1, -1};
+    int fileCount = 0;
+    string path;
+
+    // Receiving the path, and the files with its first bytes.
+    while(path.empty() || path.back() != '\n')
+    {
+        char buffer[512];
+        char control[CMSG_SPACE(sizeof(files))];
+        struct iovec data = {buffer, sizeof(buffer)};
+        struct msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_iov = &data;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+
+        ssize_t received = recvmsg(a_connection, &message, 0);
+        if(received <= 0 || path.size() + received > SERVER_MAX_PATH)
+            break;
+        path.append(buffer, received);
+
+        for(struct cmsghdr *header = CMSG_FIRSTHDR(&message); header != NULL; header = CMSG_NXTHDR(&message, header))
+        {
+            if(header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS)
+                continue;
+            int count = (int)((header->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+            for(int i = 0; i < count; i++)
+            {
+                int file;
+                memcpy(&file, CMSG_DATA(header) + i * sizeof(int), sizeof(int));
+                if(fileCount < SERVER_REQUEST_FILES)
+                    files[fileCount++] = file;
+                else
+                    close(file);
+            }
+        }
+    }
+
+    if(fileCount == SERVER_REQUEST_FILES && !path.empty() && path.back() == '\n')
+    {
+        path.pop_back();
+        int32_t status = RunProgram(GetProgram(path), path, files, a_connection);
+        send(a_connection, &status, sizeof(status), MSG_NOSIGNAL);
+    }
+
+    for(int i = 0; i < fileCount; i++)
+        close(files[i]);
+}
+
+/**
+ * ProgramServer::GetProgram. Method to get a loaded program.
+ * Returns the program from the cache if its source has not been modified since it was loaded. Otherwise loads it
+ * and puts it first in the cache, dropping the least recently used program when the cache is full. Loading errors
+ * exit, so the source is read once, and that text is loaded here only once ProbeProgram has loaded it in a child
+ * process. A source that is edited in between is then loaded as it was probed, instead of stopping the server.
+ * Programs whose statements all compile are compiled as they are cached. Other programs are only loaded, so that their
+ * errors are reported when the statements are reached, as they are without the server.
+ * The program is cached with the modification time of its source read after it was loaded. If that is not the time
+ * it had before it was read, the source changed in between, and the program is run without being cached.
+ * @param a_path const string Path of the program.
+ * @return shared_ptr<DuckInterpreter> The loaded program, null if it could not be loaded.
+ * @see ProbeProgram
+ */
+shared_ptr<DuckInterpreter> ProgramServer::GetProgram(const string &a_path)
+{
+    // Gets the modification time of the source. Returns false if it is gone.
+    auto getModified = [&a_path](int64_t &a_modified)
+    {
+        struct stat info;
+        if(stat(a_path.c_str(), &info) != 0)
+            return false;
+        a_modified = (int64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+        return true;
+    };
+
+    int64_t modified;
+    if(!getModified(modified))
+        return NULL;
+
+    // Looking for the program in the cache.
+    {
+        lock_guard<mutex> lock(m_cacheMutex);
+        for(list<CachedProgram>::iterator cached = m_cache.begin(); cached != m_cache.end(); cached++)
+        {
+            if(cached->m_path == a_path && cached->m_modified == modified)
+            {
+                m_cache.splice(m_cache.begin(), m_cache, cached);
+                return cached->m_program;
+            }
+        }
+    }
+
+    // Loading the program.
+    string source;
+    if(!Statement::ReadSource(a_path, source))
+        return NULL;
+    bool compile = ProbeProgram(a_path, source, true);
+    if(!compile && !ProbeProgram(a_path, source, false))
+        return NULL;
+    CachedProgram loaded;
+    loaded.m_path = a_path;
+    loaded.m_program = make_shared<DuckInterpreter>();
+    loaded.m_program->SetNumberFormat(m_numberFormat);
+    loaded.m_program->RecordSource(a_path, source);
+    if(compile)
+        loaded.m_program->CompileStatements();
+    if(m_outputCache != NULL)
+        loaded.m_program->PrepareMemoization();
+
+    if(!getModified(loaded.m_modified) || loaded.m_modified != modified)
+        return loaded.m_program;
+
+    // Replacing the previous version of the program in the cache.
+    lock_guard<mutex> lock(m_cacheMutex);
+    for(list<CachedProgram>::iterator cached = m_cache.begin(); cached != m_cache.end(); cached++)
+    {
+        if(cached->m_path == a_path)
+        {
+            m_cache.erase(cached);
+            break;
+        }
+    }
+    m_cache.push_front(loaded);
+    if(m_cache.size() > m_cacheSize)
+        m_cache.pop_back();
+
+    return loaded.m_program;
+}
+
+/**
+ * ProgramServer::ProbeProgram. Method to check that a program loads.
+ * Loads the program in a child process, with its output discarded, and compiles all its statements if a_compile.
+ * @param a_path const string Path of the program.
+ * @param a_source const string The text of the program, read from a_path.
+ * @param a_compile bool Whether to compile the statements too.
+ * @return bool True if the child did not exit with an error.
+ */
+bool ProgramServer::ProbeProgram(const string &a_path, const string &a_source, bool a_compile)
+{
+    pid_t child = fork();
+    if(child == 0)
+    {
+        int discard = open("/dev/null", O_WRONLY);
+        dup2(discard, STDOUT_FILENO);
+        dup2(discard, STDERR_FILENO);
+
+        // Loading errors exit with a non-zero status. There is no flight recorder to dump, since the server only runs
+        // programs in the children of RunProgram.
+        DuckInterpreter probe;
+        probe.RecordSource(a_path, a_source);
+        if(a_compile)
+            probe.CompileStatements();
+        _exit(0);
+    }
+
+    int status = 0;
+    if(child == -1 || waitpid(child, &status, 0) != child)
+        return false;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/**
+ * ProgramServer::RunProgram. Method to run a program for a client.
+ * Forks a child that takes the files of the client as its standard input, output and error, and runs a copy of the
+ * cached program, or loads the program itself when it is not cached so that the loading errors reach the client.
+ * The child is killed if the client goes away before it is done.
+ * With memoization, the input of a program whose output can be cached is read to its end first, unless it is a
+ * terminal. If the program already ran with that input, its output is written back without running it. Otherwise the
+ * child reads the input from a copy, and passes its output back through an anonymous file to be cached.
+ * @param a_program const shared_ptr<DuckInterpreter> The cached program, null if it is not cached.
+ * @param a_path const string Path of the program.
+ * @param a_files const int Standard input, output and error of the client.
+ * @param a_connection int The connection of the client.
+ * @return int The exit status of the program, 128 plus the signal if it was killed.
+ */
+int ProgramServer::RunProgram(const shared_ptr<DuckInterpreter> &a_program, const string &a_path, const int a_files[],
+                              int a_connection)
+{
+    // Replaying the output of an earlier run with the same input, or setting up the recording of this one.
+    int input = a_files[0];
+    int recording = -1;
+    OutputKey key;
+    if(m_outputCache != NULL && a_program != NULL && a_program->IsMemoizable() && !isatty(a_files[0]))
+    {
+        string data, output;
+        if(!OutputCache::ReadAll(a_files[0], data))
+            return 1;
+        key.m_program = a_program->GetNormalizedProgramHash();
+        key.m_input = OutputCache::HashBytes(data.data(), data.size());
+        if(m_outputCache->Find(key, output))
+            return OutputCache::WriteAll(a_files[1], output) ? 0 : 1;
+
+        input = OutputCache::MakeInputFile(data);
+        recording = memfd_create("duck-output", 0);
+        if(input == -1 || recording == -1)
+        {
+            close(input);
+            close(recording);
+            return 1;
+        }
+    }
+
+    pid_t child = fork();
+    if(child == 0)
+    {
+        signal(SIGPIPE, SIG_DFL);
+        dup2(input, STDIN_FILENO);
+        for(int i = 1; i < SERVER_REQUEST_FILES; i++)
+            dup2(a_files[i], i);
+
+        // Closing the files of the server and of the other clients. The recording file, if any, is kept after the
+        // standard files.
+        int firstClosed = SERVER_REQUEST_FILES;
+        if(recording != -1)
+            dup2(recording, firstClosed++);
+        for(int file = firstClosed; file < getdtablesize(); file++)
+            close(file);
+
+        // The output is marked, so that the server can tell a run that was recorded from one that was discarded.
+        OutputRecorder recorder;
+        if(recording != -1)
+        {
+            recorder.Start([](const string &a_output) { OutputCache::WriteAll(SERVER_REQUEST_FILES, "1" + a_output); });
+            a_program->SetOutputRecorder(&recorder);
+        }
+
+        if(a_program != NULL)
+            a_program->RunInterpreter();
+        else
+        {
+            DuckInterpreter duckInt;
+            duckInt.SetNumberFormat(m_numberFormat);
+            duckInt.RecordStatements(a_path);
+            duckInt.RunInterpreter();
+        }
+        exit(0);
+    }
+    if(input != a_files[0])
+        close(input);
+    if(child == -1)
+    {
+        close(recording);
+        return 1;
+    }
+
+    // Waiting for the child, and killing it if the client goes away.
+    int status = 0;
+    while(waitpid(child, &status, WNOHANG) == 0)
+    {
+        struct pollfd client = {a_connection, POLLIN, 0};
+        char byte;
+        if(poll(&client, 1, CLIENT_CHECK_INTERVAL) > 0 && recv(a_connection, &byte, 1, MSG_DONTWAIT) <= 0)
+        {
+            kill(child, SIGKILL);
+            waitpid(child, &status, 0);
+            break;
+        }
+    }
+
+    // Caching the output of a run that was recorded.
+    if(recording != -1)
+    {
+        string output;
+        if(WIFEXITED(status) && WEXITSTATUS(status) == 0 && lseek(recording, 0, SEEK_SET) == 0
+           && OutputCache::ReadAll(recording, output) && !output.empty() && output[0] == '1')
+            m_outputCache->Insert(key, output.substr(1));
+        close(recording);
+    }
+
+    if(WIFSIGNALED(status))
+        return 128 + WTERMSIG(status);
+    return WEXITSTATUS(status);
+}
@@ -0,0 +1,97 @@
+/**
+ *  ProgramServer.hpp
+ *  Server that runs Duck programs for clients connected to a Unix domain socket, for --serve.
+ *  Loaded programs are kept in a cache, so that a program is only loaded and compiled again when its source changes.
+ *  Every request runs in a child process forked from the cached program, so that it starts from a fresh variable
+ *  state and the exits of the program do not stop the server.
+ *
+ *  A request is the path of the program, ended by a newline, sent with the standard input, output and error of the
+ *  client attached as SCM_RIGHTS. The program reads its input from, and streams its output to, those files. The
+ *  server answers with the exit status of the program as an int32_t once it is done.
+ *
+ *  With --memoize, the server reads the whole input of a request before running it, and answers requests that repeat
+ *  the program and input of an earlier run with the output of that run, without running the program.
+ */
+
+#pragma once
+#include "PrefixHeader.pch"
+//#include "stdafx.h"
+#include "OutputCache.hpp"
+#include "NumberFormat.hpp"
+
+class DuckInterpreter;
+
+// Number of files sent with a request: standard input, output and error.
+static const int SERVER_REQUEST_FILES = 3;
+
+// Longest program path accepted in a request.
+static const size_t SERVER_MAX_PATH = 4096;
+
+class ProgramServer
+{
+public:
+    ProgramServer(const string &a_socketName, int a_workerCount, size_t a_cacheSize);
+    ~ProgramServer();
+    
+    // Method to serve requests on the socket with the worker pool. Does not return.
+    void Serve();
+    
+    // Method to cache the output of deterministic runs, keeping a_capacity bytes in memory, and persisting them to
+    // a_directory if it is not empty.
+    void EnableMemoization(size_t a_capacity, const string &a_directory)
+    {
+        m_outputCache.reset(new OutputCache(a_capacity, a_directory));
+    }
+    
+    // Method to set how the programs print numbers.
+    void SetNumberFormat(NumberFormat a_format)
+    {
+        m_numberFormat = a_format;
+    }
+    
+private:
+    // Time in milliseconds between two checks that the client of a running program is still connected.
+    static const int CLIENT_CHECK_INTERVAL = 100;
+    
+    // A loaded program in the cache, with the modification time of its source when it was loaded.
+    struct CachedProgram
+    {
+        string m_path;
+        int64_t m_modified = 0;
+        shared_ptr<DuckInterpreter> m_program;
+    };
+    
+    // Path of the socket, and the socket that requests are accepted on.
+    string m_socketName;
+    int m_listener = -1;
+    
+    // Number of worker threads, each serving one request at a time.
+    int m_workerCount;
+    
+    // Loaded programs, most recently used first, and the number of programs kept.
+    list<CachedProgram> m_cache;
+    size_t m_cacheSize;
+    mutex m_cacheMutex;
+    
+    // Outputs of deterministic runs, null if they are not cached.
+    unique_ptr<OutputCache> m_outputCache;
+    
+    // How the programs print numbers.
+    NumberFormat m_numberFormat = NumberFormat::Shortest;
+    
+    // Accepts and serves requests, one at a time.
+    void RunWorker();
+    
+    // Serves the request of a client.
+    void HandleRequest(int a_connection);
+    
+    // Gets a program from the cache, loading it if needed. Returns null if it could not be loaded.
+    shared_ptr<DuckInterpreter> GetProgram(const string &a_path);
+    
+    // Checks in a child process that a_source, read from a_path, can be loaded, and compiled if a_compile, without
+    // stopping.
+    bool ProbeProgram(const string &a_path, const string &a_source, bool a_compile);
+    
+    // Runs a program in a child process with the files of the client. Returns its exit status.
+    int RunProgram(const shared_ptr<DuckInterpreter> &a_program, const string &a_path, const int a_files[], int a_connection);
+};
@@ -0,0 +1,200 @@
+/**
+ *  SamplingProfiler.cpp
+ *  Implementation of SamplingProfiler.hpp
+ */
+
+#include "SamplingProfiler.hpp"
+#include "PrefixHeader.pch"
+//#include "stdafx.h"
+#include <sys/time.h>
+
+// The profiler that SIGPROF samples for.
+static SamplingProfiler *s_sampling = NULL;
+
+/**
+ * SamplingProfiler::~SamplingProfiler. Destructor for SamplingProfiler class.
+ * Stops sampling if it is still running.
+ */
+SamplingProfiler::~SamplingProfiler()
+{
+    Stop();
+}
+
+/**
+ * SamplingProfiler::Start. Method to start sampling.
+ * Installs the SIGPROF handler and starts a timer of the CPU time of the process. SA_RESTART keeps the samples from
+ * interrupting reads and writes.
+ * @param a_programCounter const atomic<int> The statement the interpreter is executing, -1 if none.
+ * @param a_statementCount int Number of statements of the program.
+ * @param a_frequency int Samples per second of CPU time, clamped to the range SAMPLE_MIN_FREQUENCY to
+ * SAMPLE_MAX_FREQUENCY.
+ */
+void SamplingProfiler::Start(const atomic<int> *a_programCounter, int a_statementCount, int a_frequency)
+{
+    if(m_running)
+        return;
+    
+    m_programCounter = a_programCounter;
+    m_statementCount = a_statementCount;
+    m_frequency = max(SAMPLE_MIN_FREQUENCY, min(a_frequency, SAMPLE_MAX_FREQUENCY));
+    m_samples.reset(new atomic<uint64_t>[max(1, a_statementCount)]);
+    for(int statement = 0; statement < a_statementCount; statement++)
+        m_samples[statement] = 0;
+    m_outsideSamples = 0;
+    s_sampling = this;
+    
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = TakeSample;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGPROF, &action, &m_previousAction);
+    
+    // The microseconds of the period must be below a second, so whole seconds go in tv_sec.
+    long period = 1000000 / m_frequency;
+    struct itimerval timer;
+    timer.it_interval.tv_sec = period / 1000000;
+    timer.it_interval.tv_usec = period % 1000000;
+    timer.it_value = timer.it_interval;
+    if(setitimer(ITIMER_PROF, &timer, NULL) != 0)
+    {
+        cerr << "Could not start the sampling timer: " << strerror(errno) << endl;
+        exit(1);
+    }
+    m_running = true;
+}
+
+/**
+ * SamplingProfiler::Stop. Method to stop sampling.
+ * Stops the timer, then puts the previous SIGPROF action back.
+ */
+void SamplingProfiler::Stop()
+{
+    if(!m_running)
+        return;
+    
+    struct itimerval timer;
+    memset(&timer, 0, sizeof(timer));
+    setitimer(ITIMER_PROF, &timer, NULL);
+    sigaction(SIGPROF, &m_previousAction, NULL);
+    s_sampling = NULL;
+    m_running = false;
+}
+
+/**
+ * SamplingProfiler::TakeSample. Signal handler for SIGPROF.
+ * Counts a sample for the statement the interpreter is executing. Only uses lock-free atomics, so it is
+ * async-signal-safe.
+ * @param a_signal int The signal.
+ */
+void SamplingProfiler::TakeSample(int a_signal)
+{
+    SamplingProfiler *profiler = s_sampling;
+    if(profiler == NULL)
+        return;
+    
+    int statement = profiler->m_programCounter->load(memory_order_relaxed);
+    if(statement >= 0 && statement < profiler->m_statementCount)
+        profiler->m_samples[statement].fetch_add(1, memory_order_relaxed);
+    else
+        profiler->m_outsideSamples.fetch_add(1, memory_order_relaxed);
+}
+
+/**
+ * SamplingProfiler::GetFrames. Method to get the frames of a statement.
+ * @param a_statements const Statement The statements of the program.
+ * @param a_statement int The statement number.
+ * @param a_label string Receives the label of the block the statement is in, "(start)" before the first label.
+ * @param a_frame string Receives the line and the text of the statement, without semicolons.
+ */
+void SamplingProfiler::GetFrames(const Statement &a_statements, int a_statement, string &a_label, string &a_frame)
+{
+    if(!a_statements.FindEnclosingLabel(a_statement, a_label))
+        a_label = "(start)";
+    
+    string text(a_statements.GetRecordedStatement(a_statement));
+    size_t start = text.find_first_not_of(" \t");
+    text.erase(0, start == string::npos ? text.size() : start);
+    while(!text.empty() && (text.back() == ';' || text.back() == ' ' || text.back() == '\t'))
+        text.pop_back();
+    replace(text.begin(), text.end(), ';', ',');
+    
+    a_frame = "line " + to_string(a_statements.GetLineNumber(a_statement)) + ": " + text;
+}
+
+/**
+ * SamplingProfiler::WriteCollapsed. Method to write the samples as collapsed stacks.
+ * Writes a line per statement with samples, in the format of flamegraph.pl and the tools that read it: the label of
+ * the block, the statement, and the number of samples. Samples taken outside of the statements are written as
+ * "(interpreter)".
+ * @param a_out ostream Stream to write to.
+ * @param a_statements const Statement The statements of the program.
+ */
+void SamplingProfiler::WriteCollapsed(ostream &a_out, const Statement &a_statements) const
+{
+    string label, frame;
+    int count = min(m_statementCount, a_statements.GetStatementCount());
+    for(int statement = 0; statement < count; statement++)
+    {
+        uint64_t samples = m_samples[statement].load();
+        if(samples == 0)
+            continue;
+        GetFrames(a_statements, statement, label, frame);
+        a_out << label << ";" << frame << " " << samples << "\n";
+    }
+    if(m_outsideSamples.load() != 0)
+        a_out << "(interpreter) " << m_outsideSamples.load() << "\n";
+    a_out.flush();
+}
+
+/**
+ * SamplingProfiler::Report. Method to print the top statements and labels.
+ * Prints the total number of samples, then the a_top statements and the a_top labels with the most samples, with
+ * their share of the samples.
+ * @param a_out ostream Stream to print to.
+ * @param a_statements const Statement The statements of the program.
+ * @param a_top int Number of statements and labels printed.
+ */
+void SamplingProfiler::Report(ostream &a_out, const Statement &a_statements, int a_top) const
+{
+    // Totals per statement and per label.
+    vector< pair<uint64_t,int> > statements;
+    map<string,uint64_t> labels;
+    uint64_t total = m_outsideSamples.load();
+    string label, frame;
+    int count = min(m_statementCount, a_statements.GetStatementCount());
+    for(int statement = 0; statement < count; statement++)
+    {
+        uint64_t samples = m_samples[statement].load();
+        if(samples == 0)
+            continue;
+        total += samples;
+        statements.push_back(make_pair(samples, statement));
+        GetFrames(a_statements, statement, label, frame);
+        labels[label] += samples;
+    }
+    vector< pair<uint64_t,string> > labelTotals;
+    for(const pair<const string,uint64_t> &entry : labels)
+        labelTotals.push_back(make_pair(entry.second, entry.first));
+    sort(statements.begin(), statements.end(), greater< pair<uint64_t,int> >());
+    sort(labelTotals.begin(), labelTotals.end(), greater< pair<uint64_t,string> >());
+    
+    a_out << "Sampling profile: " << total << " samples at " << m_frequency << " Hz" << endl;
+    if(total == 0)
+        return;
+    
+    a_out << "Top statements:" << endl;
+    for(int i = 0; i < a_top && i < (int)statements.size(); i++)
+    {
+        GetFrames(a_statements, statements[i].second, label, frame);
+        a_out << "  " << setw(10) << statements[i].first << setw(8) << fixed << setprecision(1)
+              << 100.0 * statements[i].first / total << "%  " << label << ": " << frame << defaultfloat << endl;
+    }
+    a_out << "Top labels:" << endl;
+    for(int i = 0; i < a_top && i < (int)labelTotals.size(); i++)
+        a_out << "  " << setw(10) << labelTotals[i].first << setw(8) << fixed << setprecision(1)
+              << 100.0 * labelTotals[i].first / total << "%  " << labelTotals[i].second << defaultfloat << endl;
+    if(m_outsideSamples.load() != 0)
+        a_out << "  " << setw(10) << m_outsideSamples.load() << setw(8) << fixed << setprecision(1)
+              << 100.0 * m_outsideSamples.load() / total << "%  (interpreter)" << defaultfloat << endl;
+}
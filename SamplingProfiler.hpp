@@ -0,0 +1,63 @@
+/**
+ *  SamplingProfiler.hpp
+ *  Sampling profiler, for --sample.
+ *  A SIGPROF timer samples the statement that the interpreter is executing at a fixed frequency of CPU time, so the
+ *  interpreter loop only publishes its program counter and is not slowed down by counting every statement. Samples
+ *  are counted per statement, and reported grouped by the label of the block each statement is in: as collapsed
+ *  stacks (label;statement count) for flamegraph tools, and as a plain-text report of the top statements and labels.
+ */
+
+#pragma once
+#include "PrefixHeader.pch"
+//#include "stdafx.h"
+#include "Statement.hpp"
+
+// Samples per second of CPU time, and number of statements and labels in the report, unless given on the command line.
+static const int SAMPLE_DEFAULT_FREQUENCY = 997;
+static const int SAMPLE_DEFAULT_TOP = 10;
+
+// Range of the sampling frequency. The timer counts microseconds, so it can not go faster than one sample each.
+static const int SAMPLE_MIN_FREQUENCY = 1;
+static const int SAMPLE_MAX_FREQUENCY = 1000000;
+
+class SamplingProfiler
+{
+public:
+    SamplingProfiler() {}
+    ~SamplingProfiler();
+    
+    // Starts sampling a_programCounter, the statement being executed or -1, a_frequency times per second.
+    // a_statementCount is the number of statements of the program.
+    void Start(const atomic<int> *a_programCounter, int a_statementCount, int a_frequency);
+    
+    // Stops sampling.
+    void Stop();
+    
+    // Writes the samples of each statement as collapsed stacks, one line per statement: label;statement count.
+    void WriteCollapsed(ostream &a_out, const Statement &a_statements) const;
+    
+    // Prints the a_top statements and labels with the most samples.
+    void Report(ostream &a_out, const Statement &a_statements, int a_top) const;
+    
+private:
+    // Signal handler that takes a sample.
+    static void TakeSample(int a_signal);
+    
+    // Gets the frames of a statement: the label of its block, and the statement with its line.
+    // Semicolons separate frames in collapsed stacks, so they are removed from the statement.
+    static void GetFrames(const Statement &a_statements, int a_statement, string &a_label, string &a_frame);
+    
+    // Program counter of the interpreter, and the number of statements that samples are counted for.
+    const atomic<int> *m_programCounter = NULL;
+    int m_statementCount = 0;
+    
+    // Samples of each statement, and the samples taken while no statement was executing, e.g. while loading.
+    // Atomic, since the signal can be delivered to any thread of the interpreter.
+    unique_ptr< atomic<uint64_t>[] > m_samples;
+    atomic<uint64_t> m_outsideSamples{0};
+    
+    // Whether the timer runs, its frequency, and the SIGPROF action that was installed before.
+    bool m_running = false;
+    int m_frequency = 0;
+    struct sigaction m_previousAction;
+};
@@ -8,6 +8,7 @@
  */
 
 #include "Statement.hpp"
+#include "Keywords.hpp"
 #include "PrefixHeader.pch"
 //#include "stdafx.h"
 #include "DuckInterpreter.hpp"
@@ -30,21 +31,178 @@ Statement::~Statement(){}
 
 /**
  * Statement::RecordStatements. Method to record statements from a source file.
- * Records code statements on each line from file "a_sourceFileName". Every time it gets a line from the file, the method
- * checks if there are any labels in the statement. If there are, it records them in "m_labelToStatement" with the label
- * name as key and associated line number as value. After recording the label, it removes it from the statement.
- * After removing the label, it calls StandardSpaceFormat method to ensure that consistent formatting is followed in the code.
- * After standardizing the spaces, the method records the statement in the vector "m_statements".
+ * Records code statements on each line from file "a_sourceFileName". The file is read at once and split into chunks at
+ * line boundaries. Large files are split into several chunks that are loaded in parallel by LoadChunk, small files are
+ * loaded as a single chunk. The chunks are then merged in order: the text of their statements is appended to the text
+ * arena "m_text", with the offset of each statement in "m_offsets", and their labels are recorded in the label arena
+ * with their statement numbers fixed up. The labels are then sorted by name, so that they are looked up with a binary
+ * search. Statements are not parsed here: StandardSpaceFormat is applied by GetStatement when a statement is
+ * accessed, so loading only costs the line split and the label scan.
+ * Reports an error if a label is defined twice or if there are statements after the end statement.
  * @param a_sourceFileName string File that has the duck code statements.
+ * @see LoadChunk
  * @see StandardSpaceFormat
  * @author Salil Maharjan
  * @date 03/13/19
  */
 void Statement::RecordStatements(string a_sourceFileName)
 {
-    // Flag if end statement is found.
-    bool end_statement_found  = false;
+    // Open file and check if it opened correctly.
+    string source;
+    if(!ReadSource(a_sourceFileName, source))
+    {
+        cerr << "Could not open the file: " << a_sourceFileName << endl;
+        exit(1);
+    }
+    RecordSource(source, a_sourceFileName);
+}
+
+/**
+ * Statement::ReadSource. Method to read a source file.
+ * Reads the whole file at once, so that the text that is checked and the text that is recorded are the same even if
+ * the file changes in between.
+ * @param a_sourceFileName const string File that has the duck code statements.
+ * @param a_source string Receives the text of the file.
+ * @return bool False if the file could not be read.
+ * @see RecordSource
+ */
+bool Statement::ReadSource(const string &a_sourceFileName, string &a_source)
+{
+    ifstream inf(a_sourceFileName, ios::binary);
+    if(!inf)
+        return false;
+    a_source.assign(istreambuf_iterator<char>(inf), istreambuf_iterator<char>());
+    return !inf.bad();
+}
+
+/**
+ * Statement::RecordSource. Method to record statements from the text of a source file.
+ * Does the work of RecordStatements once the source has been read.
+ * @param a_source const string The text of the source.
+ * @param a_sourceFileName const string File that the source was read from, for the error messages.
+ * @see RecordStatements
+ */
+void Statement::RecordSource(const string &a_source, const string &a_sourceFileName)
+{
+    // Number of chunks to load in parallel. Small sources are not worth the threads.
+    size_t chunkCount = 1;
+    if(a_source.size() >= PARALLEL_LOAD_MIN_BYTES)
+    {
+        chunkCount = min((size_t)max(1u, thread::hardware_concurrency()), a_source.size() / PARALLEL_LOAD_MIN_BYTES + 1);
+    }
+    
+    // Splitting the source into chunks at newline boundaries.
+    vector<size_t> boundaries(1, 0);
+    for(size_t c = 1; c < chunkCount; c++)
+    {
+        size_t pos = a_source.find('\n', max(boundaries.back(), c * a_source.size() / chunkCount));
+        if(pos == string::npos)
+            break;
+        boundaries.push_back(pos + 1);
+    }
+    boundaries.push_back(a_source.size());
+    
+    // Loading the chunks. The first chunk is loaded on this thread.
+    vector<SourceChunk> chunks(boundaries.size() - 1);
+    vector<thread> workers;
+    for(size_t c = 1; c < chunks.size(); c++)
+        workers.push_back(thread(&Statement::LoadChunk, this, cref(a_source), boundaries[c], boundaries[c+1], ref(chunks[c])));
+    LoadChunk(a_source, boundaries[0], boundaries[1], chunks[0]);
+    for(size_t c = 0; c < workers.size(); c++)
+        workers[c].join();
+    
+    // Merging the chunks in order.
+    // Lines after the end statement are reported before they are recorded, so their labels are never checked.
+    bool end_statement_found = false;
+    int firstLine = 1;
+    for(size_t c = 0; c < chunks.size(); c++)
+    {
+        SourceChunk &chunk = chunks[c];
+        
+        // Report error if there are more lines after the end statement.
+        if(end_statement_found && !chunk.m_ends.empty())
+            ReportStatementAfterEnd(chunk.m_firstLine);
+        
+        // Recording labels with the statement numbers of the whole a_source.
+        int offset = GetStatementCount();
+        for(size_t l = 0; l < chunk.m_labels.size(); l++)
+        {
+            LabelEntry label;
+            label.m_offset = (uint32_t)m_labelText.size();
+            label.m_length = (uint32_t)chunk.m_labels[l].first.size();
+            label.m_statement = chunk.m_labels[l].second + offset - 1;
+            m_labelText += chunk.m_labels[l].first;
+            m_labelsInOrder.push_back(label);
+        }
+        
+        if(chunk.m_endStatementFound)
+        {
+            end_statement_found = true;
+            if(chunk.m_statementAfterEnd)
+                ReportStatementAfterEnd(chunk.m_afterEndLine);
+        }
+        
+        // Recording statements
+        if(m_text.size() + chunk.m_text.size() > UINT32_MAX)
+        {
+            cerr << "Error: The source is too large: " << a_sourceFileName << endl;
+            exit(1);
+        }
+        uint32_t base = (uint32_t)m_text.size();
+        m_text += chunk.m_text;
+        for(size_t i = 0; i < chunk.m_ends.size(); i++)
+        {
+            m_offsets.push_back(base + chunk.m_ends[i]);
+            m_sourceHashes.push_back(hash<string_view>()(GetRecordedStatement((int)m_offsets.size() - 2)));
+            m_lineNumbers.push_back(firstLine + chunk.m_lineNumbers[i]);
+        }
+        firstLine += chunk.m_lineCount;
+        
+        // Releasing the chunk, so that the source is not held twice.
+        chunk = SourceChunk();
+    }
+    m_text.shrink_to_fit();
+    m_offsets.shrink_to_fit();
+    m_sourceHashes.shrink_to_fit();
+    m_lineNumbers.shrink_to_fit();
+    
+    // Marking the statements that have a label.
+    m_labeled.assign(GetStatementCount(), false);
+    for(size_t l = 0; l < m_labelsInOrder.size(); l++)
+        m_labeled[m_labelsInOrder[l].m_statement] = true;
     
+    // Sorting the labels by name, and reporting labels defined twice.
+    m_labelsByName.resize(m_labelsInOrder.size());
+    for(size_t l = 0; l < m_labelsByName.size(); l++)
+        m_labelsByName[l] = (uint32_t)l;
+    sort(m_labelsByName.begin(), m_labelsByName.end(), [this](uint32_t a_first, uint32_t a_second)
+         { return GetLabelName(m_labelsInOrder[a_first]) < GetLabelName(m_labelsInOrder[a_second]); });
+    for(size_t l = 1; l < m_labelsByName.size(); l++)
+    {
+        string_view label = GetLabelName(m_labelsInOrder[m_labelsByName[l]]);
+        if(label == GetLabelName(m_labelsInOrder[m_labelsByName[l-1]]))
+        {
+            cerr<<"Error: Duplicate label found: "<<label<<endl;
+            exit(1);
+        }
+    }
+}
+
+/**
+ * Statement::LoadChunk. Method to load a chunk of the source.
+ * Records the statements on each line of a_source between a_begin and a_end. Every time it gets a line, the method
+ * checks if there are any labels in the statement. If there are, it records them in the chunk with the label
+ * name and the associated line number in the chunk. After recording the label, it removes it from the statement.
+ * Loading stops at the first line after an end statement, which is recorded so that RecordStatements can report it.
+ * Does not touch the members of the class, so chunks can be loaded in parallel.
+ * @param a_source const string The whole source.
+ * @param a_begin size_t Position of the first character of the chunk. Must be at the start of a line.
+ * @param a_end size_t Position after the last character of the chunk. Must be after a newline or the end of a_source.
+ * @param a_chunk SourceChunk Receives the statements and labels of the chunk.
+ * @see RecordStatements
+ */
+void Statement::LoadChunk(const string &a_source, size_t a_begin, size_t a_end, SourceChunk &a_chunk)
+{
     // Loop iterators
     int i,j;
     
@@ -52,43 +210,33 @@ void Statement::RecordStatements(string a_sourceFileName)
     bool neg_label=0;
     string buffer;
     
-    // Open file and check if it opened correctly.
-    ifstream inf(a_sourceFileName);
-    if(!inf)
-    {
-        cerr << "Could not open the file: " << a_sourceFileName << endl;
-        exit(1);
-    }
-    
-    // Getting all code statements from the file
-    while(!inf.eof())
+    // Getting all code statements from the chunk
+    size_t lineStart = a_begin;
+    while(lineStart < a_end)
     {
         // Get each line
-        getline(inf,buffer);
+        size_t lineEnd = a_source.find('\n', lineStart);
+        if(lineEnd == string::npos || lineEnd > a_end)
+            lineEnd = a_end;
+        buffer.assign(a_source, lineStart, lineEnd - lineStart);
+        lineStart = lineEnd + 1;
+        int line = a_chunk.m_lineCount++;
         
         // Ignoring empty lines.
         if(buffer.empty() || buffer == " ")
             continue;
         
         // Checking if we have found the if statement.
-        // Report error if there are more lines after the end statement.
-        if(end_statement_found && !buffer.empty())
-        {
-            cerr<<"Error: Additional statements found after the end statement."<<endl;
-            cerr<<"Statement: "<<buffer<<endl;
-            cerr<<"There cannot be code after the end statement" <<endl;
-            exit(1);
-        }
-        
-        // Checking for end statement and updating flag.
-        // If the loop runs after the flag is true, we have more statements after the end statement.
-        // Reports error in this case.
-        if(buffer.find("end;") != string::npos || buffer.find("end ;") != string::npos)
+        // Record the line if there are more lines after the end statement.
+        if(a_chunk.m_endStatementFound)
         {
-            if(buffer.find("\"") == string::npos)
-                end_statement_found = true;
+            a_chunk.m_statementAfterEnd = true;
+            a_chunk.m_afterEndLine = buffer;
+            return;
         }
         
+        if(a_chunk.m_ends.empty())
+            a_chunk.m_firstLine = buffer;
         
         // Checking for Labels
         for(i=0; i<(buffer.size());i++)
@@ -107,28 +255,46 @@ void Statement::RecordStatements(string a_sourceFileName)
                 if (neg_label)
                     break;
                 
-                // Recording valid label in a map and removing it from the statement.
-                m_labelToStatement[buffer.substr(0,i)] = ((int)m_statements.size()+1);
+                // Recording valid label in the chunk and removing it from the statement.
+                a_chunk.m_labels.push_back(make_pair(buffer.substr(0,i), (int)a_chunk.m_ends.size()+1));
                 buffer.erase(0,i+1);
                 break;
                 
             }
         }
         
-        // Standardizing the input to have consistent spaces in the statement.
-        StandardSpaceFormat(buffer);
+        // Checking for end statement and updating flag.
+        // If the loop runs after the flag is true, we have more statements after the end statement.
+        if(GetKeyword(buffer) == Keyword::End)
+            a_chunk.m_endStatementFound = true;
         
-        // Recording statement
-        m_statements.push_back(buffer);
+        // Recording statement. Spaces are standardized when it is accessed.
+        a_chunk.m_text += buffer;
+        a_chunk.m_ends.push_back((uint32_t)a_chunk.m_text.size());
+        a_chunk.m_lineNumbers.push_back(line);
     }
 }
 
+/**
+ * Statement::ReportStatementAfterEnd. Method to report statements after the end statement.
+ * Reports that a_line was found after the end statement and terminates.
+ * @param a_line const string The first line after the end statement.
+ */
+void Statement::ReportStatementAfterEnd(const string &a_line)
+{
+    cerr<<"Error: Additional statements found after the end statement."<<endl;
+    cerr<<"Statement: "<<a_line<<endl;
+    cerr<<"There cannot be code after the end statement" <<endl;
+    exit(1);
+}
+
 /**
  * Statement::GetLabelLocation. Accessor to get label location.
- * Tries to get the location of the label "a_string" from the map "m_labeelToStatement".
+ * Tries to get the location of the label "a_string" from the labels sorted by name.
  * Throws invalid label error if label is not found.
  * @param a_string string Holds the name of the label
  * @return int The position of the label in the code if found.
+ * @see FindLabelLocation
  * @author Salil Maharjan
  * @date 03/13/19
  */
@@ -136,21 +302,109 @@ int Statement::GetLabelLocation(string a_string)
 {
     int pos = 0;
     
-    // Try to get the label position from the map.
-    try {
-        pos = m_labelToStatement.at(a_string);
-    } catch (std::out_of_range&  e) {
+    // Try to get the label position.
+    if(!FindLabelLocation(a_string, pos))
+    {
         std::cerr << "Invalid Label found: " << a_string << endl;
-        std::cerr << e.what() << std::endl;
         throw a_string;
     }
     
-    return (pos-1);
+    return pos;
+}
+
+/**
+ * Statement::GetProgramHash. Accessor to get a hash of the program.
+ * Combines the hashes of all the source lines, in order.
+ * @return size_t Hash of the program.
+ * @see GetSourceHash
+ */
+size_t Statement::GetProgramHash() const
+{
+    size_t programHash = m_sourceHashes.size();
+    for(size_t i = 0; i < m_sourceHashes.size(); i++)
+        programHash = programHash * 1099511628211ULL ^ m_sourceHashes[i];
+    return programHash;
+}
+
+/**
+ * Statement::GetNormalizedHash. Accessor to get a hash of the normalized program.
+ * Hashes the label and the elements of each statement, in the standard space format and separated by single spaces,
+ * with 64 bit FNV-1a. The elements are what the interpreter parses, so the spacing of the source does not change the
+ * hash. Used as the key of the program by the output cache.
+ * @return uint64_t Hash of the normalized program.
+ * @see StandardSpaceFormat
+ */
+uint64_t Statement::GetNormalizedHash() const
+{
+    uint64_t hash = 14695981039346656037ULL;
+    auto addByte = [&hash](char a_byte) { hash = (hash ^ (unsigned char)a_byte) * 1099511628211ULL; };
+    
+    string label;
+    for(int statementNum = 0; statementNum < GetStatementCount(); statementNum++)
+    {
+        if(HasLabel(statementNum) && FindEnclosingLabel(statementNum, label))
+        {
+            for(char c : label)
+                addByte(c);
+            addByte(':');
+        }
+        
+        // Adding the elements, with a single space after each.
+        string statement = GetStatement(statementNum);
+        bool inElement = false;
+        for(char c : statement)
+        {
+            bool space = c == ' ' || c == '\t' || c == '\r';
+            if(!space)
+                addByte(c);
+            else if(inElement)
+                addByte(' ');
+            inElement = !space;
+        }
+        if(inElement)
+            addByte(' ');
+        addByte('\n');
+    }
+    return hash;
+}
+
+/**
+ * Statement::FindLabelLocation. Accessor to find a label location.
+ * Looks up the location of the label "a_string" without reporting an error if it does not exist, with a binary search
+ * of the labels sorted by name.
+ * @param a_string const string Holds the name of the label
+ * @param a_location int Receives the position of the label in the code if found.
+ * @return bool True if the label was found.
+ * @see GetLabelLocation
+ */
+bool Statement::FindLabelLocation(const string &a_string, int &a_location) const
+{
+    vector<uint32_t>::const_iterator label = lower_bound(m_labelsByName.begin(), m_labelsByName.end(), a_string,
+                                                         [this](uint32_t a_label, const string &a_name)
+                                                         { return GetLabelName(m_labelsInOrder[a_label]) < a_name; });
+    if(label == m_labelsByName.end() || GetLabelName(m_labelsInOrder[*label]) != a_string)
+        return false;
+    
+    a_location = m_labelsInOrder[*label].m_statement;
+    return true;
+}
+
+/**
+ * Statement::GetMemoryUsage. Accessor to get the memory used by the statements.
+ * Adds up the capacities of the text arenas and of the tables of the statements and labels.
+ * @return size_t Number of bytes used to store the statements and labels.
+ */
+size_t Statement::GetMemoryUsage() const
+{
+    return sizeof(*this) + m_text.capacity() + m_offsets.capacity() * sizeof(uint32_t)
+           + m_labeled.capacity() / CHAR_BIT + m_lineNumbers.capacity() * sizeof(int)
+           + m_sourceHashes.capacity() * sizeof(size_t) + m_labelText.capacity()
+           + m_labelsInOrder.capacity() * sizeof(LabelEntry) + m_labelsByName.capacity() * sizeof(uint32_t);
 }
 
 /**
  * Statement::NeedSpace. Method to check if it is a character we need to cheeck spaces for.
- * True if we need to check space for the character, False otherwise.
+ * True if we need to check space for the character, False otherwise. Uses the character class table in Keywords.hpp.
  * Also used to check if it is safe to insert a space in the position of 'element'.
  * If false, we insert a space. If true, we do nothing.
  * @param element char Element to check if is a character we need to check spaces for.
@@ -160,7 +414,7 @@ int Statement::GetLabelLocation(string a_string)
  */
 bool Statement::NeedSpace(char element)
 {
-    return (!isalpha(element) && !isdigit(element) && element != '_' && element != ' ' && element != ';');
+    return GetCharacterClass(element) == CHAR_OPERATOR;
 }
 
 /**
@@ -180,10 +434,13 @@ void Statement::StandardSpaceFormat(string &a_string)
     // Iterating through each character.
     for(int i = 0; i <a_string.length(); i++)
     {
-        // Jump to next quotation mark if we find a quotation.
+        // Jump to next quotation mark if we find a quotation. An unclosed quotation runs to the end of the statement.
         if(a_string.c_str()[i] == '"')
         {
-            i = (int)a_string.find("\"", i+1);
+            size_t closing = a_string.find("\"", i+1);
+            if(closing == string::npos)
+                break;
+            i = (int)closing;
             continue;
         }
         
@@ -235,3 +492,23 @@ void Statement::StandardSpaceFormat(string &a_string)
         }
     }
 }
+
+/**
+ * Statement::FindEnclosingLabel. Method to find the label of the block a statement is in.
+ * Finds the last label at or before statement a_statementNum with a binary search of the labels sorted by statement.
+ * @param a_statementNum int The statement number.
+ * @param a_label string Receives the label.
+ * @return bool True if there is a label at or before the statement.
+ */
+bool Statement::FindEnclosingLabel(int a_statementNum, string &a_label) const
+{
+    vector<LabelEntry>::const_iterator after = upper_bound(m_labelsInOrder.begin(), m_labelsInOrder.end(),
+                                                           a_statementNum,
+                                                           [](int a_statement, const LabelEntry &a_entry)
+                                                           { return a_statement < a_entry.m_statement; });
+    if(after == m_labelsInOrder.begin())
+        return false;
+    
+    a_label = GetLabelName(*(after - 1));
+    return true;
+}
@@ -13,6 +13,9 @@
 
 class Statement
 {
+    // duckbench times the formatting of statements in isolation.
+    friend class MicroBenchmark;
+    
 public:
     Statement();
     ~Statement();
@@ -20,11 +23,22 @@ public:
     // Method to record statements from a file.
     void RecordStatements(string a_sourceFileName);
     
+    // Method to read the whole text of a source file. Returns false if it can not be read.
+    static bool ReadSource(const string &a_sourceFileName, string &a_source);
+    
+    // Method to record statements from the text of a source file that was already read. See RecordStatements.
+    void RecordSource(const string &a_source, const string &a_sourceFileName);
+    
     // Accessor to get statements from the class.
-    string GetStatement(int a_statementNum)
+    // Statements are stored as recorded, and put in the standard space format when they are accessed.
+    string GetStatement(int a_statementNum) const
     {
-        if(a_statementNum < m_statements.size())
-            return m_statements[a_statementNum];
+        if(a_statementNum >= 0 && a_statementNum < GetStatementCount())
+        {
+            string statement(GetRecordedStatement(a_statementNum));
+            StandardSpaceFormat(statement);
+            return statement;
+        }
         else
         {
             cerr << "Invalid Label Number to Statement" << a_statementNum;
@@ -32,21 +46,129 @@ public:
         }
     }
   
+    // Accessor to get a statement as it was recorded, without formatting it. The view points into the text arena.
+    string_view GetRecordedStatement(int a_statementNum) const
+    {
+        return string_view(m_text.data() + m_offsets[a_statementNum], m_offsets[a_statementNum+1] - m_offsets[a_statementNum]);
+    }
+    
+    // Accessor to check if a statement has a label, so that it can be jumped to.
+    bool HasLabel(int a_statementNum) const
+    {
+        return m_labeled[a_statementNum];
+    }
+    
+    // Accessor to get the line of the source file that a statement is on, starting from 1.
+    int GetLineNumber(int a_statementNum) const
+    {
+        return m_lineNumbers[a_statementNum];
+    }
+    
+    // Finds the last label at or before a statement, i.e. the label of the block it is in. Returns false if there is
+    // no label before the statement.
+    bool FindEnclosingLabel(int a_statementNum, string &a_label) const;
+    
+    // Accessor to get the number of statements.
+    int GetStatementCount() const
+    {
+        return (int)m_offsets.size() - 1;
+    }
+    
+    // Accessor to get a hash of the source line of a statement, as it was recorded.
+    size_t GetSourceHash(int a_statementNum) const
+    {
+        return m_sourceHashes[a_statementNum];
+    }
+    
+    // Accessor to get a hash of all the source lines. Used to check that a snapshot belongs to this program.
+    size_t GetProgramHash() const;
+    
+    // Accessor to get a hash of the program as the interpreter sees it: the labels, and the elements of the
+    // statements in the standard space format. Programs that only differ in spacing get the same hash.
+    uint64_t GetNormalizedHash() const;
+    
     // Gets back the statement number that the label is pointing
     int GetLabelLocation(string a_string);
     
+    // Finds the statement number that the label is pointing. Returns false if there is no such label.
+    bool FindLabelLocation(const string &a_string, int &a_location) const;
+    
+    // Accessor to get the number of bytes used to store the statements and labels.
+    size_t GetMemoryUsage() const;
+    
 private:
-    // Vector that holds the statements.
-    vector<string> m_statements;
-    vector<string>::iterator itr;
+    // Sources smaller than this are loaded on a single thread. Larger sources get a chunk per this many bytes,
+    // up to one chunk per hardware thread.
+    static const size_t PARALLEL_LOAD_MIN_BYTES = 1 << 20;
+    
+    // Statements and labels loaded from one chunk of the source.
+    // Label positions are statement numbers within the chunk, starting from 1.
+    struct SourceChunk
+    {
+        // Text of the statements, one after the other, and the offset of the end of each statement in it.
+        string m_text;
+        vector<uint32_t> m_ends;
+        vector< pair<string,int> > m_labels;
+        
+        // Lines of the statements within the chunk, starting from 0, and the number of lines in the chunk.
+        vector<int> m_lineNumbers;
+        int m_lineCount = 0;
+        
+        // First non-empty line of the chunk.
+        string m_firstLine;
+        
+        // Whether the chunk has an end statement, and the first line after it if there is one.
+        bool m_endStatementFound = false;
+        bool m_statementAfterEnd = false;
+        string m_afterEndLine;
+    };
+    
+    // A label: its name in the label arena and the statement it points to.
+    struct LabelEntry
+    {
+        uint32_t m_offset;
+        uint32_t m_length;
+        int m_statement;
+    };
+    
+    // Text arena that holds the statements, one after the other, as recorded.
+    string m_text;
     
-    // Map that holds the labels from the code their respective position in the code.
-    map<string,int> m_labelToStatement;
-    map<string, int>::iterator mpi;
+    // Offset of each statement in the text arena, followed by the size of the arena. Statement i is the text between
+    // offsets i and i+1.
+    vector<uint32_t> m_offsets = vector<uint32_t>(1, 0);
+    
+    // Whether the statement at the same position has a label.
+    vector<bool> m_labeled;
+    
+    // Source lines of the statements.
+    vector<int> m_lineNumbers;
+    
+    // Hashes of the source lines of the statements, before formatting. Used to find unchanged lines on reload.
+    vector<size_t> m_sourceHashes;
+    
+    // Text arena that holds the names of the labels.
+    string m_labelText;
+    
+    // Labels sorted by statement number, and the positions of the labels in it sorted by name.
+    vector<LabelEntry> m_labelsInOrder;
+    vector<uint32_t> m_labelsByName;
 
+    // Accessor to get the name of a label.
+    string_view GetLabelName(const LabelEntry &a_label) const
+    {
+        return string_view(m_labelText.data() + a_label.m_offset, a_label.m_length);
+    }
+    
+    // Loads the statements and labels of a chunk of the source.
+    void LoadChunk(const string &a_source, size_t a_begin, size_t a_end, SourceChunk &a_chunk);
+    
+    // Reports a statement found after the end statement and terminates.
+    void ReportStatementAfterEnd(const string &a_line);
+    
     // Get a uniform space formatting
-    void StandardSpaceFormat(string &a_string);
+    static void StandardSpaceFormat(string &a_string);
     
     // Check if it is a character that we need to check spaces for.
-    bool NeedSpace(char element);
+    static bool NeedSpace(char element);
 };
@@ -30,17 +30,197 @@ SymbolTable::~SymbolTable(){}
 /**
  * SymbolTable::GetVariableValue. Accessor to get the variable value.
  * Checks if the variable is in the map and return its corresponding value.
- * Returns false if the value is not found.
+ * Returns false if the value is not found, or if the variable was created by GetVariableAddress and never assigned.
+ * The value of a shared variable is read from the value it shares.
  * @author Salil Maharjan
  * @date 03/13/19
  */
 bool SymbolTable::GetVariableValue(string a_variable, double &a_value)
 {
-    if(m_SymbolTable.find(a_variable) != m_SymbolTable.end())
+    unordered_map<string, Variable>::const_iterator variable = m_SymbolTable.find(a_variable);
+    if(variable != m_SymbolTable.end() && variable->second.m_assigned)
     {
-        a_value = m_SymbolTable[a_variable];
+        a_value = variable->second.m_shared != NULL ? variable->second.m_shared->load() : variable->second.m_value;
         return true;
     }
     else
         return false;
 }
+
+/**
+ * SymbolTable::SaveVariables. Method to save the variables.
+ * Appends the number of assigned variables to a_buffer, followed by the length, the name and the value of each one.
+ * Then appends the number of arrays, followed by the length and the name of each array, its size and its values.
+ * Then appends the number of assigned string variables, followed by the length and the name of each one, and the
+ * length and the characters of its value.
+ * Numbers are written in the native byte order. Shared variables are saved with the value they share, unless they
+ * are left out for a copy of the variables that is private to a thread, which must not overwrite that value.
+ * @param a_buffer string Buffer that the variables are appended to.
+ * @param a_shared bool Whether the shared variables are saved.
+ * @see RestoreVariables
+ */
+void SymbolTable::SaveVariables(string &a_buffer, bool a_shared) const
+{
+    uint32_t count = 0;
+    for(unordered_map<string, Variable>::const_iterator variable = m_SymbolTable.begin(); variable != m_SymbolTable.end(); ++variable)
+        count += variable->second.m_assigned && (a_shared || variable->second.m_shared == NULL);
+    a_buffer.append((const char *)&count, sizeof(count));
+    
+    for(unordered_map<string, Variable>::const_iterator variable = m_SymbolTable.begin(); variable != m_SymbolTable.end(); ++variable)
+    {
+        if(!variable->second.m_assigned || (!a_shared && variable->second.m_shared != NULL))
+            continue;
+        double value = variable->second.m_shared != NULL ? variable->second.m_shared->load() : variable->second.m_value;
+        uint32_t length = (uint32_t)variable->first.size();
+        a_buffer.append((const char *)&length, sizeof(length));
+        a_buffer.append(variable->first);
+        a_buffer.append((const char *)&value, sizeof(double));
+    }
+    
+    count = (uint32_t)m_arrays.size();
+    a_buffer.append((const char *)&count, sizeof(count));
+    
+    for(unordered_map<string, vector<double> >::const_iterator array = m_arrays.begin(); array != m_arrays.end(); ++array)
+    {
+        uint32_t length = (uint32_t)array->first.size();
+        uint64_t size = array->second.size();
+        a_buffer.append((const char *)&length, sizeof(length));
+        a_buffer.append(array->first);
+        a_buffer.append((const char *)&size, sizeof(size));
+        a_buffer.append((const char *)array->second.data(), size * sizeof(double));
+    }
+    
+    count = 0;
+    for(unordered_map<string, StringVariable>::const_iterator variable = m_strings.begin(); variable != m_strings.end(); ++variable)
+        count += variable->second.m_assigned;
+    a_buffer.append((const char *)&count, sizeof(count));
+    
+    for(unordered_map<string, StringVariable>::const_iterator variable = m_strings.begin(); variable != m_strings.end(); ++variable)
+    {
+        if(!variable->second.m_assigned)
+            continue;
+        uint32_t length = (uint32_t)variable->first.size();
+        uint64_t size = variable->second.m_value.GetLength();
+        a_buffer.append((const char *)&length, sizeof(length));
+        a_buffer.append(variable->first);
+        a_buffer.append((const char *)&size, sizeof(size));
+        variable->second.m_value.AppendTo(a_buffer);
+    }
+}
+
+/**
+ * SymbolTable::ClearVariables. Method to forget the private variables.
+ * Marks the variables and string variables as never assigned, with their initial values, and drops the arrays.
+ * Shared variables stay bound to the values they share.
+ * @see RestoreVariables
+ */
+void SymbolTable::ClearVariables()
+{
+    for(unordered_map<string, Variable>::iterator variable = m_SymbolTable.begin(); variable != m_SymbolTable.end(); ++variable)
+    {
+        if(variable->second.m_shared != NULL)
+            continue;
+        variable->second.m_value = 0;
+        variable->second.m_assigned = false;
+    }
+    for(unordered_map<string, StringVariable>::iterator variable = m_strings.begin(); variable != m_strings.end(); ++variable)
+    {
+        variable->second.m_value = DuckString();
+        variable->second.m_assigned = false;
+    }
+    m_arrays.clear();
+}
+
+/**
+ * SymbolTable::RestoreVariables. Method to restore saved variables.
+ * Reads the variables and arrays written by SaveVariables from a_data and records them. a_data is moved past them.
+ * @param a_data const char* Start of the saved variables.
+ * @param a_end const char* End of the data that can be read.
+ * @return bool False if the data ends before all the variables are read.
+ * @see SaveVariables
+ */
+bool SymbolTable::RestoreVariables(const char *&a_data, const char *a_end)
+{
+    uint32_t count;
+    if(a_end - a_data < (long)sizeof(count))
+        return false;
+    memcpy(&count, a_data, sizeof(count));
+    a_data += sizeof(count);
+    
+    m_SymbolTable.reserve(count);
+    for(uint32_t i = 0; i < count; i++)
+    {
+        uint32_t length;
+        double value;
+        if(a_end - a_data < (long)sizeof(length))
+            return false;
+        memcpy(&length, a_data, sizeof(length));
+        a_data += sizeof(length);
+        
+        if((size_t)(a_end - a_data) < length + sizeof(value))
+            return false;
+        string name(a_data, length);
+        a_data += length;
+        memcpy(&value, a_data, sizeof(value));
+        a_data += sizeof(value);
+        
+        RecordVariableValue(name, value);
+    }
+    
+    if(a_end - a_data < (long)sizeof(count))
+        return false;
+    memcpy(&count, a_data, sizeof(count));
+    a_data += sizeof(count);
+    
+    for(uint32_t i = 0; i < count; i++)
+    {
+        uint32_t length;
+        uint64_t size;
+        if(a_end - a_data < (long)sizeof(length))
+            return false;
+        memcpy(&length, a_data, sizeof(length));
+        a_data += sizeof(length);
+        
+        if((size_t)(a_end - a_data) < length + sizeof(size))
+            return false;
+        string name(a_data, length);
+        a_data += length;
+        memcpy(&size, a_data, sizeof(size));
+        a_data += sizeof(size);
+        
+        if((uint64_t)(a_end - a_data) / sizeof(double) < size)
+            return false;
+        vector<double> &array = m_arrays[name];
+        array.resize(size);
+        memcpy(array.data(), a_data, size * sizeof(double));
+        a_data += size * sizeof(double);
+    }
+    
+    if(a_end - a_data < (long)sizeof(count))
+        return false;
+    memcpy(&count, a_data, sizeof(count));
+    a_data += sizeof(count);
+    
+    for(uint32_t i = 0; i < count; i++)
+    {
+        uint32_t length;
+        uint64_t size;
+        if(a_end - a_data < (long)sizeof(length))
+            return false;
+        memcpy(&length, a_data, sizeof(length));
+        a_data += sizeof(length);
+        
+        if((size_t)(a_end - a_data) < length + sizeof(size))
+            return false;
+        string name(a_data, length);
+        a_data += length;
+        memcpy(&size, a_data, sizeof(size));
+        a_data += sizeof(size);
+        
+        if((uint64_t)(a_end - a_data) < size)
+            return false;
+        RecordStringValue(name, DuckString(string_view(a_data, size)));
+        a_data += size;
+    }
+    return true;
+}
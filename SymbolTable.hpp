@@ -2,6 +2,8 @@
  *  SymbolTable.hpp
  *  SymbolTable Class header file.
  *  Records value of variables for access. This class will provide a mapping between the variables and their associated data.
+ *  String variables, whose names end with $, are kept apart from the numeric ones.
+ *  Shared variables keep their value outside of the table, in an atomic that the tables of all the threads use.
  *
  *
  *  Created by Salil Maharjan on 3/13/19.
@@ -9,6 +11,7 @@
  */
 
 #pragma once
+#include "DuckString.hpp"
 
 class SymbolTable
 {
@@ -19,14 +22,120 @@ public:
     // Record the value of a variable.
     void RecordVariableValue(string a_variable, double a_value)
     {
-        m_SymbolTable[a_variable] = a_value;
+        Variable &variable = m_SymbolTable[a_variable];
+        if(variable.m_shared != NULL)
+            variable.m_shared->store(a_value);
+        else
+            variable.m_value = a_value;
+        variable.m_assigned = true;
+    }
+    
+    // Makes a variable shared between threads. Its value is kept in a_value, that every table sharing it uses.
+    // Shared variables are always assigned.
+    void ShareVariable(const string &a_variable, atomic<double> *a_value)
+    {
+        Variable &variable = m_SymbolTable[a_variable];
+        variable.m_shared = a_value;
+        variable.m_assigned = true;
+    }
+    
+    // Accessor to check if a variable is shared between threads.
+    bool IsShared(const string &a_variable) const
+    {
+        unordered_map<string, Variable>::const_iterator variable = m_SymbolTable.find(a_variable);
+        return variable != m_SymbolTable.end() && variable->second.m_shared != NULL;
+    }
+    
+    // Accessor to get the address of the value of a variable, creating it unassigned if it does not exist.
+    // The address stays valid for the life of the table. Shared variables have no address in the table.
+    double *GetVariableAddress(const string &a_variable)
+    {
+        return &m_SymbolTable[a_variable].m_value;
     }
     
     // Accessor to get the value of a variable. Returns false if the variable does not exist.
     bool GetVariableValue(string a_variable, double &a_value);
     
+    // Accessor to check if a variable or a string variable was assigned.
+    bool IsAssigned(const string &a_variable) const
+    {
+        unordered_map<string, Variable>::const_iterator variable = m_SymbolTable.find(a_variable);
+        if(variable != m_SymbolTable.end() && variable->second.m_assigned)
+            return true;
+        unordered_map<string, StringVariable>::const_iterator stringVariable = m_strings.find(a_variable);
+        return stringVariable != m_strings.end() && stringVariable->second.m_assigned;
+    }
+    
+    // Record the value of a string variable.
+    void RecordStringValue(const string &a_variable, DuckString a_value)
+    {
+        StringVariable &variable = m_strings[a_variable];
+        variable.m_value = move(a_value);
+        variable.m_assigned = true;
+    }
+    
+    // Accessor to get the address of the value of a string variable, creating it unassigned if it does not exist.
+    // The address stays valid for the life of the table.
+    DuckString *GetStringAddress(const string &a_variable)
+    {
+        return &m_strings[a_variable].m_value;
+    }
+    
+    // Accessor to get the value of a string variable. Returns NULL if the variable was never assigned.
+    const DuckString *GetStringValue(const string &a_variable) const
+    {
+        unordered_map<string, StringVariable>::const_iterator variable = m_strings.find(a_variable);
+        return variable != m_strings.end() && variable->second.m_assigned ? &variable->second.m_value : NULL;
+    }
+    
+    // Declare an array of a_size values, all zero. Replaces any array with the same name.
+    void DeclareArray(const string &a_array, size_t a_size)
+    {
+        m_arrays[a_array].assign(a_size, 0.0);
+    }
+    
+    // Accessor to get the storage of an array. Returns NULL if the array does not exist.
+    vector<double> *GetArray(const string &a_array)
+    {
+        unordered_map<string, vector<double> >::iterator array = m_arrays.find(a_array);
+        return array == m_arrays.end() ? NULL : &array->second;
+    }
+    
+    // Appends all the variables to a_buffer in the binary snapshot format. Without a_shared, the shared variables
+    // are left out.
+    void SaveVariables(string &a_buffer, bool a_shared = true) const;
+    
+    // Restores the variables saved by SaveVariables. Returns false if the data is malformed.
+    bool RestoreVariables(const char *&a_data, const char *a_end);
+    
+    // Forgets the variables, string variables and arrays, other than the shared variables. The entries of the
+    // variables are kept, so that the addresses given out by GetVariableAddress and GetStringAddress stay valid.
+    void ClearVariables();
+    
 private:
-    // Unordered map that has the variable as a string and its corresponding value as a double.
-    unordered_map<string, double> m_SymbolTable;
+    // A variable. Variables are created unassigned when a compiled read takes their address.
+    // Shared variables have the value that they share instead of m_value.
+    struct Variable
+    {
+        double m_value = 0;
+        bool m_assigned = false;
+        atomic<double> *m_shared = NULL;
+    };
+    
+    // Unordered map that has the variable as a string and its corresponding value.
+    unordered_map<string, Variable> m_SymbolTable;
+    
+    // A string variable. Created unassigned like numeric variables.
+    struct StringVariable
+    {
+        DuckString m_value;
+        bool m_assigned = false;
+    };
+    
+    // Unordered map that has the string variable as a string and its value.
+    unordered_map<string, StringVariable> m_strings;
+    
+    // Unordered map that has the array name as a string and its values, stored contiguously.
+    unordered_map<string, vector<double> > m_arrays;
 };
 
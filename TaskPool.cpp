@@ -0,0 +1,190 @@
+/**
+ *  TaskPool.cpp
+ *  Implementation of TaskPool.hpp
+ */
+
+#include "PrefixHeader.pch"
+//#include "stdafx.h"
+#include "TaskPool.hpp"
+
+// The pool of the current thread, and its index in the pool. Null for threads that are not in a pool.
+static thread_local const TaskPool *s_currentPool = NULL;
+static thread_local int s_currentIndex = -1;
+
+/**
+ * TaskPool::TaskPool. Constructor for TaskPool class.
+ * Starts the threads, each with an empty deque.
+ * @param a_threadCount int Number of threads. At least one thread is started.
+ */
+TaskPool::TaskPool(int a_threadCount)
+{
+    a_threadCount = max(1, a_threadCount);
+    for(int i = 0; i < a_threadCount; i++)
+        m_deques.emplace_back(new TaskDeque());
+    for(int i = 0; i < a_threadCount; i++)
+        m_threads.emplace_back(&TaskPool::RunThread, this, i);
+}
+
+/**
+ * TaskPool::~TaskPool. Destructor for TaskPool class.
+ * Lets the threads run the tasks that are left, then stops them.
+ */
+TaskPool::~TaskPool()
+{
+    {
+        lock_guard<mutex> lock(m_sleepLock);
+        m_stopping = true;
+    }
+    m_wakeThreads.notify_all();
+    for(thread &worker : m_threads)
+        worker.join();
+}
+
+/**
+ * TaskPool::Spawn. Method to queue a task.
+ * A thread of the pool pushes the task to the back of its own deque. Other threads push it to the deques of the pool
+ * round robin. A sleeping thread is woken up to run it, or to steal it.
+ * @param a_group TaskGroup Group that the task is part of. Must live until the task has finished.
+ * @param a_task function<void()> The task.
+ * @see Wait
+ */
+void TaskPool::Spawn(TaskGroup &a_group, function<void()> a_task)
+{
+    a_group.m_pending.fetch_add(1, memory_order_relaxed);
+    
+    int index = GetThreadIndex();
+    if(index == -1)
+        index = (int)(m_nextDeque.fetch_add(1, memory_order_relaxed) % m_deques.size());
+    
+    {
+        TaskDeque &tasks = *m_deques[index];
+        lock_guard<mutex> lock(tasks.m_lock);
+        tasks.m_tasks.push_back(Task());
+        tasks.m_tasks.back().m_run = move(a_task);
+        tasks.m_tasks.back().m_group = &a_group;
+    }
+    m_queued.fetch_add(1);
+    
+    // Taking the lock orders the count with the check of a thread that is about to sleep, so that it is not missed.
+    {
+        lock_guard<mutex> lock(m_sleepLock);
+    }
+    m_wakeThreads.notify_one();
+}
+
+/**
+ * TaskPool::Wait. Method to wait for a group of tasks.
+ * Threads of the pool run other tasks until the group has finished, and yield when there is none to run, since the
+ * tasks of the group are running on other threads. Other threads sleep until the last task of the group wakes them.
+ * @param a_group TaskGroup The group to wait for.
+ * @see Spawn
+ */
+void TaskPool::Wait(TaskGroup &a_group)
+{
+    int index = GetThreadIndex();
+    if(index != -1)
+    {
+        Task task;
+        while(!a_group.IsDone())
+        {
+            if(TakeTask(index, task))
+                RunTask(task);
+            else
+                this_thread::yield();
+        }
+        return;
+    }
+    
+    unique_lock<mutex> lock(m_sleepLock);
+    m_groupDone.wait(lock, [&a_group]() { return a_group.IsDone(); });
+}
+
+/**
+ * TaskPool::GetThreadIndex. Accessor to get the index of the current thread in the pool.
+ * @return int Index of the thread, -1 if it is not a thread of this pool.
+ */
+int TaskPool::GetThreadIndex() const
+{
+    return s_currentPool == this ? s_currentIndex : -1;
+}
+
+/**
+ * TaskPool::TakeTask. Method to take a task to run.
+ * Pops the newest task of the deque of thread a_index. If it is empty, steals the oldest task of the other threads,
+ * looking at them in turn from the next one.
+ * @param a_index int Index of the thread that takes the task.
+ * @param a_task Task Receives the task.
+ * @return bool False if there are no tasks.
+ */
+bool TaskPool::TakeTask(int a_index, Task &a_task)
+{
+    if(m_queued.load(memory_order_relaxed) == 0)
+        return false;
+    
+    for(size_t i = 0; i < m_deques.size(); i++)
+    {
+        bool own = i == 0;
+        TaskDeque &tasks = *m_deques[(a_index + i) % m_deques.size()];
+        lock_guard<mutex> lock(tasks.m_lock);
+        if(tasks.m_tasks.empty())
+            continue;
+        
+        if(own)
+        {
+            a_task = move(tasks.m_tasks.back());
+            tasks.m_tasks.pop_back();
+        }
+        else
+        {
+            a_task = move(tasks.m_tasks.front());
+            tasks.m_tasks.pop_front();
+        }
+        m_queued.fetch_sub(1);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * TaskPool::RunTask. Method to run a task.
+ * Runs the task, and wakes the threads waiting for its group if it was the last one of the group.
+ * @param a_task Task The task.
+ */
+void TaskPool::RunTask(Task &a_task)
+{
+    a_task.m_run();
+    a_task.m_run = nullptr;
+    
+    if(a_task.m_group->m_pending.fetch_sub(1, memory_order_acq_rel) == 1)
+    {
+        lock_guard<mutex> lock(m_sleepLock);
+        m_groupDone.notify_all();
+    }
+}
+
+/**
+ * TaskPool::RunThread. Method run by the threads of the pool.
+ * Runs tasks while there are any, and sleeps until one is spawned otherwise. Returns once the pool is stopping and
+ * there are no tasks left.
+ * @param a_index int Index of the thread in the pool.
+ */
+void TaskPool::RunThread(int a_index)
+{
+    s_currentPool = this;
+    s_currentIndex = a_index;
+    
+    Task task;
+    while(true)
+    {
+        if(TakeTask(a_index, task))
+        {
+            RunTask(task);
+            continue;
+        }
+        
+        unique_lock<mutex> lock(m_sleepLock);
+        m_wakeThreads.wait(lock, [this]() { return m_stopping || m_queued.load() > 0; });
+        if(m_stopping && m_queued.load() == 0)
+            return;
+    }
+}
@@ -0,0 +1,97 @@
+/**
+ *  TaskPool.hpp
+ *  TaskPool Class header file.
+ *  Work stealing pool of threads, that runs the regions of spawn statements. Each thread has a deque of tasks. The
+ *  tasks spawned by a thread are pushed to the back of its own deque, and it runs them from the back, newest first,
+ *  while what they use is still in its cache. A thread that runs out of tasks steals the oldest task from the front of
+ *  the deque of another thread, which tends to be the largest piece of work left. A thread of the pool that waits for
+ *  the tasks it spawned runs other tasks in the meantime, so that waiting never leaves a core idle, and tasks that
+ *  spawn and wait for tasks of their own cannot run out of threads.
+ */
+
+#pragma once
+#include "PrefixHeader.pch"
+//#include "stdafx.h"
+
+// Tasks that are waited for together, like the regions spawned by one interpreter.
+class TaskGroup
+{
+public:
+    // Accessor to check whether all the tasks of the group have finished.
+    bool IsDone() const
+    {
+        return m_pending.load(memory_order_acquire) == 0;
+    }
+    
+private:
+    friend class TaskPool;
+    
+    // Number of tasks of the group that have not finished.
+    atomic<int> m_pending{0};
+};
+
+class TaskPool
+{
+public:
+    // Starts a_threadCount threads.
+    explicit TaskPool(int a_threadCount);
+    ~TaskPool();
+    
+    // Accessor to get the number of threads of the pool.
+    int GetThreadCount() const
+    {
+        return (int)m_threads.size();
+    }
+    
+    // Queues a_task, as a task of a_group.
+    void Spawn(TaskGroup &a_group, function<void()> a_task);
+    
+    // Waits until all the tasks of a_group have finished.
+    void Wait(TaskGroup &a_group);
+    
+private:
+    // A task, and the group that it is part of.
+    struct Task
+    {
+        function<void()> m_run;
+        TaskGroup *m_group = NULL;
+    };
+    
+    // The deque of tasks of a thread. The thread pushes and pops at the back, other threads steal from the front.
+    // Aligned so that the deques of two threads never share a cache line.
+    struct alignas(64) TaskDeque
+    {
+        mutex m_lock;
+        deque<Task> m_tasks;
+    };
+    
+    // The deques of the threads, indexed like m_threads.
+    vector< unique_ptr<TaskDeque> > m_deques;
+    vector<thread> m_threads;
+    
+    // Deque that the next task spawned from outside of the pool goes to. They are spread round robin.
+    atomic<unsigned> m_nextDeque{0};
+    
+    // Number of tasks in the deques. Threads only sleep when it is 0.
+    atomic<int> m_queued{0};
+    
+    // Threads of the pool sleep on m_wakeThreads while there are no tasks, and threads from outside of the pool sleep
+    // on m_groupDone while they wait for a group.
+    mutex m_sleepLock;
+    condition_variable m_wakeThreads;
+    condition_variable m_groupDone;
+    bool m_stopping = false;
+    
+    // Gets the index of the current thread in the pool. -1 if it is not one of its threads.
+    int GetThreadIndex() const;
+    
+    // Takes a task for thread a_index: the newest of its own, or the oldest of another thread. Returns false if
+    // there is none.
+    bool TakeTask(int a_index, Task &a_task);
+    
+    // Runs a task and counts it as finished.
+    void RunTask(Task &a_task);
+    
+    // Method run by the threads of the pool.
+    void RunThread(int a_index);
+};
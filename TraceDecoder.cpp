@@ -0,0 +1,94 @@
+/**
+ *  TraceDecoder.cpp
+ *  Main for ducktrace, the decoder of flight recorder dumps.
+ *  Prints the statements recorded in a dump written by FlightRecorder, with their source lines and labels. Records
+ *  with the cycle counter show the average cycles per statement since the previous one.
+ */
+
+#include "PrefixHeader.pch"
+//#include "stdafx.h"
+#include "FlightRecorder.hpp"
+#include "Statement.hpp"
+
+/**
+ * DescribeReason. Method to describe why a dump was written.
+ * @param a_reason uint32_t The reason recorded in the dump header.
+ * @return string The description.
+ */
+static string DescribeReason(uint32_t a_reason)
+{
+    if(a_reason == 0)
+        return "SIGUSR1";
+    if(a_reason > 128)
+        return "signal " + to_string(a_reason - 128) + " (" + strsignal(a_reason - 128) + ")";
+    return "exit status " + to_string(a_reason);
+}
+
+int main(int argc, char *argv[])
+{
+    // Checking for correct arguments
+    if (argc != 3)
+    {
+        cerr<<"Usage: ducktrace <dump> <filename>"<<endl;
+        return 1;
+    }
+    
+    ifstream dump(argv[1], ios::binary);
+    FlightRecorderHeader header;
+    if(!dump.read((char *)&header, sizeof(header)) || memcmp(header.m_magic, FLIGHT_RECORDER_MAGIC, sizeof(header.m_magic)) != 0)
+    {
+        cerr << "Invalid flight recorder dump: " << argv[1] << endl;
+        return 1;
+    }
+    if(header.m_version != FLIGHT_RECORDER_VERSION)
+    {
+        cerr << "Unsupported flight recorder dump version " << header.m_version << ": " << argv[1] << endl;
+        return 1;
+    }
+    
+    vector<FlightRecord> records(header.m_recordCount);
+    if(!dump.read((char *)records.data(), records.size() * sizeof(FlightRecord)))
+    {
+        cerr << "Truncated flight recorder dump: " << argv[1] << endl;
+        return 1;
+    }
+    
+    Statement statements;
+    statements.RecordStatements(argv[2]);
+    if(statements.GetProgramHash() != header.m_programHash)
+        cerr << "Warning: the dump was recorded from a different version of " << argv[2] << endl;
+    
+    cout << "Dumped on " << DescribeReason(header.m_reason) << " after " << header.m_totalRecords << " statements." << endl;
+    cout << "Last " << records.size() << " statements, oldest first. The last one was running when the dump was written." << endl;
+    cout << "Every " << FLIGHT_RECORDER_CYCLE_INTERVAL << " statements, the average cycles per statement since the previous sample." << endl;
+    cout << setw(12) << "cycles" << setw(10) << "line" << "  statement" << endl;
+    
+    // Previous record with the cycle counter.
+    size_t previousSample = records.size();
+    
+    for(size_t i = 0; i < records.size(); i++)
+    {
+        int statement = (int)records[i].m_statement;
+        
+        if(records[i].m_cycles != 0 && previousSample < records.size())
+            cout << setw(12) << (records[i].m_cycles - records[previousSample].m_cycles) / (i - previousSample);
+        else
+            cout << setw(12) << "";
+        if(records[i].m_cycles != 0)
+            previousSample = i;
+        
+        if(statement < 0 || statement >= statements.GetStatementCount())
+        {
+            cout << setw(10) << "?" << "  statement " << statement << " is not in the source" << endl;
+            continue;
+        }
+        
+        string label;
+        cout << setw(10) << statements.GetLineNumber(statement) << "  ";
+        if(statements.FindEnclosingLabel(statement, label))
+            cout << "[" << label << "] ";
+        cout << statements.GetRecordedStatement(statement) << endl;
+    }
+    
+    return 0;
+}
@@ -0,0 +1,18 @@
+# Helpers of the benchmark scripts, which source this file.
+
+RUNS=5
+
+# Prints the best time of RUNS runs of a command, in nanoseconds. The command is given INPUT, if any, as its input,
+# and its output is discarded.
+best_time() {
+    local best=
+    for run in $(seq $RUNS); do
+        local start=$(date +%s%N)
+        echo "$INPUT" | "$@" > /dev/null || exit 1
+        local elapsed=$(( $(date +%s%N) - start ))
+        if [ -z "$best" ] || [ $elapsed -lt $best ]; then
+            best=$elapsed
+        fi
+    done
+    echo $best
+}
@@ -0,0 +1,18 @@
+#!/bin/bash
+# Separates the cost of formatting numbers from the rest of print statements. print_bench.txt prints 400000 numbers;
+# print_baseline.txt prints the same lines without them, and its time is subtracted.
+# Usage: benchmarks/format_bench.sh [interpreter]
+
+INTERPRETER=${1:-./duckinterpreter}
+DIRECTORY=$(dirname "$0")
+NUMBERS=400000
+
+. "$DIRECTORY/common.sh"
+
+baseline=$(best_time "$INTERPRETER" "$DIRECTORY/print_baseline.txt") || exit 1
+shortest=$(best_time "$INTERPRETER" "$DIRECTORY/print_bench.txt") || exit 1
+six=$(best_time "$INTERPRETER" --six-digit-numbers "$DIRECTORY/print_bench.txt") || exit 1
+
+echo "prompts only:        $(( baseline / 1000000 )) ms"
+echo "shortest numbers:    $(( shortest / 1000000 )) ms, $(( (shortest - baseline) / NUMBERS )) ns per number"
+echo "six digit numbers:   $(( six / 1000000 )) ms, $(( (six - baseline) / NUMBERS )) ns per number"
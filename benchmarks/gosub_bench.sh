@@ -0,0 +1,19 @@
+#!/bin/bash
+# Compares the cost of a subroutine call with gosub and return to the hand-rolled pattern of a return variable,
+# a goto and an if dispatch chain. Each program makes 1000000 calls; the time of the same work done inline is
+# subtracted.
+# Usage: benchmarks/gosub_bench.sh [interpreter]
+
+INTERPRETER=${1:-./duckinterpreter}
+DIRECTORY=$(dirname "$0")
+CALLS=1000000
+
+. "$DIRECTORY/common.sh"
+
+baseline=$(best_time "$INTERPRETER" "$DIRECTORY/gosub_baseline.txt") || exit 1
+call=$(best_time "$INTERPRETER" "$DIRECTORY/gosub_call.txt") || exit 1
+dispatch=$(best_time "$INTERPRETER" "$DIRECTORY/gosub_dispatch.txt") || exit 1
+
+echo "inline, no calls:    $(( baseline / 1000000 )) ms"
+echo "gosub / return:      $(( call / 1000000 )) ms, $(( (call - baseline) / CALLS )) ns per call"
+echo "goto / if dispatch:  $(( dispatch / 1000000 )) ms, $(( (dispatch - baseline) / CALLS )) ns per call"
@@ -0,0 +1,46 @@
+#!/bin/bash
+# Reports the time of each benchmark program with each build variant, and its speedup over the first variant.
+# Build the variants first with make debug lto release. Variants that are not built are skipped.
+# Usage: benchmarks/speedup.sh [variant directory...]
+
+DIRECTORY=$(dirname "$0")
+INPUT="5"
+if [ $# -gt 0 ]; then
+    VARIANTS=("$@")
+else
+    VARIANTS=(build/debug build/lto build/release)
+fi
+
+. "$DIRECTORY/common.sh"
+
+interpreters=()
+for variant in "${VARIANTS[@]}"; do
+    if [ -x "$variant/duckinterpreter" ]; then
+        interpreters+=("$variant/duckinterpreter")
+    else
+        echo "skipping $variant: $variant/duckinterpreter is not built" >&2
+    fi
+done
+if [ ${#interpreters[@]} -eq 0 ]; then
+    echo "no variant is built" >&2
+    exit 1
+fi
+
+printf "%-24s" "program"
+for interpreter in "${interpreters[@]}"; do
+    printf "%24s" "$(basename "$(dirname "$interpreter")")"
+done
+echo
+
+for program in "$DIRECTORY"/*.txt; do
+    printf "%-24s" "$(basename "$program")"
+    baseline=
+    for interpreter in "${interpreters[@]}"; do
+        elapsed=$(best_time "$interpreter" "$program") || { echo; echo "$program failed with $interpreter" >&2; exit 1; }
+        if [ -z "$baseline" ]; then
+            baseline=$elapsed
+        fi
+        printf "%24s" "$(( elapsed / 1000000 )) ms $(( baseline * 100 / elapsed / 100 )).$(printf "%02d" $(( baseline * 100 / elapsed % 100 )))x"
+    done
+    echo
+done
@@ -0,0 +1,13 @@
+#!/bin/bash
+# Runs the training corpus with an instrumented interpreter, so that it writes the profile used by the release build.
+# Each program is given the same input, and its output is discarded. Fails if a program fails.
+# Usage: benchmarks/train.sh <instrumented interpreter>
+
+INTERPRETER=${1:?Usage: benchmarks/train.sh <instrumented interpreter>}
+DIRECTORY=$(dirname "$0")
+INPUT="5"
+
+for program in "$DIRECTORY"/corpus/*.txt; do
+    echo "training on $program"
+    echo "$INPUT" | "$INTERPRETER" "$program" > /dev/null || { echo "$program failed" >&2; exit 1; }
+done
@@ -10,22 +10,199 @@
 #include "PrefixHeader.pch"
 //#include "stdafx.h"
 #include "DuckInterpreter.hpp"
+#include "ProgramServer.hpp"
+#include "OutputCache.hpp"
+
+/**
+ * ReplayCachedOutput. Method to replay the output of a run from the output cache.
+ * Reads the whole input, and gives the program a copy of it to read. If the program already ran with the same input,
+ * writes its output. Otherwise records the output of this run, to cache it if the program stops normally.
+ * @param a_interpreter DuckInterpreter The interpreter, with the program recorded and prepared for memoization.
+ * @param a_cache OutputCache The output cache.
+ * @param a_recorder OutputRecorder Records the output of the run. Must live until the program exits.
+ * @return bool True if the output was replayed, and the program must not run.
+ */
+static bool ReplayCachedOutput(DuckInterpreter &a_interpreter, OutputCache &a_cache, OutputRecorder &a_recorder)
+{
+    string input, output;
+    int inputFile = -1;
+    if(!OutputCache::ReadAll(STDIN_FILENO, input) || (inputFile = OutputCache::MakeInputFile(input)) == -1)
+    {
+        cerr << "Could not read the input for the output cache: " << strerror(errno) << endl;
+        exit(1);
+    }
+    dup2(inputFile, STDIN_FILENO);
+    close(inputFile);
+    
+    OutputKey key;
+    key.m_program = a_interpreter.GetNormalizedProgramHash();
+    key.m_input = OutputCache::HashBytes(input.data(), input.size());
+    if(a_cache.Find(key, output))
+    {
+        cout.flush();
+        OutputCache::WriteAll(STDOUT_FILENO, output);
+        return true;
+    }
+    
+    a_recorder.Start([&a_cache, key](const string &a_output) { a_cache.Insert(key, a_output); });
+    a_interpreter.SetOutputRecorder(&a_recorder);
+    return false;
+}
 
 int main(int argc, char *argv[])
 {
+    // Options
+    bool watch = false;
+    bool optimizationStats = false;
+    bool optimize = true;
+    bool stats = false;
+    bool dumpOptimized = false;
+    bool asyncOutput = false;
+    NumberFormat numberFormat = NumberFormat::Shortest;
+    string sampleFileName;
+    int sampleFrequency = SAMPLE_DEFAULT_FREQUENCY;
+    int sampleTop = SAMPLE_DEFAULT_TOP;
+    bool memoize = false;
+    string memoizeDirectory;
+    long memoizeMegabytes = OUTPUT_CACHE_DEFAULT_MEGABYTES;
+    string checkpointFileName;
+    long checkpointInterval = 0;
+    string resumeFileName;
+    string traceFileName;
+    string fileName;
+    string socketName;
+    int workerCount = (int)max(1u, thread::hardware_concurrency());
+    long cacheSize = 16;
+    
     // Checking for correct arguments
-    if (argc!=2)
+    for(int i = 1; i < argc; i++)
+    {
+        string argument = argv[i];
+        if(argument == "--watch")
+            watch = true;
+        else if(argument == "--opt-stats")
+            optimizationStats = true;
+        else if(argument == "--no-opt")
+            optimize = false;
+        else if(argument == "--stats")
+            stats = true;
+        else if(argument == "--dump-optimized")
+            dumpOptimized = true;
+        else if(argument == "--async-output")
+            asyncOutput = true;
+        else if(argument == "--six-digit-numbers")
+            numberFormat = NumberFormat::SixDigits;
+        else if(argument == "--sample" && i+1 < argc)
+            sampleFileName = argv[++i];
+        else if(argument == "--sample-rate" && i+1 < argc)
+            sampleFrequency = atoi(argv[++i]);
+        else if(argument == "--sample-top" && i+1 < argc)
+            sampleTop = atoi(argv[++i]);
+        else if(argument == "--memoize")
+            memoize = true;
+        else if(argument == "--memoize-dir" && i+1 < argc)
+        {
+            memoize = true;
+            memoizeDirectory = argv[++i];
+        }
+        else if(argument == "--memoize-size" && i+1 < argc)
+            memoizeMegabytes = atol(argv[++i]);
+        else if(argument == "--checkpoint" && i+1 < argc)
+            checkpointFileName = argv[++i];
+        else if(argument == "--checkpoint-every" && i+1 < argc)
+            checkpointInterval = atol(argv[++i]);
+        else if(argument == "--resume" && i+1 < argc)
+            resumeFileName = argv[++i];
+        else if(argument == "--trace-file" && i+1 < argc)
+            traceFileName = argv[++i];
+        else if(argument == "--serve" && i+1 < argc)
+            socketName = argv[++i];
+        else if(argument == "--workers" && i+1 < argc)
+            workerCount = atoi(argv[++i]);
+        else if(argument == "--cache-size" && i+1 < argc)
+            cacheSize = atol(argv[++i]);
+        else if(fileName.empty() && argument.compare(0, 2, "--") != 0)
+            fileName = argument;
+        else
+        {
+            fileName.clear();
+            break;
+        }
+    }
+    if ((fileName.empty() == socketName.empty()) || (checkpointInterval != 0 && checkpointFileName.empty()))
     {
-        cerr<<"Usage: DuckInterp <filename>"<<endl;
+        cerr<<"Usage: DuckInterp [--watch] [--stats] [--opt-stats] [--no-opt] [--dump-optimized] [--async-output] [--six-digit-numbers] [--sample <stacks> [--sample-rate <hz>] [--sample-top <n>]] [--memoize-dir <directory>] [--checkpoint <snapshot> [--checkpoint-every <statements>]]"
+            <<" [--resume <snapshot>] [--trace-file <dump>] <filename>"<<endl;
+        cerr<<"       DuckInterp --serve <socket> [--workers <count>] [--cache-size <programs>] [--six-digit-numbers]"
+            <<" [--memoize [--memoize-dir <directory>] [--memoize-size <megabytes>]]"<<endl;
         return 1;
     }
     
+    if(sampleFrequency < SAMPLE_MIN_FREQUENCY || sampleFrequency > SAMPLE_MAX_FREQUENCY)
+    {
+        cerr<<"The sample rate must be from "<<SAMPLE_MIN_FREQUENCY<<" to "<<SAMPLE_MAX_FREQUENCY<<" Hz"<<endl;
+        return 1;
+    }
+    
+    // Serving programs to duckclient instead of running one.
+    if(!socketName.empty())
+    {
+        ProgramServer server(socketName, workerCount, cacheSize);
+        server.SetNumberFormat(numberFormat);
+        if(memoize)
+            server.EnableMemoization((size_t)max(0L, memoizeMegabytes) << 20, memoizeDirectory);
+        server.Serve();
+        return 0;
+    }
+    
     //Create the interpreter object and use it to record the statements
     //and execute them.
     DuckInterpreter duckInt;
+    duckInt.SetNumberFormat(numberFormat);
+    if(optimizationStats)
+        duckInt.EnableOptimizationStats();
+    if(!optimize)
+        duckInt.DisableOptimizations();
+    if(stats)
+        duckInt.EnableStats();
+    if(!traceFileName.empty())
+        duckInt.SetTraceFile(traceFileName);
+    if(!sampleFileName.empty())
+        duckInt.EnableSampling(sampleFileName, sampleFrequency, sampleTop);
     
     // Running the interpreter
-    duckInt.RecordStatements(argv[1]);
+    duckInt.RecordStatements(fileName);
+    if(dumpOptimized)
+    {
+        duckInt.DumpOptimizedProgram(cout);
+        return 0;
+    }
+    
+    // Runs that depend on more than the program and its input are not cached. A single run only benefits from the
+    // outputs persisted by earlier runs, so it needs a directory.
+    unique_ptr<OutputCache> outputCache;
+    OutputRecorder outputRecorder;
+    if(!memoizeDirectory.empty() && resumeFileName.empty() && checkpointFileName.empty() && !watch
+       && !isatty(STDIN_FILENO))
+    {
+        duckInt.PrepareMemoization();
+        if(duckInt.IsMemoizable())
+        {
+            outputCache.reset(new OutputCache((size_t)max(0L, memoizeMegabytes) << 20, memoizeDirectory));
+            if(ReplayCachedOutput(duckInt, *outputCache, outputRecorder))
+                return 0;
+            asyncOutput = false;
+        }
+    }
+    
+    if(!resumeFileName.empty())
+        duckInt.ResumeFromSnapshot(resumeFileName);
+    if(!checkpointFileName.empty())
+        duckInt.EnableCheckpoints(checkpointFileName, checkpointInterval);
+    if(watch)
+        duckInt.EnableWatch();
+    if(asyncOutput)
+        duckInt.EnableAsyncOutput();
     duckInt.RunInterpreter();
     
     return 0;
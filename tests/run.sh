@@ -0,0 +1,37 @@
+#!/bin/bash
+# Runs the test programs and compares their output with the expected output in their .expected files. Each program is
+# run as it is, without optimizations, with the output written on a separate thread, and twice with the output cache,
+# to fill it and to replay it. A program reads its .input file if there is one, and no input otherwise.
+# Usage: tests/run.sh [interpreter]
+
+INTERPRETER=${1:-./duckinterpreter}
+DIRECTORY=$(dirname "$0")
+CACHE=$(mktemp -d) || exit 1
+trap 'rm -rf "$CACHE"' EXIT
+failed=0
+
+# Runs a program with the given options, and reports it if it fails or its output is not the expected output.
+check() {
+    local program=$1
+    shift
+    local input=/dev/null
+    [ -f "${program%.txt}.input" ] && input="${program%.txt}.input"
+    local output
+    output=$("$INTERPRETER" "$@" "$program" < "$input" 2>&1)
+    if [ $? -ne 0 ] || [ "$output" != "$(cat "${program%.txt}.expected")" ]; then
+        echo "FAILED: $program $*"
+        diff <(echo "$output") "${program%.txt}.expected"
+        failed=1
+    fi
+}
+
+for program in "$DIRECTORY"/*.txt; do
+    check "$program"
+    check "$program" --no-opt
+    check "$program" --async-output
+    check "$program" --memoize-dir "$CACHE"
+    check "$program" --memoize-dir "$CACHE"
+done
+
+[ $failed -eq 0 ] && echo "All tests passed."
+exit $failed